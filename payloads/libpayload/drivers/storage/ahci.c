@@ -107,16 +107,16 @@ static int ahci_dev_init(hba_ctrl_t *const ctrl,
 
 	const int ncs = HBA_CAPS_DECODE_NCS(ctrl->caps);
 
-	/* Allocate command list, one command table and received FIS. */
+	/* Allocate command list, a command table per slot and received FIS. */
 	cmd_t *const cmdlist = memalign(1024, ncs * sizeof(cmd_t));
-	cmdtable_t *const cmdtable = memalign(128, sizeof(cmdtable_t));
+	cmdtable_t *const cmdtable = memalign(128, ncs * sizeof(cmdtable_t));
 	rcvd_fis_t *const rcvd_fis = memalign(256, sizeof(rcvd_fis_t));
 	/* Allocate our device structure. */
 	ahci_dev_t *const dev = calloc(1, sizeof(ahci_dev_t));
 	if (!cmdlist || !cmdtable || !rcvd_fis || !dev)
 		goto _cleanup_ret;
 	memset((void *)cmdlist, '\0', ncs * sizeof(cmd_t));
-	memset((void *)cmdtable, '\0', sizeof(*cmdtable));
+	memset((void *)cmdtable, '\0', ncs * sizeof(*cmdtable));
 	memset((void *)rcvd_fis, '\0', sizeof(*rcvd_fis));
 
 	/* Set command list base and received FIS base. */
@@ -134,6 +134,7 @@ static int ahci_dev_init(hba_ctrl_t *const ctrl,
 	dev->cmdlist = cmdlist;
 	dev->cmdtable = cmdtable;
 	dev->rcvd_fis = rcvd_fis;
+	dev->slots = ncs;
 
 	/*
 	 * Wait for D2H Register FIS with device' signature.
@@ -155,6 +156,10 @@ static int ahci_dev_init(hba_ctrl_t *const ctrl,
 #if IS_ENABLED(CONFIG_LP_STORAGE_ATA)
 		dev->ata_dev.identify = ahci_identify_device;
 		dev->ata_dev.read_sectors = ahci_ata_read_sectors;
+		if (ctrl->caps & HBA_CAPS_SNCQ) {
+			dev->ata_dev.submit_read_sectors = ahci_ata_submit_read;
+			dev->ata_dev.reap_read_sectors = ahci_ata_reap_read;
+		}
 		return ata_attach_device(&dev->ata_dev, PORT_TYPE_SATA);
 #endif
 		break;
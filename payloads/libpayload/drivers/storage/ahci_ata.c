@@ -48,6 +48,11 @@ ssize_t ahci_ata_read_sectors(ata_dev_t *const ata_dev,
 	if (count == 0)
 		return 0;
 
+	if (dev->queued) {
+		printf("ahci: Can't read while queued reads are pending.\n");
+		return -1;
+	}
+
 	if (ata_dev->read_cmd == ATA_READ_DMA) {
 		if (start >= (1 << 28)) {
 		       printf("ahci: Sector is not 28-bit addressable.\n");
@@ -98,3 +103,65 @@ ssize_t ahci_ata_read_sectors(ata_dev_t *const ata_dev,
 	else
 		return dev->cmdlist->prd_bytes >> ata_dev->sector_size_shift;
 }
+
+/** Queue a READ FPDMA QUEUED command, returns its tag (the slot number). */
+int ahci_ata_submit_read(ata_dev_t *const ata_dev,
+			 const lba_t start, const size_t count,
+			 u8 *const buf)
+{
+	ahci_dev_t *const dev = (ahci_dev_t *)ata_dev;
+	const int depth = MIN(dev->slots, ata_dev->queue_depth);
+	int slotnum;
+
+	if (count == 0 || count > (64 * 1024))
+		return -1;
+#if IS_ENABLED(CONFIG_LP_STORAGE_64BIT_LBA)
+	if (start + count > (1ULL << 48))
+		return -1;
+#endif
+
+	for (slotnum = 0; slotnum < depth; ++slotnum) {
+		if (!(dev->queued & (1 << slotnum)))
+			break;
+	}
+	if (slotnum == depth)
+		return -1;
+
+	/* Queued reads are never split, the caller has to retry smaller. */
+	const size_t bytes = count << ata_dev->sector_size_shift;
+	if (ahci_cmdslot_prepare_queued(dev, slotnum, buf, bytes) != bytes)
+		return -1;
+
+	volatile u8 *const fis = dev->cmdtable[slotnum].fis;
+	fis[ 0] = FIS_HOST_TO_DEVICE;
+	fis[ 1] = FIS_H2D_CMD;
+	fis[ 2] = ATA_READ_FPDMA_QUEUED;
+	fis[ 3] = (count >>  0) & 0xff;
+	fis[ 4] = (start >>  0) & 0xff;
+	fis[ 5] = (start >>  8) & 0xff;
+	fis[ 6] = (start >> 16) & 0xff;
+	fis[ 7] = FIS_H2D_DEV_LBA;
+	fis[ 8] = (start >> 24) & 0xff;
+#if IS_ENABLED(CONFIG_LP_STORAGE_64BIT_LBA)
+	fis[ 9] = (start >> 32) & 0xff;
+	fis[10] = (start >> 40) & 0xff;
+#endif
+	fis[11] = (count >>  8) & 0xff;
+	fis[12] = slotnum << 3; /* NCQ tag */
+
+	if (ahci_cmdslot_queue(dev, slotnum, bytes))
+		return -1;
+
+	return slotnum;
+}
+
+ssize_t ahci_ata_reap_read(ata_dev_t *const ata_dev, const int tag)
+{
+	ahci_dev_t *const dev = (ahci_dev_t *)ata_dev;
+
+	const ssize_t bytes = ahci_cmdslot_reap(dev, tag);
+	if (bytes < 0)
+		return -1;
+	else
+		return bytes >> ata_dev->sector_size_shift;
+}
@@ -186,51 +186,129 @@ ssize_t ahci_cmdslot_exec(ahci_dev_t *const dev)
 	}
 }
 
-size_t ahci_cmdslot_prepare(ahci_dev_t *const dev,
-				   u8 *const user_buf, size_t buf_len,
-				   const int out)
+/** Clear a command slot, returns how much of buf_len its PRDT can take. */
+static size_t ahci_cmdslot_clear(ahci_dev_t *const dev, const int slotnum,
+				 const size_t buf_len)
 {
-	const int slotnum = 0; /* We always use the first slot. */
-
-	size_t read_count = 0;
+	const size_t max_bytes =
+		ARRAY_SIZE(dev->cmdtable->prdt) << BYTES_PER_PRD_SHIFT;
 
 	memset((void *)&dev->cmdlist[slotnum],
 			'\0', sizeof(dev->cmdlist[slotnum]));
-	memset((void *)dev->cmdtable,
-			'\0', sizeof(*dev->cmdtable));
+	memset((void *)&dev->cmdtable[slotnum],
+			'\0', sizeof(dev->cmdtable[slotnum]));
 	dev->cmdlist[slotnum].cmd = CMD_CFL(FIS_H2D_FIS_LEN);
-	dev->cmdlist[slotnum].cmdtable_base = virt_to_phys(dev->cmdtable);
+	dev->cmdlist[slotnum].cmdtable_base =
+		virt_to_phys(&dev->cmdtable[slotnum]);
 
-	if (buf_len > 0) {
-		size_t prdt_len;
-		u8 *buf;
-		int i;
-
-		prdt_len = ((buf_len - 1) >> BYTES_PER_PRD_SHIFT) + 1;
-		const size_t max_prdt_len = ARRAY_SIZE(dev->cmdtable->prdt);
-		if (prdt_len > max_prdt_len) {
-			prdt_len = max_prdt_len;
-			buf_len = prdt_len << BYTES_PER_PRD_SHIFT;
-		}
+	return (buf_len > max_bytes) ? max_bytes : buf_len;
+}
+
+/** Describe buf with as many PRDs as needed. */
+static void ahci_cmdslot_fill_prdt(ahci_dev_t *const dev, const int slotnum,
+				   u8 *buf, size_t buf_len)
+{
+	cmdtable_t *const cmdtable = &dev->cmdtable[slotnum];
+	int i;
+
+	const size_t prdt_len = ((buf_len - 1) >> BYTES_PER_PRD_SHIFT) + 1;
+	dev->cmdlist[slotnum].prdt_length = prdt_len;
+
+	for (i = 0; i < prdt_len; ++i) {
+		const size_t bytes =
+			(buf_len < BYTES_PER_PRD)
+			? buf_len : BYTES_PER_PRD;
+		cmdtable->prdt[i].data_base = virt_to_phys(buf);
+		cmdtable->prdt[i].flags = PRD_TABLE_BYTES(bytes);
+		buf_len -= bytes;
+		buf += bytes;
+	}
+}
+
+size_t ahci_cmdslot_prepare(ahci_dev_t *const dev,
+				   u8 *const user_buf, size_t buf_len,
+				   const int out)
+{
+	const int slotnum = 0; /* We always use the first slot. */
 
-		dev->cmdlist[slotnum].prdt_length = prdt_len;
-		read_count = buf_len;
+	buf_len = ahci_cmdslot_clear(dev, slotnum, buf_len);
 
-		buf = ahci_prdbuf_init(dev, user_buf, buf_len, out);
+	if (buf_len > 0) {
+		u8 *const buf = ahci_prdbuf_init(dev, user_buf, buf_len, out);
 		if (!buf)
 			return 0;
-		for (i = 0; i < prdt_len; ++i) {
-			const size_t bytes =
-				(buf_len < BYTES_PER_PRD)
-				? buf_len : BYTES_PER_PRD;
-			dev->cmdtable->prdt[i].data_base = virt_to_phys(buf);
-			dev->cmdtable->prdt[i].flags = PRD_TABLE_BYTES(bytes);
-			buf_len -= bytes;
-			buf += bytes;
-		}
+		ahci_cmdslot_fill_prdt(dev, slotnum, buf, buf_len);
+	}
+
+	return buf_len;
+}
+
+/**
+ * Prepare a slot for a queued command. Queued commands transfer directly
+ * from/to the caller's buffer, so it has to be word aligned.
+ */
+size_t ahci_cmdslot_prepare_queued(ahci_dev_t *const dev, const int slotnum,
+				   u8 *const buf, size_t buf_len)
+{
+	if ((uintptr_t)buf & 1)
+		return 0;
+
+	buf_len = ahci_cmdslot_clear(dev, slotnum, buf_len);
+	if (buf_len > 0)
+		ahci_cmdslot_fill_prdt(dev, slotnum, buf, buf_len);
+
+	return buf_len;
+}
+
+/** Issue a prepared NCQ command without waiting for it. */
+int ahci_cmdslot_queue(ahci_dev_t *const dev, const int slotnum,
+		       const size_t bytes)
+{
+	if (!(dev->port->cmd_stat & HBA_PxCMD_CR))
+		return -1;
+
+	dev->queued |= 1 << slotnum;
+	dev->queued_bytes[slotnum] = bytes;
+
+	/* SActive has to be set before the command is issued. */
+	dev->port->sata_active = 1 << slotnum;
+	dev->port->cmd_issue = 1 << slotnum;
+
+	return 0;
+}
+
+/** Wait for a queued command, returns the number of bytes transferred. */
+ssize_t ahci_cmdslot_reap(ahci_dev_t *const dev, const int slotnum)
+{
+	const u32 slot = 1 << slotnum;
+
+	if (!(dev->queued & slot))
+		return -1;
+
+	/* The device clears our SActive bit when the command is done. */
+	int timeout = 50000; /* Time out after 50000 * 100us == 5s. */
+	while ((dev->port->sata_active & slot) &&
+			!(dev->port->intr_status & HBA_PxIS_TFES) &&
+			timeout--)
+		udelay(100);
+	if (timeout < 0)
+		printf("ahci: Timeout during queued command execution.\n");
+
+	const u32 intr_status = ahci_clear_status(dev->port, intr_status);
+	if (timeout < 0 || (intr_status & (HBA_PxIS_FATAL | HBA_PxIS_PCS))) {
+		/* The device aborts all outstanding commands on errors. */
+		dev->queued_failed |= dev->queued & dev->port->sata_active;
+		/* Stopping the command engine clears SActive. Force a
+		   COMRESET to get the device out of its NCQ error state. */
+		ahci_error_recovery(dev, intr_status | HBA_PxIS_PCS);
 	}
 
-	return read_count;
+	dev->queued &= ~slot;
+	if (dev->queued_failed & slot) {
+		dev->queued_failed &= ~slot;
+		return -1;
+	}
+	return dev->queued_bytes[slotnum];
 }
 
 int ahci_identify_device(ata_dev_t *const ata_dev, u8 *const buf)
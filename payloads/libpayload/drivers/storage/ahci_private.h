@@ -109,6 +109,7 @@ typedef volatile struct {
 	hba_port_t ports[32];
 } hba_ctrl_t;
 
+#define HBA_CAPS_SNCQ		(1 << 30) /* SNCQ - Supports Native Command Queuing */
 #define HBA_CAPS_SSS		(1 << 27) /* SSS - Supports Staggered Spin-up */
 #define HBA_CAPS_NCS_SHIFT	8	/* NCS - Number of Command Slots */
 #define HBA_CAPS_NCS_MASK	(0x1f << HBA_CAPS_NCS_SHIFT)
@@ -167,7 +168,7 @@ typedef volatile struct {
 		      but implementation needs multiple of 128 bytes. */
 } cmdtable_t;
 
-#define BYTES_PER_PRD_SHIFT	20
+#define BYTES_PER_PRD_SHIFT	22
 #define BYTES_PER_PRD		(4 << 20)
 
 enum {
@@ -191,12 +192,18 @@ typedef struct {
 	hba_port_t *port;
 
 	cmd_t *cmdlist;
-	cmdtable_t *cmdtable;
+	cmdtable_t *cmdtable; /* One per command slot. */
 	rcvd_fis_t *rcvd_fis;
+	int slots;
 
 	u8 *buf, *user_buf;
 	int write_back;
 	size_t buflen;
+
+	/* Native command queuing state. */
+	u32 queued;		/* slots with a queued command */
+	u32 queued_failed;	/* queued commands aborted by an error */
+	size_t queued_bytes[32];
 } ahci_dev_t;
 
 /*
@@ -212,6 +219,14 @@ size_t ahci_cmdslot_prepare(ahci_dev_t *const dev,
 		   u8 *const user_buf, size_t buf_len,
 		   const int out);
 
+size_t ahci_cmdslot_prepare_queued(ahci_dev_t *const dev, const int slotnum,
+		   u8 *const buf, size_t buf_len);
+
+int ahci_cmdslot_queue(ahci_dev_t *const dev, const int slotnum,
+		   const size_t bytes);
+
+ssize_t ahci_cmdslot_reap(ahci_dev_t *const dev, const int slotnum);
+
 int ahci_identify_device(ata_dev_t *const ata_dev, u8 *const buf);
 
 int ahci_error_recovery(ahci_dev_t *const dev, const u32 intr_status);
@@ -230,5 +245,11 @@ ssize_t ahci_ata_read_sectors(ata_dev_t *const ata_dev,
 		     const lba_t start, size_t count,
 		     u8 *const buf);
 
+int ahci_ata_submit_read(ata_dev_t *const ata_dev,
+		     const lba_t start, const size_t count,
+		     u8 *const buf);
+
+ssize_t ahci_ata_reap_read(ata_dev_t *const ata_dev, const int tag);
+
 
 #endif /* _AHCI_PRIVATE_H */
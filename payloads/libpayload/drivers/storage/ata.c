@@ -136,6 +136,36 @@ static ssize_t ata_read512(storage_dev_t *_dev,
 	}
 }
 
+static int ata_submit_read512(storage_dev_t *_dev,
+			      const lba_t start, const size_t count,
+			      unsigned char *const buf)
+{
+	ata_dev_t *const dev = (ata_dev_t *)_dev;
+
+	if (dev->sector_size == 512)
+		return dev->submit_read_sectors(dev, start, count, buf);
+
+	/* Only whole sectors can be queued, let the caller read the rest. */
+	const size_t mask = (dev->sector_size >> 9) - 1;
+	if (dev->sector_size < 512 || (start & mask) || (count & mask))
+		return -1;
+
+	const size_t shift = dev->sector_size_shift - 9;
+	return dev->submit_read_sectors(dev,
+			start >> shift, count >> shift, buf);
+}
+
+static ssize_t ata_reap_read512(storage_dev_t *_dev, const int tag)
+{
+	ata_dev_t *const dev = (ata_dev_t *)_dev;
+
+	const ssize_t ret = dev->reap_read_sectors(dev, tag);
+	if (ret < 0)
+		return ret;
+	else
+		return ret << (dev->sector_size_shift - 9);
+}
+
 static ssize_t ata_write512(storage_dev_t *const dev,
 			    const lba_t start, const size_t count,
 			    const unsigned char *const buf)
@@ -148,6 +178,11 @@ void ata_initialize_storage_ops(ata_dev_t *const dev)
 {
 	dev->storage_dev.read_blocks512 = ata_read512;
 	dev->storage_dev.write_blocks512 = ata_write512;
+	if (dev->queue_depth && dev->submit_read_sectors &&
+			dev->reap_read_sectors) {
+		dev->storage_dev.submit_read512 = ata_submit_read512;
+		dev->storage_dev.reap_read512 = ata_reap_read512;
+	}
 }
 
 int ata_set_sector_size(ata_dev_t *const dev, u32 sector_size)
@@ -223,6 +258,14 @@ int ata_attach_device(ata_dev_t *const dev, const storage_port_t port_type)
 	dev->read_cmd = ATA_READ_DMA;
 #endif
 
+	/* Word 76 is reserved (0 or 0xffff) for parallel ATA drives. */
+	if (id[ATA_ID_SATA_CAPABILITIES] != 0xffff &&
+			(id[ATA_ID_SATA_CAPABILITIES] & (1 << 8))) {
+		dev->queue_depth = (id[ATA_ID_QUEUE_DEPTH] & 0x1f) + 1;
+		printf("ata: NCQ supported (queue depth %zu).\n",
+		       dev->queue_depth);
+	}
+
 	if (ata_decode_sector_size(dev, id))
 		return -1;
 
@@ -0,0 +1,709 @@
+/*
+ * This file is part of the libpayload project.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <libpayload.h>
+#include <pci.h>
+#include <arch/barrier.h>
+#include <storage/storage.h>
+#include <storage/nvme.h>
+
+
+typedef volatile struct {
+	u64 cap;
+	u32 version;
+	u32 intr_mask_set;
+	u32 intr_mask_clear;
+	u32 cc;
+	u32 _reserved0;
+	u32 csts;
+	u32 subsys_reset;
+	u32 aqa;
+	u64 asq;
+	u64 acq;
+} nvme_regs_t;
+
+#define NVME_CAP_MQES(cap)	((cap) & 0xffff)	/* 0's based */
+#define NVME_CAP_TO(cap)	(((cap) >> 24) & 0xff)	/* in 500ms units */
+#define NVME_CAP_DSTRD(cap)	(((cap) >> 32) & 0xf)
+#define NVME_CAP_MPSMIN(cap)	(((cap) >> 48) & 0xf)
+
+#define NVME_CC_EN		(1 << 0)
+#define NVME_CC_IOSQES(x)	((x) << 16)	/* log2 of SQ entry size */
+#define NVME_CC_IOCQES(x)	((x) << 20)	/* log2 of CQ entry size */
+
+#define NVME_CSTS_RDY		(1 << 0)
+#define NVME_CSTS_CFS		(1 << 1)
+
+#define NVME_DOORBELLS		0x1000
+
+/* Submission queue entry */
+typedef struct {
+	u32 cdw0;
+	u32 nsid;
+	u64 _reserved0;
+	u64 mptr;
+	u64 prp1;
+	u64 prp2;
+	u32 cdw10;
+	u32 cdw11;
+	u32 cdw12;
+	u32 cdw13;
+	u32 cdw14;
+	u32 cdw15;
+} nvme_sqe_t;
+
+#define NVME_SQE_CDW0(opcode, cid)	((opcode) | (cid) << 16)
+
+/* Completion queue entry */
+typedef volatile struct {
+	u32 result;
+	u32 _reserved0;
+	u16 sq_head;
+	u16 sq_id;
+	u16 cid;
+	u16 status;
+} nvme_cqe_t;
+
+#define NVME_CQE_PHASE		(1 << 0)
+#define NVME_CQE_STATUS(s)	((s) >> 1)
+
+enum {
+	NVME_ADMIN_CREATE_SQ	= 0x01,
+	NVME_ADMIN_CREATE_CQ	= 0x05,
+	NVME_ADMIN_IDENTIFY	= 0x06,
+	NVME_ADMIN_SET_FEATURES	= 0x09,
+};
+
+enum {
+	NVME_CMD_READ		= 0x02,
+};
+
+#define NVME_IDENTIFY_NS	0
+#define NVME_IDENTIFY_CTRL	1
+#define NVME_FEAT_NUM_QUEUES	0x07
+
+/* Byte offsets into the identify data. */
+enum {
+	NVME_ID_CTRL_MODEL	=  24,
+	NVME_ID_CTRL_MDTS	=  77,
+	NVME_ID_CTRL_NN		= 516,
+	NVME_ID_NS_NSZE		=   0,
+	NVME_ID_NS_FLBAS	=  26,
+	NVME_ID_NS_LBAF		= 128,
+};
+
+#define NVME_PAGE_SHIFT		12
+#define NVME_PAGE_SIZE		(1 << NVME_PAGE_SHIFT)
+
+#define NVME_ADMIN_QUEUE_SIZE	8
+#define NVME_IO_QUEUE_SIZE	64
+/* Commands in flight on the I/O queue, their command id is the slot. */
+#define NVME_SLOTS		32
+/* Each slot has a PRP list of 1KiB, which limits a command to 512KiB. */
+#define NVME_PRP_ENTRIES	128
+#define NVME_MAX_XFER		(NVME_PRP_ENTRIES << NVME_PAGE_SHIFT)
+#define NVME_BOUNCE_SIZE	(64 * 1024)
+#define NVME_MAX_NAMESPACES	16
+
+typedef struct {
+	nvme_sqe_t *sq;
+	nvme_cqe_t *cq;
+	u16 id;
+	u16 size;
+	u16 sq_tail;
+	u16 cq_head;
+	u16 phase;
+	volatile u32 *sq_doorbell;
+	volatile u32 *cq_doorbell;
+} nvme_queue_t;
+
+typedef struct {
+	nvme_regs_t *regs;
+	int timeout_ms;
+
+	nvme_queue_t admin;
+	nvme_queue_t io;
+
+	size_t max_xfer;	/* bytes per command */
+	int slots;
+	u32 busy;		/* slots with a command in flight */
+	u32 done;		/* slots with a completed command */
+	u32 failed;		/* slots with a failed command */
+
+	/* Reads are split into commands, tagged by their first slot. */
+	u32 req_cmds[NVME_SLOTS];
+	size_t req_bytes[NVME_SLOTS];
+
+	u64 *prp_lists;
+	u8 *bounce;
+} nvme_ctrl_t;
+
+typedef struct {
+	storage_dev_t storage_dev;
+
+	nvme_ctrl_t *ctrl;
+	u32 id;
+	unsigned int lba_shift;
+} nvme_ns_t;
+
+
+static void nvme_sq_push(nvme_queue_t *const q, const nvme_sqe_t *const cmd)
+{
+	memcpy(&q->sq[q->sq_tail], cmd, sizeof(*cmd));
+	if (++q->sq_tail == q->size)
+		q->sq_tail = 0;
+}
+
+static void nvme_sq_ring(nvme_queue_t *const q)
+{
+	wmb();
+	*q->sq_doorbell = q->sq_tail;
+}
+
+/** Take the next completion off a queue, returns 0 if there is none. */
+static int nvme_cq_pop(nvme_queue_t *const q, u16 *const cid,
+		       u16 *const status)
+{
+	nvme_cqe_t *const cqe = &q->cq[q->cq_head];
+
+	if ((cqe->status & NVME_CQE_PHASE) != q->phase)
+		return 0;
+	rmb();
+
+	*cid = cqe->cid;
+	*status = NVME_CQE_STATUS(cqe->status);
+
+	if (++q->cq_head == q->size) {
+		q->cq_head = 0;
+		q->phase ^= NVME_CQE_PHASE;
+	}
+	*q->cq_doorbell = q->cq_head;
+
+	return 1;
+}
+
+static int nvme_admin_cmd(nvme_ctrl_t *const ctrl, nvme_sqe_t *const cmd)
+{
+	u16 cid, status;
+
+	/* Admin commands run one at a time, so the command id is always 0. */
+	nvme_sq_push(&ctrl->admin, cmd);
+	nvme_sq_ring(&ctrl->admin);
+
+	int timeout = 50000; /* Time out after 50000 * 100us == 5s. */
+	while (!nvme_cq_pop(&ctrl->admin, &cid, &status) && timeout--)
+		udelay(100);
+	if (timeout < 0) {
+		printf("nvme: Timeout during admin command 0x%02x.\n",
+		       cmd->cdw0 & 0xff);
+		return -1;
+	}
+	if (status) {
+		printf("nvme: Admin command 0x%02x failed (status 0x%x).\n",
+		       cmd->cdw0 & 0xff, status);
+		return -1;
+	}
+	return 0;
+}
+
+/** Collect the completions of I/O commands. */
+static void nvme_io_poll(nvme_ctrl_t *const ctrl)
+{
+	u16 cid, status;
+
+	while (nvme_cq_pop(&ctrl->io, &cid, &status)) {
+		if (cid >= ctrl->slots || !(ctrl->busy & (1 << cid)))
+			continue;
+		ctrl->done |= 1 << cid;
+		if (status) {
+			printf("nvme: Command %u failed (status 0x%x).\n",
+			       cid, status);
+			ctrl->failed |= 1 << cid;
+		}
+	}
+}
+
+static void nvme_fill_prps(nvme_ctrl_t *const ctrl, const int slot,
+			   nvme_sqe_t *const cmd, u8 *buf, size_t len)
+{
+	const size_t first = NVME_PAGE_SIZE -
+		(virt_to_phys(buf) & (NVME_PAGE_SIZE - 1));
+	int i;
+
+	cmd->prp1 = virt_to_phys(buf);
+	if (len <= first)
+		return;
+	len -= first;
+	buf += first;
+
+	if (len <= NVME_PAGE_SIZE) {
+		cmd->prp2 = virt_to_phys(buf);
+		return;
+	}
+
+	/* Everything after the first page is page aligned. */
+	u64 *const prp_list = &ctrl->prp_lists[slot * NVME_PRP_ENTRIES];
+	for (i = 0; len > 0; ++i) {
+		const size_t bytes = MIN(len, NVME_PAGE_SIZE);
+		prp_list[i] = virt_to_phys(buf);
+		len -= bytes;
+		buf += bytes;
+	}
+	cmd->prp2 = virt_to_phys(prp_list);
+}
+
+/**
+ * Queue a read as one or more commands, returns a tag for nvme_reap().
+ * The buffer is used for DMA directly, so it has to be dword aligned.
+ */
+static int nvme_submit_read(nvme_ns_t *const ns, u64 lba, size_t sectors,
+			    u8 *buf)
+{
+	nvme_ctrl_t *const ctrl = ns->ctrl;
+	const size_t per_cmd = ctrl->max_xfer >> ns->lba_shift;
+	const size_t bytes = sectors << ns->lba_shift;
+	u32 cmds = 0;
+	int slot, needed, tag = -1;
+
+	if (!sectors || ((uintptr_t)buf & 3) || !dma_coherent(buf))
+		return -1;
+
+	/* Reserve all slots first, we don't queue half a read. */
+	needed = (sectors + per_cmd - 1) / per_cmd;
+	for (slot = 0; slot < ctrl->slots && needed; ++slot) {
+		if (!(ctrl->busy & (1 << slot))) {
+			cmds |= 1 << slot;
+			--needed;
+		}
+	}
+	if (needed)
+		return -1;
+
+	for (slot = 0; slot < ctrl->slots; ++slot) {
+		if (!(cmds & (1 << slot)))
+			continue;
+
+		const size_t n = MIN(sectors, per_cmd);
+		nvme_sqe_t cmd;
+
+		memset(&cmd, 0, sizeof(cmd));
+		cmd.cdw0 = NVME_SQE_CDW0(NVME_CMD_READ, slot);
+		cmd.nsid = ns->id;
+		nvme_fill_prps(ctrl, slot, &cmd, buf, n << ns->lba_shift);
+		cmd.cdw10 = lba & 0xffffffff;
+		cmd.cdw11 = lba >> 32;
+		cmd.cdw12 = n - 1;
+		nvme_sq_push(&ctrl->io, &cmd);
+
+		if (tag < 0)
+			tag = slot;
+		lba += n;
+		sectors -= n;
+		buf += n << ns->lba_shift;
+	}
+
+	ctrl->busy |= cmds;
+	ctrl->req_cmds[tag] = cmds;
+	ctrl->req_bytes[tag] = bytes;
+	nvme_sq_ring(&ctrl->io);
+
+	return tag;
+}
+
+/** Wait for a queued read, returns the number of bytes read. */
+static ssize_t nvme_reap(nvme_ctrl_t *const ctrl, const int tag)
+{
+	if (tag < 0 || tag >= ctrl->slots || !ctrl->req_cmds[tag])
+		return -1;
+
+	const u32 cmds = ctrl->req_cmds[tag];
+	ctrl->req_cmds[tag] = 0;
+
+	int timeout = 50000; /* Time out after 50000 * 100us == 5s. */
+	for (nvme_io_poll(ctrl); (ctrl->done & cmds) != cmds && timeout--;
+							nvme_io_poll(ctrl))
+		udelay(100);
+	if (timeout < 0) {
+		printf("nvme: Timeout during read.\n");
+		/* The controller might still write to the buffer, so never
+		   hand out the slots of unfinished commands again. */
+		ctrl->busy &= ~(cmds & ctrl->done);
+		ctrl->done &= ~cmds;
+		ctrl->failed &= ~cmds;
+		return -1;
+	}
+
+	ctrl->busy &= ~cmds;
+	ctrl->done &= ~cmds;
+	if (ctrl->failed & cmds) {
+		ctrl->failed &= ~cmds;
+		return -1;
+	}
+	return ctrl->req_bytes[tag];
+}
+
+static int nvme_free_slots(const nvme_ctrl_t *const ctrl)
+{
+	int slot, free_slots = 0;
+
+	for (slot = 0; slot < ctrl->slots; ++slot) {
+		if (!(ctrl->busy & (1 << slot)))
+			++free_slots;
+	}
+	return free_slots;
+}
+
+static int nvme_submit_read512(storage_dev_t *const dev,
+			       const lba_t start, const size_t count,
+			       unsigned char *const buf)
+{
+	nvme_ns_t *const ns = (nvme_ns_t *)dev;
+	const unsigned int shift = ns->lba_shift - 9;
+	const lba_t mask = (1 << shift) - 1;
+
+	if ((start & mask) || (count & mask))
+		return -1;
+
+	return nvme_submit_read(ns, start >> shift, count >> shift, buf);
+}
+
+static ssize_t nvme_reap_read512(storage_dev_t *const dev, const int tag)
+{
+	nvme_ns_t *const ns = (nvme_ns_t *)dev;
+
+	const ssize_t bytes = nvme_reap(ns->ctrl, tag);
+	if (bytes < 0)
+		return -1;
+	else
+		return bytes >> 9;
+}
+
+static ssize_t nvme_read512(storage_dev_t *const dev,
+			    const lba_t start, const size_t count,
+			    unsigned char *const buf)
+{
+	nvme_ns_t *const ns = (nvme_ns_t *)dev;
+	nvme_ctrl_t *const ctrl = ns->ctrl;
+	const unsigned int shift = ns->lba_shift - 9;
+	const lba_t mask = (1 << shift) - 1;
+	size_t done = 0;
+
+	while (done < count) {
+		const lba_t blk = start + done;
+		u8 *const dst = buf + (done << 9);
+		size_t n = count - done;
+		ssize_t ret = -1;
+		int tag;
+
+		if (!(blk & mask) && n > mask &&
+				!((uintptr_t)dst & 3) && dma_coherent(dst)) {
+			/* Read straight into the caller's buffer. */
+			n = MIN(n & ~mask, nvme_free_slots(ctrl) *
+					   (ctrl->max_xfer >> 9));
+			tag = nvme_submit_read512(dev, blk, n, dst);
+			if (tag >= 0)
+				ret = nvme_reap_read512(dev, tag);
+		} else {
+			/* Partial sectors and buffers we can't DMA to. */
+			const size_t offset = blk & mask;
+			n = MIN(n, (NVME_BOUNCE_SIZE >> 9) - offset);
+			tag = nvme_submit_read(ns, blk >> shift,
+					(offset + n + mask) >> shift,
+					ctrl->bounce);
+			if (tag >= 0 && nvme_reap(ctrl, tag) >= 0) {
+				memcpy(dst, ctrl->bounce + (offset << 9),
+				       n << 9);
+				ret = n;
+			}
+		}
+
+		if (ret != n)
+			break;
+		done += n;
+	}
+
+	if (!done && count)
+		return -1;
+	else
+		return done;
+}
+
+static int nvme_wait_ready(nvme_ctrl_t *const ctrl, const u32 ready)
+{
+	int timeout = ctrl->timeout_ms;
+	while ((ctrl->regs->csts & NVME_CSTS_RDY) != ready && timeout--)
+		mdelay(1);
+	if (timeout < 0) {
+		printf("nvme: Timeout during %s of controller.\n",
+		       ready ? "enabling" : "disabling");
+		return -1;
+	}
+	return 0;
+}
+
+static int nvme_queue_alloc(nvme_ctrl_t *const ctrl, nvme_queue_t *const q,
+			    const u16 id, const u16 size, const size_t stride)
+{
+	u8 *const doorbells = (u8 *)ctrl->regs + NVME_DOORBELLS;
+
+	q->sq = dma_memalign(NVME_PAGE_SIZE, size * sizeof(nvme_sqe_t));
+	q->cq = dma_memalign(NVME_PAGE_SIZE, size * sizeof(nvme_cqe_t));
+	if (!q->sq || !q->cq)
+		return -1;
+	memset(q->sq, 0, size * sizeof(nvme_sqe_t));
+	memset((void *)q->cq, 0, size * sizeof(nvme_cqe_t));
+
+	q->id = id;
+	q->size = size;
+	q->sq_tail = 0;
+	q->cq_head = 0;
+	q->phase = NVME_CQE_PHASE;
+	q->sq_doorbell = (volatile u32 *)(doorbells + (2 * id) * stride);
+	q->cq_doorbell = (volatile u32 *)(doorbells + (2 * id + 1) * stride);
+
+	return 0;
+}
+
+static int nvme_create_io_queue(nvme_ctrl_t *const ctrl)
+{
+	const u32 qid_size = (ctrl->io.size - 1) << 16 | ctrl->io.id;
+	nvme_sqe_t cmd;
+
+	/* Ask for one I/O queue pair, it's all we use. */
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.cdw0 = NVME_SQE_CDW0(NVME_ADMIN_SET_FEATURES, 0);
+	cmd.cdw10 = NVME_FEAT_NUM_QUEUES;
+	if (nvme_admin_cmd(ctrl, &cmd))
+		return -1;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.cdw0 = NVME_SQE_CDW0(NVME_ADMIN_CREATE_CQ, 0);
+	cmd.prp1 = virt_to_phys((void *)ctrl->io.cq);
+	cmd.cdw10 = qid_size;
+	cmd.cdw11 = 1; /* physically contiguous, no interrupts */
+	if (nvme_admin_cmd(ctrl, &cmd))
+		return -1;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.cdw0 = NVME_SQE_CDW0(NVME_ADMIN_CREATE_SQ, 0);
+	cmd.prp1 = virt_to_phys(ctrl->io.sq);
+	cmd.cdw10 = qid_size;
+	cmd.cdw11 = ctrl->io.id << 16 | 1; /* CQ id, physically contiguous */
+	return nvme_admin_cmd(ctrl, &cmd);
+}
+
+static int nvme_identify(nvme_ctrl_t *const ctrl, const u32 cns,
+			 const u32 nsid, u8 *const buf)
+{
+	nvme_sqe_t cmd;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.cdw0 = NVME_SQE_CDW0(NVME_ADMIN_IDENTIFY, 0);
+	cmd.nsid = nsid;
+	cmd.prp1 = virt_to_phys(buf);
+	cmd.cdw10 = cns;
+	return nvme_admin_cmd(ctrl, &cmd);
+}
+
+static int nvme_attach_namespace(nvme_ctrl_t *const ctrl, const u32 nsid,
+				 const u8 *const id)
+{
+	const u64 sectors = *(const u64 *)(id + NVME_ID_NS_NSZE);
+	if (!sectors)
+		return -1;
+
+	const u32 lbaf = *(const u32 *)(id + NVME_ID_NS_LBAF +
+					4 * (id[NVME_ID_NS_FLBAS] & 0xf));
+	const unsigned int lba_shift = (lbaf >> 16) & 0xff;
+	if ((lbaf & 0xffff) || lba_shift < 9 || lba_shift > NVME_PAGE_SHIFT) {
+		printf("nvme: Unsupported format of namespace %u.\n", nsid);
+		return -1;
+	}
+
+	nvme_ns_t *const ns = calloc(1, sizeof(*ns));
+	if (!ns)
+		return -1;
+
+	ns->ctrl = ctrl;
+	ns->id = nsid;
+	ns->lba_shift = lba_shift;
+	ns->storage_dev.port_type = PORT_TYPE_NVME;
+	ns->storage_dev.read_blocks512 = nvme_read512;
+	ns->storage_dev.submit_read512 = nvme_submit_read512;
+	ns->storage_dev.reap_read512 = nvme_reap_read512;
+
+	printf("nvme: Namespace %u with %llu sectors of %u bytes.\n",
+	       nsid, (unsigned long long)sectors, 1 << lba_shift);
+
+	if (storage_attach_device(&ns->storage_dev)) {
+		free(ns);
+		return -1;
+	}
+	return 0;
+}
+
+static void nvme_ctrl_free(nvme_ctrl_t *const ctrl)
+{
+	free(ctrl->bounce);
+	free(ctrl->prp_lists);
+	free((void *)ctrl->io.cq);
+	free(ctrl->io.sq);
+	free((void *)ctrl->admin.cq);
+	free(ctrl->admin.sq);
+	free(ctrl);
+}
+
+static void nvme_ctrl_init(nvme_regs_t *const regs)
+{
+	u8 *id = NULL;
+	int attached = 0;
+	u32 nsid;
+	int i;
+
+	nvme_ctrl_t *const ctrl = calloc(1, sizeof(*ctrl));
+	if (!ctrl)
+		return;
+	ctrl->regs = regs;
+
+	const u64 cap = regs->cap;
+	if (NVME_CAP_MPSMIN(cap) > 0) {
+		printf("nvme: Controller doesn't support 4KiB pages.\n");
+		goto _free_ret;
+	}
+	ctrl->timeout_ms = MAX(NVME_CAP_TO(cap), 1) * 500;
+	const size_t stride = 4 << NVME_CAP_DSTRD(cap);
+
+	regs->cc &= ~NVME_CC_EN;
+	if (nvme_wait_ready(ctrl, 0))
+		goto _free_ret;
+
+	const u16 io_size = MIN(NVME_IO_QUEUE_SIZE, NVME_CAP_MQES(cap) + 1);
+	if (nvme_queue_alloc(ctrl, &ctrl->admin, 0,
+			     NVME_ADMIN_QUEUE_SIZE, stride) ||
+	    nvme_queue_alloc(ctrl, &ctrl->io, 1, io_size, stride))
+		goto _free_ret;
+	ctrl->slots = MIN(NVME_SLOTS, io_size - 1);
+
+	ctrl->prp_lists = dma_memalign(NVME_PAGE_SIZE,
+			NVME_SLOTS * NVME_PRP_ENTRIES * sizeof(u64));
+	ctrl->bounce = dma_memalign(NVME_PAGE_SIZE, NVME_BOUNCE_SIZE);
+	id = dma_memalign(NVME_PAGE_SIZE, NVME_PAGE_SIZE);
+	if (!ctrl->prp_lists || !ctrl->bounce || !id)
+		goto _free_ret;
+
+	regs->aqa = (NVME_ADMIN_QUEUE_SIZE - 1) << 16 |
+		    (NVME_ADMIN_QUEUE_SIZE - 1);
+	regs->asq = virt_to_phys(ctrl->admin.sq);
+	regs->acq = virt_to_phys((void *)ctrl->admin.cq);
+	/* 4KiB pages (MPS == 0), NVM command set (CSS == 0). */
+	regs->cc = NVME_CC_IOSQES(6) | NVME_CC_IOCQES(4) | NVME_CC_EN;
+	if (nvme_wait_ready(ctrl, NVME_CSTS_RDY))
+		goto _disable_ret;
+
+	if (nvme_identify(ctrl, NVME_IDENTIFY_CTRL, 0, id))
+		goto _disable_ret;
+
+	char model[41];
+	memcpy(model, id + NVME_ID_CTRL_MODEL, 40);
+	model[40] = '\0';
+	for (i = 39; i > 0 && model[i] == ' '; --i)
+		model[i] = '\0';
+	printf("nvme: Identified %s\n", model);
+
+	ctrl->max_xfer = NVME_MAX_XFER;
+	if (id[NVME_ID_CTRL_MDTS])
+		ctrl->max_xfer = MIN(ctrl->max_xfer,
+				(size_t)NVME_PAGE_SIZE << id[NVME_ID_CTRL_MDTS]);
+	const u32 nn = MIN(*(u32 *)(id + NVME_ID_CTRL_NN),
+			   NVME_MAX_NAMESPACES);
+
+	if (nvme_create_io_queue(ctrl))
+		goto _disable_ret;
+
+	for (nsid = 1; nsid <= nn; ++nsid) {
+		if (!nvme_identify(ctrl, NVME_IDENTIFY_NS, nsid, id) &&
+				!nvme_attach_namespace(ctrl, nsid, id))
+			++attached;
+	}
+	free(id);
+	id = NULL;
+	if (attached)
+		return;
+
+_disable_ret:
+	regs->cc &= ~NVME_CC_EN;
+	nvme_wait_ready(ctrl, 0);
+_free_ret:
+	free(id);
+	nvme_ctrl_free(ctrl);
+}
+
+static void nvme_init_pci(const pcidev_t dev)
+{
+	if (pci_read_config16(dev, REG_SUBCLASS) != 0x0108 ||
+			pci_read_config8(dev, REG_PROG_IF) != 0x02)
+		return;
+
+	printf("nvme: Found NVMe controller %02x:%02x.%02x (%04x:%04x).\n",
+		PCI_BUS(dev), PCI_SLOT(dev), PCI_FUNC(dev),
+		pci_read_config16(dev, REG_VENDOR_ID),
+		pci_read_config16(dev, REG_DEVICE_ID));
+
+	const u32 bar_lo = pci_read_config32(dev, REG_BAR0);
+	u64 bar = bar_lo & ~0xf;
+	if (bar_lo & 0x4) /* 64-bit BAR */
+		bar |= (u64)pci_read_config32(dev, REG_BAR1) << 32;
+	if (!bar || bar != (uintptr_t)bar) {
+		printf("nvme: Can't access BAR at 0x%llx.\n",
+		       (unsigned long long)bar);
+		return;
+	}
+
+	pci_write_config16(dev, REG_COMMAND, pci_read_config16(dev, REG_COMMAND)
+			   | REG_COMMAND_MEM | REG_COMMAND_BM);
+
+	nvme_ctrl_init(phys_to_virt((uintptr_t)bar));
+}
+
+void nvme_initialize(void)
+{
+	int bus, dev, func;
+
+	for (bus = 0; bus < 256; ++bus) {
+		for (dev = 0; dev < 32; ++dev) {
+			const u16 class =
+				pci_read_config16(PCI_DEV(bus, dev, 0), 0xa);
+			if (class != 0xffff) {
+				for (func = 0; func < 8; ++func)
+					nvme_init_pci(PCI_DEV(bus, dev, func));
+			}
+		}
+	}
+}
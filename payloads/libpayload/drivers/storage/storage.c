@@ -31,6 +31,9 @@
 #if IS_ENABLED(CONFIG_LP_STORAGE_AHCI)
 # include <storage/ahci.h>
 #endif
+#if IS_ENABLED(CONFIG_LP_STORAGE_NVME)
+# include <storage/nvme.h>
+#endif
 #include <storage/storage.h>
 
 
@@ -102,6 +105,84 @@ ssize_t storage_read_blocks512(const size_t dev_num,
 		return -1;
 }
 
+/* Queued reads are issued in chunks of 4MiB, at most 32 at a time. */
+#define QUEUED_CHUNK_BLOCKS	(8 * 1024)
+#define QUEUED_MAX		32
+
+/**
+ * Read 512-byte blocks with queued reads
+ *
+ * Like storage_read_blocks512() but keeps multiple reads in flight if
+ * the drive supports it, e.g. through NCQ. Meant for large sequential
+ * reads. Falls back to plain reads for anything that can't be queued.
+ *
+ * @dev_num device number counted from 0
+ * @start number of first block to read from
+ * @count number of blocks to read
+ * @buf buffer where the read data should be written
+ * @return number of blocks read in sequence from start, -1 on error
+ */
+ssize_t storage_read_blocks512_queued(const size_t dev_num,
+				      lba_t start, size_t count,
+				      unsigned char *buf)
+{
+	int tags[QUEUED_MAX];
+	size_t sizes[QUEUED_MAX];
+	size_t head = 0, queued = 0;
+	ssize_t done = 0;
+	int error = 0;
+
+	if (dev_num >= dev_count)
+		return -1;
+
+	storage_dev_t *const dev = devices[dev_num];
+	if (!dev->submit_read512 || !dev->reap_read512)
+		return storage_read_blocks512(dev_num, start, count, buf);
+
+	while ((count && !error) || queued) {
+		if (count && !error && queued < QUEUED_MAX) {
+			const size_t n = MIN(count, QUEUED_CHUNK_BLOCKS);
+			const int tag = dev->submit_read512(dev, start, n, buf);
+			if (tag >= 0) {
+				const size_t i = (head + queued) % QUEUED_MAX;
+				tags[i] = tag;
+				sizes[i] = n;
+				++queued;
+			} else if (!queued) {
+				/* Nothing to wait for, read it directly. */
+				const ssize_t ret =
+					dev->read_blocks512(dev, start, n, buf);
+				if (ret > 0)
+					done += ret;
+				if (ret != n)
+					error = 1;
+			}
+			if (tag >= 0 || !queued) {
+				start += n;
+				count -= n;
+				buf += n << 9;
+				continue;
+			}
+		}
+
+		/* Queue is full or busy, wait for the oldest read. */
+		const ssize_t ret = dev->reap_read512(dev, tags[head]);
+		if (!error) {
+			if (ret > 0)
+				done += ret;
+			if (ret != sizes[head])
+				error = 1;
+		}
+		head = (head + 1) % QUEUED_MAX;
+		--queued;
+	}
+
+	if (error && !done)
+		return -1;
+	else
+		return done;
+}
+
 /**
  * Initializes storage controllers
  *
@@ -113,4 +194,7 @@ void storage_initialize(void)
 #if IS_ENABLED(CONFIG_LP_STORAGE_AHCI)
 	ahci_initialize();
 #endif
+#if IS_ENABLED(CONFIG_LP_STORAGE_NVME)
+	nvme_initialize();
+#endif
 }
@@ -178,6 +178,7 @@ dwc2_rh_init(usbdev_t *dev)
 	dev->port = -1;
 
 	generic_hub_init(dev, 1, &dwc2_rh_ops);
+	dev->poll_interval = USB_ROOT_HUB_POLL_INTERVAL;
 	usb_debug("dwc2_rh_init HPRT 0x%08x p = %p\n ",
 		  readl(dwc2->hprt0), dwc2->hprt0);
 	usb_debug("DWC2: root hub init done\n");
@@ -179,6 +179,7 @@ ehci_rh_init (usbdev_t *dev)
 	int i;
 	dev->destroy = ehci_rh_destroy;
 	dev->poll = ehci_rh_poll;
+	dev->poll_interval = USB_ROOT_HUB_POLL_INTERVAL;
 
 	dev->data = xmalloc(sizeof(rh_inst_t));
 	RH_INST(dev)->n_ports = EHCI_INST(dev->controller)->capabilities->hcsparams & HCS_NPORTS_MASK;
@@ -33,6 +33,10 @@
 #include <usb/usb.h>
 #include "generic_hub.h"
 
+/* Set between generic_hub_defer_root_ports() and the next
+   generic_hub_attach_root_ports() */
+static int generic_hub_root_ports_deferred;
+
 void
 generic_hub_destroy(usbdev_t *const dev)
 {
@@ -252,14 +256,270 @@ generic_hub_init(usbdev_t *const dev, const int num_ports,
 	}
 	for (port = 1; port <= num_ports; ++port)
 		hub->ports[port] = NO_DEV;
+	hub->attach_pending = generic_hub_root_ports_deferred && dev->hub < 0;
 
 	/* Enable all ports */
 	if (ops->enable_port) {
 		for (port = 1; port <= num_ports; ++port)
 			ops->enable_port(dev, port);
-		/* wait once for all ports */
-		mdelay(20);
+		/* wait once for all ports, root hubs that are brought up
+		   together wait in generic_hub_attach_root_ports() */
+		if (!hub->attach_pending)
+			mdelay(20);
 	}
 
 	return 0;
 }
+
+/*
+ * Root hubs initialized from now on leave attaching the devices at their
+ * ports to the next generic_hub_attach_root_ports(), which has to follow.
+ */
+void
+generic_hub_defer_root_ports(void)
+{
+	generic_hub_root_ports_deferred = 1;
+}
+
+#if IS_ENABLED(CONFIG_LP_USB_PARALLEL_INIT)
+enum root_port_state {
+	ROOT_PORT_DEBOUNCE,
+	ROOT_PORT_RESET,
+	ROOT_PORT_ENABLE,
+	ROOT_PORT_READY,
+	ROOT_PORT_FAILED,
+};
+
+struct root_port {
+	usbdev_t *dev;
+	int port;
+	enum root_port_state state;
+	int stable_ms;
+};
+
+static int
+generic_hub_is_pending_root(const usbdev_t *const dev)
+{
+	return dev && dev->poll == generic_hub_poll && GEN_HUB(dev) &&
+		GEN_HUB(dev)->attach_pending;
+}
+
+/* Advances every port in state `from` that is done with it, returns the
+   number of ports still waiting. */
+static int
+generic_hub_step_root_ports(struct root_port *const ports, const int num,
+			    const enum root_port_state from)
+{
+	int i, waiting = 0;
+
+	for (i = 0; i < num; ++i) {
+		struct root_port *const rp = &ports[i];
+		const generic_hub_ops_t *const ops = GEN_HUB(rp->dev)->ops;
+		int state;
+
+		if (rp->state != from)
+			continue;
+
+		switch (from) {
+		case ROOT_PORT_DEBOUNCE: {
+			const int changed =
+				ops->port_status_changed(rp->dev, rp->port);
+			const int connected =
+				ops->port_connected(rp->dev, rp->port);
+			if (changed < 0 || connected < 0) {
+				rp->state = ROOT_PORT_FAILED;
+				continue;
+			}
+			if (!changed && connected) {
+				rp->stable_ms += 1;
+			} else {
+				usb_debug("generic_hub: Unstable connection "
+					  "at %d\n", rp->port);
+				rp->stable_ms = 0;
+			}
+			/* 100ms as in usb20 spec 9.1.2 */
+			if (rp->stable_ms >= 100) {
+				rp->state = ROOT_PORT_RESET;
+				continue;
+			}
+			break;
+		}
+		case ROOT_PORT_RESET:
+			state = ops->port_in_reset(rp->dev, rp->port);
+			if (state < 0) {
+				rp->state = ROOT_PORT_FAILED;
+				continue;
+			} else if (!state) {
+				rp->state = ROOT_PORT_ENABLE;
+				continue;
+			}
+			break;
+		case ROOT_PORT_ENABLE:
+			state = ops->port_enabled(rp->dev, rp->port);
+			if (state < 0) {
+				rp->state = ROOT_PORT_FAILED;
+				continue;
+			} else if (state) {
+				rp->state = ROOT_PORT_READY;
+				continue;
+			}
+			break;
+		default:
+			continue;
+		}
+		++waiting;
+	}
+	return waiting;
+}
+
+/* Moves the ports that timed out in state `from` on to state `to`. */
+static void
+generic_hub_skip_root_ports(struct root_port *const ports, const int num,
+			    const enum root_port_state from,
+			    const enum root_port_state to, const char *what)
+{
+	int i;
+
+	for (i = 0; i < num; ++i) {
+		if (ports[i].state == from) {
+			usb_debug("generic_hub: %s timed out at port %d\n",
+				  what, ports[i].port);
+			ports[i].state = to;
+		}
+	}
+}
+
+/*
+ * Attach the devices at the root ports of all controllers initialized since
+ * generic_hub_defer_root_ports() in one pass. Ports go through the same
+ * steps as in generic_hub_attach_dev(), but each step is taken for all
+ * ports together so that the waits overlap. Ports without a
+ * start_port_reset() op are reset one by one.
+ */
+void
+generic_hub_attach_root_ports(void)
+{
+	struct root_port *ports;
+	hci_t *controller;
+	int num = 0, i, ms;
+	int power_wait = 0;
+
+	generic_hub_root_ports_deferred = 0;
+	for (controller = usb_hcs; controller; controller = controller->next) {
+		const usbdev_t *const dev = controller->devices[0];
+		if (generic_hub_is_pending_root(dev)) {
+			num += GEN_HUB(dev)->num_ports;
+			if (GEN_HUB(dev)->ops->enable_port)
+				power_wait = 1;
+		}
+	}
+	if (!num)
+		return;
+
+	/* generic_hub_init() left the power on wait to us */
+	if (power_wait)
+		mdelay(20);
+
+	ports = malloc(num * sizeof(*ports));
+	if (!ports) {
+		/* the ports will be scanned by usb_poll() */
+		usb_debug("generic_hub: ERROR: Out of memory\n");
+		return;
+	}
+
+	num = 0;
+	for (controller = usb_hcs; controller; controller = controller->next) {
+		usbdev_t *const dev = controller->devices[0];
+		int port;
+
+		if (!generic_hub_is_pending_root(dev))
+			continue;
+		GEN_HUB(dev)->attach_pending = 0;
+		for (port = 1; port <= GEN_HUB(dev)->num_ports; ++port) {
+			if (GEN_HUB(dev)->ports[port] >= 0 ||
+			    GEN_HUB(dev)->ops->port_connected(dev, port) <= 0)
+				continue;
+			usb_debug("generic_hub: Attachment at port %d\n", port);
+			ports[num].dev = dev;
+			ports[num].port = port;
+			ports[num].state = ROOT_PORT_DEBOUNCE;
+			ports[num].stable_ms = 0;
+			++num;
+		}
+	}
+	if (!num)
+		goto out;
+
+	/* Debounce all ports, 1500ms timeout as in generic_hub_debounce() */
+	for (ms = 0; ms < 1500; ++ms) {
+		mdelay(1);
+		if (!generic_hub_step_root_ports(ports, num,
+						 ROOT_PORT_DEBOUNCE))
+			break;
+	}
+	generic_hub_skip_root_ports(ports, num, ROOT_PORT_DEBOUNCE,
+				    ROOT_PORT_RESET, "Debouncing");
+
+	/* Start all resets that we can leave running, then do the rest */
+	for (i = 0; i < num; ++i) {
+		struct root_port *const rp = &ports[i];
+		const generic_hub_ops_t *const ops = GEN_HUB(rp->dev)->ops;
+
+		if (rp->state != ROOT_PORT_RESET)
+			continue;
+		if (!ops->reset_port) {
+			/* nothing to wait for */
+			rp->state = ROOT_PORT_READY;
+		} else if (ops->start_port_reset) {
+			if (ops->start_port_reset(rp->dev, rp->port) < 0)
+				rp->state = ROOT_PORT_FAILED;
+		} else {
+			if (ops->reset_port(rp->dev, rp->port) < 0)
+				rp->state = ROOT_PORT_FAILED;
+			else
+				rp->state = ROOT_PORT_ENABLE;
+		}
+	}
+
+	/* usb20 spec 11.5.1.5: reset should take 10 to 20ms, but root hub
+	   resets are timed by the controller, allow 150ms as xhci_rh does */
+	for (ms = 0; ms < 150; ++ms) {
+		if (!generic_hub_step_root_ports(ports, num, ROOT_PORT_RESET))
+			break;
+		mdelay(1);
+	}
+	generic_hub_skip_root_ports(ports, num, ROOT_PORT_RESET,
+				    ROOT_PORT_ENABLE, "Reset");
+
+	/* after reset the ports will be enabled automatically */
+	for (ms = 0; ms < 10; ++ms) {
+		if (!generic_hub_step_root_ports(ports, num, ROOT_PORT_ENABLE))
+			break;
+		mdelay(1);
+	}
+	generic_hub_skip_root_ports(ports, num, ROOT_PORT_ENABLE,
+				    ROOT_PORT_READY, "Enabling");
+
+	/* Reset recovery time (usb20 spec 7.1.7.5), once for all ports */
+	mdelay(10);
+
+	for (i = 0; i < num; ++i) {
+		struct root_port *const rp = &ports[i];
+		generic_hub_t *const hub = GEN_HUB(rp->dev);
+
+		if (rp->state != ROOT_PORT_READY)
+			continue;
+		const usb_speed speed = hub->ops->port_speed(rp->dev, rp->port);
+		if (speed >= 0) {
+			usb_debug("generic_hub: Success at port %d\n",
+				  rp->port);
+			hub->ports[rp->port] = usb_attach_device(
+					rp->dev->controller, rp->dev->address,
+					rp->port, speed);
+		}
+	}
+
+out:
+	free(ports);
+}
+#endif
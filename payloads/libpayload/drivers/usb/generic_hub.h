@@ -52,7 +52,8 @@ typedef struct generic_hub_ops {
 	int (*enable_port)(usbdev_t *, int port);
 	/* disables (powers down) a port (optional) */
 	int (*disable_port)(usbdev_t *, int port);
-	/* starts a port reset (required if reset_port is set to a generic one from below) */
+	/* starts a port reset (required if reset_port is set to a generic one from below,
+	   lets generic_hub_attach_root_ports() reset root ports in parallel) */
 	int (*start_port_reset)(usbdev_t *, int port);
 
 	/* performs a port reset (optional, generic implementations below) */
@@ -67,6 +68,8 @@ typedef struct generic_hub {
 #define NO_DEV -1
 
 	const generic_hub_ops_t *ops;
+	/* root ports are attached by generic_hub_attach_root_ports() */
+	int attach_pending;
 
 	void *data;
 } generic_hub_t;
@@ -80,6 +83,8 @@ int  generic_hub_resetport(usbdev_t *, int port);
 int  generic_hub_scanport(usbdev_t *, int port);
 /* the provided generic_hub_ops struct has to be static */
 int generic_hub_init(usbdev_t *, int num_ports, const generic_hub_ops_t *);
+void generic_hub_defer_root_ports(void);
+void generic_hub_attach_root_ports(void);
 
 #define GEN_HUB(usbdev) ((generic_hub_t *)(usbdev)->data)
 
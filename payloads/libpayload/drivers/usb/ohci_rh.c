@@ -184,6 +184,7 @@ ohci_rh_init (usbdev_t *dev)
 
 	dev->destroy = ohci_rh_destroy;
 	dev->poll = ohci_rh_poll;
+	dev->poll_interval = USB_ROOT_HUB_POLL_INTERVAL;
 
 	dev->data = xmalloc (sizeof (rh_inst_t));
 	RH_INST (dev)->numports = OHCI_INST (dev->controller)->opreg->HcRhDescriptorA & NumberDownstreamPortsMask;
@@ -196,6 +196,7 @@ uhci_rh_init (usbdev_t *dev)
 {
 	dev->destroy = uhci_rh_destroy;
 	dev->poll = uhci_rh_poll;
+	dev->poll_interval = USB_ROOT_HUB_POLL_INTERVAL;
 
 	uhci_rh_enable_port (dev, 1);
 	uhci_rh_enable_port (dev, 2);
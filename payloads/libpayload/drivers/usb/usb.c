@@ -81,19 +81,32 @@ usb_exit (void)
 
 /**
  * Polls all hubs on all USB controllers, to find out about device changes
+ *
+ * Devices are only polled when their controller reported something for
+ * them or when their poll_interval has passed.
  */
 void
 usb_poll (void)
 {
 	if (usb_hcs == 0)
 		return;
+	const u64 now = timer_us(0);
 	hci_t *controller = usb_hcs;
 	while (controller != NULL) {
 		int i;
+		if (controller->handle_events)
+			controller->handle_events (controller);
 		for (i = 0; i < 128; i++) {
-			if (controller->devices[i] != 0) {
-				controller->devices[i]->poll (controller->devices[i]);
-			}
+			usbdev_t *const dev = controller->devices[i];
+			if (dev == 0)
+				continue;
+			if (!dev->poll_pending && dev->poll_interval &&
+					now < dev->next_poll)
+				continue;
+			/* poll() might detach the device, update it first */
+			dev->poll_pending = 0;
+			dev->next_poll = now + dev->poll_interval;
+			dev->poll (dev);
 		}
 		controller = controller->next;
 	}
@@ -195,6 +208,21 @@ set_configuration (usbdev_t *dev)
 	return dev->controller->control (dev, OUT, sizeof (dr), &dr, 0, 0);
 }
 
+int
+set_interface (usbdev_t *dev, int intf, int alt)
+{
+	dev_req_t dr;
+
+	dr.bmRequestType = 0;
+	dr.req_recp = iface_recp;
+	dr.bRequest = SET_INTERFACE;
+	dr.wValue = alt;
+	dr.wIndex = intf;
+	dr.wLength = 0;
+
+	return dev->controller->control (dev, OUT, sizeof (dr), &dr, 0, 0);
+}
+
 int
 clear_feature (usbdev_t *dev, int endp, int feature, int rtype)
 {
@@ -382,6 +410,73 @@ generic_set_address (hci_t *controller, usb_speed speed,
 	return dev;
 }
 
+/*
+ * Sets up the endpoints of `intf`, an interface descriptor inside the
+ * device's configuration descriptor, and selects its alternate setting.
+ * May be called again to switch a configured device to another alternate
+ * setting. Returns 0 on success, < 0 on error.
+ */
+int
+usb_configure_interface (usbdev_t *dev, interface_descriptor_t *intf)
+{
+	hci_t *const controller = dev->controller;
+	u8 *const end = (void *)dev->configuration +
+			dev->configuration->wTotalLength;
+	u8 *ptr;
+
+	/* Gather up all endpoints belonging to this inteface */
+	dev->num_endp = 1;
+	for (ptr = (void *)intf + sizeof(*intf);
+			ptr + 2 <= end && ptr[0] && ptr + ptr[0] <= end;
+			ptr += ptr[0]) {
+		if (ptr[1] == DT_INTF || ptr[1] == DT_CFG ||
+				dev->num_endp >= ARRAY_SIZE(dev->endpoints))
+			break;
+		if (ptr[1] == DT_SS_ENDP_COMP && ptr[0] >= 4 &&
+				dev->num_endp > 1) {
+			/* For bulk endpoints, log2 of the streams supported */
+			endpoint_t *const ep = &dev->endpoints[dev->num_endp - 1];
+			if (ep->type == BULK && (ptr[3] & 0x1f))
+				ep->max_streams = 1 << (ptr[3] & 0x1f);
+			continue;
+		}
+		if (ptr[1] != DT_ENDP)
+			continue;
+
+		endpoint_descriptor_t *desc = (void *)ptr;
+		static const char *transfertypes[4] = {
+			"control", "isochronous", "bulk", "interrupt"
+		};
+		usb_debug (" #Endpoint %d (%s), max packet size %x, type %s\n",
+			desc->bEndpointAddress & 0x7f,
+			(desc->bEndpointAddress & 0x80) ? "in" : "out",
+			desc->wMaxPacketSize,
+			transfertypes[desc->bmAttributes & 0x3]);
+
+		endpoint_t *ep = &dev->endpoints[dev->num_endp++];
+		ep->dev = dev;
+		ep->endpoint = desc->bEndpointAddress;
+		ep->toggle = 0;
+		ep->maxpacketsize = desc->wMaxPacketSize;
+		ep->direction = (desc->bEndpointAddress & 0x80) ? IN : OUT;
+		ep->type = desc->bmAttributes & 0x3;
+		ep->interval = usb_decode_interval (dev->speed, ep->type,
+						    desc->bInterval);
+		ep->max_streams = 0;
+	}
+
+	if ((controller->finish_device_config &&
+			controller->finish_device_config(dev)) ||
+			set_configuration(dev) < 0 ||
+			(intf->bAlternateSetting &&
+			 set_interface(dev, intf->bInterfaceNumber,
+				       intf->bAlternateSetting) < 0)) {
+		usb_debug ("Could not finalize device configuration\n");
+		return -1;
+	}
+	return 0;
+}
+
 static int
 set_address (hci_t *controller, usb_speed speed, int hubport, int hubaddr)
 {
@@ -491,40 +586,31 @@ set_address (hci_t *controller, usb_speed speed, int hubport, int hubaddr)
 		break;
 	}
 
-	/* Gather up all endpoints belonging to this inteface */
-	dev->num_endp = 1;
-	for (; ptr + 2 <= end && ptr[0] && ptr + ptr[0] <= end; ptr += ptr[0]) {
-		if (ptr[1] == DT_INTF || ptr[1] == DT_CFG ||
-				dev->num_endp >= ARRAY_SIZE(dev->endpoints))
-			break;
-		if (ptr[1] != DT_ENDP)
+#if IS_ENABLED(CONFIG_LP_USB_UAS)
+	/* Prefer the UAS alternate setting of SuperSpeed storage devices,
+	   it needs streams which only queued bulk transfers support. */
+	u8 *alt;
+	for (alt = ptr; dev->speed == SUPER_SPEED && controller->bulk_submit &&
+			controller->max_streams &&
+			alt + 2 <= end && alt[0] && alt + alt[0] <= end;
+			alt += alt[0]) {
+		interface_descriptor_t *const uas = (void *)alt;
+		if (alt[1] != DT_INTF || uas->bLength != sizeof(*uas))
 			continue;
-
-		endpoint_descriptor_t *desc = (void *)ptr;
-		static const char *transfertypes[4] = {
-			"control", "isochronous", "bulk", "interrupt"
-		};
-		usb_debug (" #Endpoint %d (%s), max packet size %x, type %s\n",
-			desc->bEndpointAddress & 0x7f,
-			(desc->bEndpointAddress & 0x80) ? "in" : "out",
-			desc->wMaxPacketSize,
-			transfertypes[desc->bmAttributes & 0x3]);
-
-		endpoint_t *ep = &dev->endpoints[dev->num_endp++];
-		ep->dev = dev;
-		ep->endpoint = desc->bEndpointAddress;
-		ep->toggle = 0;
-		ep->maxpacketsize = desc->wMaxPacketSize;
-		ep->direction = (desc->bEndpointAddress & 0x80) ? IN : OUT;
-		ep->type = desc->bmAttributes & 0x3;
-		ep->interval = usb_decode_interval (dev->speed, ep->type,
-						    desc->bInterval);
+		if (uas->bInterfaceNumber != intf->bInterfaceNumber)
+			break;
+		if (uas->bInterfaceClass == 0x08 &&
+				uas->bInterfaceProtocol == 0x62) {
+			usb_debug ("Using UAS alternate setting %d\n",
+				   uas->bAlternateSetting);
+			intf = uas;
+			ptr = alt + sizeof(*uas);
+			break;
+		}
 	}
+#endif
 
-	if ((controller->finish_device_config &&
-			controller->finish_device_config(dev)) ||
-			set_configuration(dev) < 0) {
-		usb_debug ("Could not finalize device configuration\n");
+	if (usb_configure_interface(dev, intf) < 0) {
 		usb_detach_device (controller, dev->address);
 		return -1;
 	}
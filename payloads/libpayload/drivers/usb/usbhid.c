@@ -487,6 +487,11 @@ usb_hid_init (usbdev_t *dev)
 			usb_debug ("  found endpoint %x for interrupt-in\n", i);
 			/* 20 buffers of 8 bytes, for every 10 msecs */
 			HID_INST(dev)->queue = dev->controller->create_intr_queue (&dev->endpoints[i], 8, 20, 10);
+			/* No new reports until the next interval */
+			if (dev->controller->handle_events)
+				dev->poll_interval = USB_EVENT_POLL_INTERVAL;
+			else
+				dev->poll_interval = usb_endpoint_interval_us (&dev->endpoints[i]);
 			keycount = 0;
 			usb_debug ("  configuration done.\n");
 			break;
@@ -172,5 +172,20 @@ usb_hub_init(usbdev_t *const dev)
 
 	if (dev->speed == SUPER_SPEED)
 		usb_hub_set_hub_depth(dev);
-	generic_hub_init(dev, desc.bNbrPorts, &usb_hub_ops);
+	if (generic_hub_init(dev, desc.bNbrPorts, &usb_hub_ops))
+		return;
+
+	/*
+	 * We ask for port changes with control transfers, but the hub
+	 * wouldn't report them any faster on its status change endpoint.
+	 */
+	int i;
+	for (i = 1; i < dev->num_endp; ++i) {
+		if (dev->endpoints[i].type == INTERRUPT &&
+				dev->endpoints[i].direction == IN) {
+			dev->poll_interval =
+				usb_endpoint_interval_us(&dev->endpoints[i]);
+			break;
+		}
+	}
 }
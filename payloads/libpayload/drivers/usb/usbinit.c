@@ -36,6 +36,7 @@
 #include "xhci.h"
 #include "dwc2.h"
 #include <usb/usbdisk.h>
+#include "generic_hub.h"
 
 #if IS_ENABLED(CONFIG_LP_USB_PCI)
 /**
@@ -166,33 +167,51 @@ static void usb_scan_pci_bus(int bus)
  */
 int usb_initialize(void)
 {
+	if (IS_ENABLED(CONFIG_LP_USB_PARALLEL_INIT))
+		generic_hub_defer_root_ports();
 #if IS_ENABLED(CONFIG_LP_USB_PCI)
 	usb_scan_pci_bus(0);
 #endif
+	if (IS_ENABLED(CONFIG_LP_USB_PARALLEL_INIT))
+		generic_hub_attach_root_ports();
 	return 0;
 }
 
 hci_t *usb_add_mmio_hc(hc_type type, void *bar)
 {
+	hci_t *controller;
+
+	if (IS_ENABLED(CONFIG_LP_USB_PARALLEL_INIT))
+		generic_hub_defer_root_ports();
+
 	switch (type) {
 #if IS_ENABLED(CONFIG_LP_USB_OHCI)
 	case OHCI:
-		return ohci_init((unsigned long)bar);
+		controller = ohci_init((unsigned long)bar);
+		break;
 #endif
 #if IS_ENABLED(CONFIG_LP_USB_EHCI)
 	case EHCI:
-		return ehci_init((unsigned long)bar);
+		controller = ehci_init((unsigned long)bar);
+		break;
 #endif
 #if IS_ENABLED(CONFIG_LP_USB_DWC2)
 	case DWC2:
-		return dwc2_init(bar);
+		controller = dwc2_init(bar);
+		break;
 #endif
 #if IS_ENABLED(CONFIG_LP_USB_XHCI)
 	case XHCI:
-		return xhci_init((unsigned long)bar);
+		controller = xhci_init((unsigned long)bar);
+		break;
 #endif
 	default:
 		usb_debug("HC type %d (at %p) is not supported!\n", type, bar);
-		return NULL;
+		controller = NULL;
+		break;
 	}
+
+	if (IS_ENABLED(CONFIG_LP_USB_PARALLEL_INIT))
+		generic_hub_attach_root_ports();
+	return controller;
 }
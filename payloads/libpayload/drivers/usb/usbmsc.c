@@ -88,6 +88,7 @@ usb_msc_destroy (usbdev_t *dev)
 {
 	if (dev->data) {
 		usb_msc_remove_disk (dev);
+		free (MSC_INST (dev)->uas_iu);
 		free (dev->data);
 	}
 	dev->data = 0;
@@ -138,6 +139,8 @@ static int
 request_sense (usbdev_t *dev);
 static int
 request_sense_no_media (usbdev_t *dev);
+static int
+sense_no_media (usbdev_t *dev, const u8 *sense);
 static void
 usb_msc_poll (usbdev_t *dev);
 
@@ -175,6 +178,14 @@ initialize_luns (usbdev_t *dev)
 {
 	usbmsc_inst_t *msc = MSC_INST (dev);
 	dev_req_t dr;
+
+	/* GET MAX LUN is a Bulk-Only request, stick to LUN 0 with UAS */
+	if (msc->uas_command) {
+		msc->num_luns = 1;
+		msc->lun = 0;
+		return;
+	}
+
 	dr.bmRequestType = 0;
 	dr.data_dir = device_to_host;
 #ifndef QEMU
@@ -231,6 +242,250 @@ get_csw (endpoint_t *ep, csw_t *csw)
 	return MSC_COMMAND_OK;
 }
 
+/*
+ * USB Attached SCSI: Commands go out as Command IUs on the command pipe. The
+ * data and the Sense IU come back on the data and status pipes, on the bulk
+ * stream that matches the command's tag. So several commands can be in
+ * flight at once.
+ */
+
+enum {
+	UAS_IU_COMMAND = 0x01,
+	UAS_IU_SENSE = 0x03,
+	UAS_IU_RESPONSE = 0x04,
+};
+
+/* bPipeID of the Pipe Usage descriptor */
+enum {
+	UAS_PIPE_COMMAND = 1,
+	UAS_PIPE_STATUS = 2,
+	UAS_PIPE_DATA_IN = 3,
+	UAS_PIPE_DATA_OUT = 4,
+};
+#define UAS_DT_PIPE_USAGE 0x24
+
+/* Tagged commands we keep in flight at most */
+#define UAS_MAX_TAGS 4
+
+typedef struct {
+	u8 iu_id;
+	u8 res1;
+	u16 tag;		/* big endian, like all UAS fields */
+	u8 task_attribute;
+	u8 res5;
+	u8 add_cdb_length;
+	u8 res7;
+	u8 lun[8];
+	u8 cdb[16];
+} __attribute__ ((packed)) uas_command_iu_t;
+
+/* Long enough for a Response IU as well */
+typedef struct {
+	u8 iu_id;
+	u8 res1;
+	u16 tag;
+	u16 status_qualifier;
+	u8 status;
+	u8 res7[7];
+	u16 sense_length;
+	u8 sense[96];
+} __attribute__ ((packed)) uas_sense_iu_t;
+
+typedef struct {
+	uas_command_iu_t command;
+	uas_sense_iu_t status;
+	int submitted;	/* Number of the status, data and command phases queued */
+} uas_tag_t;
+
+/*
+ * Sets up the pipes if the device got configured with its UAS alternate
+ * setting. Returns 1 for UAS, 0 for Bulk-Only Transport, -1 on errors.
+ */
+static int
+uas_init (usbdev_t *dev)
+{
+	usbmsc_inst_t *const msc = MSC_INST (dev);
+	configuration_descriptor_t *const cd = dev->configuration;
+	u8 *const end = (u8 *) cd + cd->wTotalLength;
+	interface_descriptor_t *intf = NULL;
+	endpoint_t *pipes[UAS_PIPE_DATA_OUT + 1] = { 0 };
+	int ep_addr = -1, tags = UAS_MAX_TAGS;
+	u8 *ptr;
+	int i;
+
+	if (!IS_ENABLED(CONFIG_LP_USB_UAS))
+		return 0;
+
+	/* Match the Pipe Usage descriptors of the UAS interface with the
+	   endpoints we are configured with. */
+	for (ptr = (u8 *) cd + cd->bLength;
+	     ptr + 2 <= end && ptr[0] && ptr + ptr[0] <= end; ptr += ptr[0]) {
+		if (ptr[1] == DT_INTF) {
+			interface_descriptor_t *const desc = (void *) ptr;
+			if (intf)
+				break;
+			if (desc->bInterfaceClass == 0x08 &&
+			    desc->bInterfaceProtocol == 0x62)
+				intf = desc;
+		} else if (intf && ptr[1] == DT_ENDP) {
+			ep_addr = ((endpoint_descriptor_t *) ptr)->bEndpointAddress;
+		} else if (intf && ptr[1] == UAS_DT_PIPE_USAGE && ptr[0] >= 3 &&
+			   ptr[2] >= UAS_PIPE_COMMAND &&
+			   ptr[2] <= UAS_PIPE_DATA_OUT) {
+			for (i = 1; i < dev->num_endp; i++) {
+				if (dev->endpoints[i].endpoint == ep_addr)
+					pipes[ptr[2]] = &dev->endpoints[i];
+			}
+		}
+	}
+
+	/* Bulk-Only Transport only has two of the pipes */
+	for (i = UAS_PIPE_COMMAND; i <= UAS_PIPE_DATA_OUT; i++) {
+		if (!pipes[i])
+			return 0;
+	}
+
+	/* Each tag is a stream on the status and data pipes */
+	for (i = UAS_PIPE_STATUS; i <= UAS_PIPE_DATA_OUT; i++)
+		tags = MIN (tags, pipes[i]->max_streams);
+	if (tags < 1) {
+		usb_debug ("  no streams for UAS.\n");
+		return -1;
+	}
+
+	msc->uas_iu = dma_malloc (tags * sizeof (uas_tag_t));
+	if (!msc->uas_iu)
+		return -1;
+	msc->uas_tags = tags;
+	msc->uas_command = pipes[UAS_PIPE_COMMAND];
+	msc->uas_status = pipes[UAS_PIPE_STATUS];
+	msc->bulk_in = pipes[UAS_PIPE_DATA_IN];
+	msc->bulk_out = pipes[UAS_PIPE_DATA_OUT];
+	usb_debug ("  using UAS with %d tags\n", tags);
+	return 1;
+}
+
+/* Halted endpoints with streams aren't recovered, give up on the device */
+static int
+uas_detach (usbdev_t *dev)
+{
+	usb_debug ("UAS transport failed, detaching device.\n");
+	usb_detach_device (dev->controller, dev->address);
+	return MSC_COMMAND_DETACHED;
+}
+
+/*
+ * Queues a command with the given tag. The status and data phases are queued
+ * first, so they're waiting on the tag's stream when the device gets to the
+ * command. `buf` has to be DMA coherent.
+ *
+ * @return number of the status, data and command phases queued
+ */
+static int
+uas_submit (usbdev_t *dev, int tag, cbw_direction dir, const u8 *cb,
+	    int cblen, u8 *buf, int buflen)
+{
+	hci_t *const hc = dev->controller;
+	usbmsc_inst_t *const msc = MSC_INST (dev);
+	uas_tag_t *const t = &((uas_tag_t *) msc->uas_iu)[tag - 1];
+	endpoint_t *const data_ep = (dir == cbw_direction_data_in)
+		? msc->bulk_in : msc->bulk_out;
+
+	memset (&t->command, 0, sizeof (t->command));
+	t->command.iu_id = UAS_IU_COMMAND;
+	t->command.tag = htonw (tag);
+	t->command.lun[1] = msc->lun;
+	memcpy (t->command.cdb, cb, MIN (cblen, sizeof (t->command.cdb)));
+	memset (&t->status, 0, sizeof (t->status));
+
+	t->submitted = 0;
+	if (hc->bulk_submit (msc->uas_status, tag, sizeof (t->status),
+			     (u8 *) &t->status))
+		return t->submitted;
+	t->submitted++;
+	if (buflen > 0 && hc->bulk_submit (data_ep, tag, buflen, buf))
+		return t->submitted;
+	t->submitted++;
+	if (hc->bulk_submit (msc->uas_command, 0, sizeof (t->command),
+			     (u8 *) &t->command))
+		return t->submitted;
+	t->submitted++;
+	return t->submitted;
+}
+
+/* returns -1 if the transport failed, MSC_COMMAND_FAIL if the command did */
+static int
+uas_reap (usbdev_t *dev, int tag, cbw_direction dir, int buflen,
+	  int residue_ok)
+{
+	hci_t *const hc = dev->controller;
+	usbmsc_inst_t *const msc = MSC_INST (dev);
+	uas_tag_t *const t = &((uas_tag_t *) msc->uas_iu)[tag - 1];
+	endpoint_t *const data_ep = (dir == cbw_direction_data_in)
+		? msc->bulk_in : msc->bulk_out;
+	const u8 *const cb = t->command.cdb;
+	int ok = t->submitted == 3;
+	int transferred = 0;
+
+	/* Reap everything queued, even after a failure */
+	if (t->submitted > 2 &&
+	    hc->bulk_reap (msc->uas_command, 0) != sizeof (t->command))
+		ok = 0;
+	if (t->submitted > 1 && buflen > 0) {
+		transferred = hc->bulk_reap (data_ep, tag);
+		if (transferred < 0)
+			ok = 0;
+	}
+	if (t->submitted > 0 && hc->bulk_reap (msc->uas_status, tag) < 0)
+		ok = 0;
+
+	if (!ok || ntohw (t->status.tag) != tag)
+		return -1;
+	if (t->status.iu_id != UAS_IU_SENSE)
+		/* a Response IU, the command wasn't accepted */
+		return MSC_COMMAND_FAIL;
+	if ((cb[0] == 0x1b) && (cb[4] == 1))
+		/* start command, always succeed */
+		return MSC_COMMAND_OK;
+	if (t->status.status == 0) {
+		if (transferred == buflen || residue_ok)
+			return MSC_COMMAND_OK;
+		/* missed some bytes */
+		return MSC_COMMAND_FAIL;
+	}
+	/* The sense data comes with the status, no need to request it */
+	if (cb[0] == 0 && t->status.status == 2 /* CHECK CONDITION */)
+		return sense_no_media (dev, t->status.sense);
+	return MSC_COMMAND_FAIL;
+}
+
+static int
+uas_execute_command (usbdev_t *dev, cbw_direction dir, const u8 *cb,
+		     int cblen, u8 *buf, int buflen, int residue_ok)
+{
+	u8 *data = buf;
+	int ret;
+
+	/* Queued transfers don't use the controller's bounce buffer */
+	if (buflen > 0 && !dma_coherent (buf)) {
+		data = dma_malloc (buflen);
+		if (!data)
+			return MSC_COMMAND_FAIL;
+		if (dir == cbw_direction_data_out)
+			memcpy (data, buf, buflen);
+	}
+
+	uas_submit (dev, 1, dir, cb, cblen, data, buflen);
+	ret = uas_reap (dev, 1, dir, buflen, residue_ok);
+
+	if (data != buf) {
+		if (ret >= 0 && dir == cbw_direction_data_in)
+			memcpy (buf, data, buflen);
+		free (data);
+	}
+	return ret < 0 ? uas_detach (dev) : ret;
+}
+
 static int
 execute_command (usbdev_t *dev, cbw_direction dir, const u8 *cb, int cblen,
 		 u8 *buf, int buflen, int residue_ok)
@@ -238,6 +493,10 @@ execute_command (usbdev_t *dev, cbw_direction dir, const u8 *cb, int cblen,
 	cbw_t cbw;
 	csw_t csw;
 
+	if (MSC_INST (dev)->uas_command)
+		return uas_execute_command (dev, dir, cb, cblen, buf, buflen,
+					    residue_ok);
+
 	int always_succeed = 0;
 	if ((cb[0] == 0x1b) && (cb[4] == 1)) {	//start command, always succeed
 		always_succeed = 1;
@@ -314,6 +573,15 @@ typedef struct {
 	unsigned char control;	//5
 } __attribute__ ((packed)) cmdblock6_t;
 
+typedef struct {
+	unsigned char command;	//0
+	unsigned char res1;	//1 - service action for SERVICE ACTION IN(16)
+	unsigned long long block;	//2-9
+	unsigned int numblocks;	//10-13 - allocation length for SERVICE ACTION IN(16)
+	unsigned char res2;	//14
+	unsigned char control;	//15 - the block is 16 bytes long
+} __attribute__ ((packed)) cmdblock16_t;
+
 /**
  * Like readwrite_blocks, but for soft-sectors of 512b size. Converts the
  * start and count from 512b units.
@@ -328,7 +596,7 @@ typedef struct {
  * @return 0 on success, 1 on failure
  */
 int
-readwrite_blocks_512 (usbdev_t *dev, int start, int n,
+readwrite_blocks_512 (usbdev_t *dev, u64 start, int n,
 	cbw_direction dir, u8 *buf)
 {
 	int blocksize_divider = MSC_INST(dev)->blocksize / 512;
@@ -336,10 +604,38 @@ readwrite_blocks_512 (usbdev_t *dev, int start, int n,
 		n / blocksize_divider, dir, buf);
 }
 
+/**
+ * Builds the READ(10) or WRITE(10) command block, or READ(16) or WRITE(16)
+ * for blocks beyond the reach of 32-bit block addresses (2TB with 512 byte
+ * sectors).
+ *
+ * @param cdb buffer for the command block, 16 bytes
+ * @return length of the command block
+ */
+static int
+readwrite_cdb (u8 *cdb, u64 start, int n, cbw_direction dir)
+{
+	if (start + n > 0x100000000ULL) {
+		cmdblock16_t *const cb = (cmdblock16_t *) cdb;
+		memset (cb, 0, sizeof (*cb));
+		cb->command = (dir == cbw_direction_data_in) ? 0x88 : 0x8a;
+		cb->block = htonll (start);
+		cb->numblocks = htonl (n);
+		return sizeof (*cb);
+	} else {
+		cmdblock_t *const cb = (cmdblock_t *) cdb;
+		memset (cb, 0, sizeof (*cb));
+		cb->command = (dir == cbw_direction_data_in) ? 0x28 : 0x2a;
+		cb->block = htonl (start);
+		cb->numblocks = htonw (n);
+		return sizeof (*cb);
+	}
+}
+
 /**
  * Reads or writes a number of sequential blocks on a USB storage device.
- * As it uses the READ(10) SCSI-2 command, it's limited to storage devices
- * of at most 2TB. It assumes sectors of 512 bytes.
+ * Only storage devices of more than 2TB get the 16 byte commands, as not
+ * every device knows them.
  *
  * @param dev device to access
  * @param start first sector to access
@@ -349,32 +645,188 @@ readwrite_blocks_512 (usbdev_t *dev, int start, int n,
  * @return 0 on success, 1 on failure
  */
 static int
-readwrite_chunk (usbdev_t *dev, int start, int n, cbw_direction dir, u8 *buf)
+readwrite_chunk (usbdev_t *dev, u64 start, int n, cbw_direction dir, u8 *buf)
 {
-	cmdblock_t cb;
-	memset (&cb, 0, sizeof (cb));
-	if (dir == cbw_direction_data_in) {
-		// read
-		cb.command = 0x28;
-	} else {
-		// write
-		cb.command = 0x2a;
-	}
-	cb.block = htonl (start);
-	cb.numblocks = htonw (n);
+	u8 cb[16];
+	const int cblen = readwrite_cdb (cb, start, n, dir);
 
-	return execute_command (dev, dir, (u8 *) &cb, sizeof (cb), buf,
+	return execute_command (dev, dir, cb, cblen, buf,
 				n * MSC_INST(dev)->blocksize, 0)
 		!= MSC_COMMAND_OK ? 1 : 0;
 }
 
+/* Chunks a queued Bulk-Only read keeps in flight */
+#define MSC_QUEUE_DEPTH 2
+
+/* Time between checks for media changes in microseconds */
+#define MSC_POLL_INTERVAL (100 * 1000)
+
+typedef struct {
+	cbw_t cbw;
+	csw_t csw;
+	int submitted;	/* Number of the cbw, data and csw transfers queued */
+} msc_queued_cmd_t;
+
+/* returns number of the cbw, data and csw transfers queued */
+static int
+bot_submit_read (usbdev_t *dev, msc_queued_cmd_t *cmd, const u8 *cb,
+		 int cblen, u8 *buf, int len)
+{
+	hci_t *const hc = dev->controller;
+	usbmsc_inst_t *const msc = MSC_INST (dev);
+
+	wrap_cbw (&cmd->cbw, len, cbw_direction_data_in, cb, cblen, msc->lun);
+
+	cmd->submitted = 0;
+	if (hc->bulk_submit (msc->bulk_out, 0, sizeof (cmd->cbw),
+			     (u8 *) &cmd->cbw))
+		return cmd->submitted;
+	cmd->submitted++;
+	if (hc->bulk_submit (msc->bulk_in, 0, len, buf))
+		return cmd->submitted;
+	cmd->submitted++;
+	if (hc->bulk_submit (msc->bulk_in, 0, sizeof (cmd->csw),
+			     (u8 *) &cmd->csw))
+		return cmd->submitted;
+	cmd->submitted++;
+	return cmd->submitted;
+}
+
+/* returns -1 if the transport failed, MSC_COMMAND_FAIL if the command did */
+static int
+bot_reap_read (usbdev_t *dev, msc_queued_cmd_t *cmd, int len)
+{
+	hci_t *const hc = dev->controller;
+	usbmsc_inst_t *const msc = MSC_INST (dev);
+	int ok = cmd->submitted == 3;
+
+	/* Reap everything queued, even after a failure */
+	if (cmd->submitted > 0 &&
+	    hc->bulk_reap (msc->bulk_out, 0) != sizeof (cmd->cbw))
+		ok = 0;
+	if (cmd->submitted > 1 && hc->bulk_reap (msc->bulk_in, 0) != len)
+		ok = 0;
+	if (cmd->submitted > 2 &&
+	    hc->bulk_reap (msc->bulk_in, 0) != sizeof (cmd->csw))
+		ok = 0;
+
+	if (!ok)
+		return -1;
+	if (cmd->csw.dCSWTag != cmd->cbw.dCBWTag || cmd->csw.bCSWStatus != 0 ||
+	    cmd->csw.dCSWDataResidue != 0)
+		return MSC_COMMAND_FAIL;
+	return MSC_COMMAND_OK;
+}
+
+/**
+ * Reads full chunks with the controller's bulk queue. With Bulk-Only
+ * Transport, the CBW of the next chunk is queued while the data of the
+ * current one comes in, so the device can move on to the next command
+ * without waiting for the host. With UAS, a command is in flight for each
+ * tag.
+ *
+ * Only the leading chunks that were read successfully count. The caller
+ * reads the rest with readwrite_chunk(), which also handles the sense data.
+ *
+ * @return number of chunks read, -1 if the device got detached
+ */
+static int
+read_chunks_queued (usbdev_t *dev, u64 start, int chunks, int chunk_size,
+		    u8 *buf)
+{
+	hci_t *const hc = dev->controller;
+	usbmsc_inst_t *const msc = MSC_INST (dev);
+	const cbw_direction dir = cbw_direction_data_in;
+	const int len = chunk_size * msc->blocksize;
+	const int depth = msc->uas_command ? msc->uas_tags : MSC_QUEUE_DEPTH;
+	msc_queued_cmd_t *cmds = NULL;
+	int queued = 0, reaped = 0, read = 0;
+	int transport_failed = 0, failed = 0;
+
+	if (!hc->bulk_submit || !hc->bulk_reap || chunks < 2 ||
+	    !dma_coherent (buf))
+		return 0;
+
+	/* The controller accesses these while we are queuing the next ones */
+	if (!msc->uas_command) {
+		cmds = dma_malloc (depth * sizeof (*cmds));
+		if (!cmds)
+			return 0;
+	}
+
+	while (reaped < queued || (!failed && queued < chunks)) {
+		/* Keep the queue full */
+		while (!failed && queued < chunks && queued - reaped < depth) {
+			const int slot = queued % depth;
+			u8 *const data = buf + queued * len;
+			u8 cb[16];
+			const int cblen = readwrite_cdb (cb,
+				start + (u64) queued * chunk_size,
+				chunk_size, dir);
+			int submitted;
+
+			if (msc->uas_command)
+				submitted = uas_submit (dev, slot + 1, dir, cb,
+							cblen, data, len);
+			else
+				submitted = bot_submit_read (dev, &cmds[slot],
+							     cb, cblen, data,
+							     len);
+			if (submitted != 3) {
+				failed = 1;
+				/* A command without its status phase
+				   leaves the device waiting for us. */
+				if (submitted)
+					transport_failed = 1;
+				else
+					break;
+			}
+			queued++;
+		}
+
+		if (reaped == queued)
+			break;
+
+		const int slot = reaped % depth;
+		int ret;
+		if (msc->uas_command)
+			ret = uas_reap (dev, slot + 1, dir, len, 0);
+		else
+			ret = bot_reap_read (dev, &cmds[slot], len);
+		switch (ret) {
+		case MSC_COMMAND_OK:
+			if (read == reaped)
+				read++;
+			break;
+		case MSC_COMMAND_FAIL:
+			failed = 1;
+			break;
+		default:
+			failed = 1;
+			transport_failed = 1;
+			break;
+		}
+		reaped++;
+	}
+
+	free (cmds);
+
+	if (transport_failed) {
+		if (msc->uas_command) {
+			uas_detach (dev);
+			return -1;
+		}
+		usb_debug ("Queued read failed, resetting transport.\n");
+		if (reset_transport (dev) == MSC_COMMAND_DETACHED)
+			return -1;
+	}
+	return read;
+}
+
 /**
  * Reads or writes a number of sequential blocks on a USB storage device
  * that is split into MAX_CHUNK_BYTES size requests.
  *
- * As it uses the READ(10) SCSI-2 command, it's limited to storage devices
- * of at most 2TB. It assumes sectors of 512 bytes.
- *
  * @param dev device to access
  * @param start first sector to access
  * @param n number of sectors to access
@@ -385,13 +837,21 @@ readwrite_chunk (usbdev_t *dev, int start, int n, cbw_direction dir, u8 *buf)
  * @return 0 on success, 1 on failure
  */
 int
-readwrite_blocks (usbdev_t *dev, int start, int n, cbw_direction dir, u8 *buf)
+readwrite_blocks (usbdev_t *dev, u64 start, int n, cbw_direction dir, u8 *buf)
 {
 	int chunk_size = MAX_CHUNK_BYTES / MSC_INST(dev)->blocksize;
-	int chunk;
+	int chunk = 0;
+
+	/* Queue up the full chunks of longer reads if the controller can. */
+	if (dir == cbw_direction_data_in) {
+		chunk = read_chunks_queued (dev, start, n / chunk_size,
+					    chunk_size, buf);
+		if (chunk < 0)
+			return 1;
+	}
 
-	/* Read as many full chunks as needed. */
-	for (chunk = 0; chunk < (n / chunk_size); chunk++) {
+	/* Read or write as many full chunks as needed. */
+	for (; chunk < (n / chunk_size); chunk++) {
 		if (readwrite_chunk (dev, start + (chunk * chunk_size),
 				     chunk_size, dir,
 				     buf + (chunk * MAX_CHUNK_BYTES))
@@ -442,12 +902,19 @@ static int request_sense_no_media (usbdev_t *dev)
 	if (ret)
 		return ret;
 
+	return sense_no_media (dev, buf);
+}
+
+/* Checks fixed format sense data for a missing medium */
+static int
+sense_no_media (usbdev_t *dev, const u8 *sense)
+{
 	/* Check if sense key is set to NOT READY. */
-	if ((buf[2] & 0xf) != 2)
+	if ((sense[2] & 0xf) != 2)
 		return MSC_COMMAND_FAIL;
 
 	/* Check if additional sense code is 0x3a. */
-	if (buf[12] != 0x3a)
+	if (sense[12] != 0x3a)
 		return MSC_COMMAND_FAIL;
 
 	/* No media is present. Return MSC_COMMAND_OK while marking the disk
@@ -477,6 +944,27 @@ spin_up (usbdev_t *dev)
 				sizeof (cb), 0, 0, 0);
 }
 
+/* For devices of more than 2^32 blocks */
+static int
+read_capacity_16 (usbdev_t *dev)
+{
+	cmdblock16_t cb;
+	memset (&cb, 0, sizeof (cb));
+	cb.command = 0x9e;	// service action in (16)
+	cb.res1 = 0x10;		// read capacity (16)
+	u32 buf[8];
+	cb.numblocks = htonl (sizeof (buf));
+
+	int ret = execute_command (dev, cbw_direction_data_in, (u8 *) &cb,
+				   sizeof (cb), (u8 *)buf, sizeof (buf), 1);
+	if (ret)
+		return ret;
+	MSC_INST (dev)->numblocks =
+		((u64)ntohl(buf[0]) << 32 | ntohl(buf[1])) + 1;
+	MSC_INST (dev)->blocksize = ntohl(buf[2]);
+	return MSC_COMMAND_OK;
+}
+
 static int
 read_capacity (usbdev_t *dev)
 {
@@ -506,15 +994,20 @@ read_capacity (usbdev_t *dev)
 		MSC_INST (dev)->numblocks = 0xffffffff;
 		MSC_INST (dev)->blocksize = 512;
 	} else {
-		MSC_INST (dev)->numblocks = ntohl(buf[0]) + 1;
+		MSC_INST (dev)->numblocks = (u64)ntohl(buf[0]) + 1;
 		MSC_INST (dev)->blocksize = ntohl(buf[1]);
 	}
-	usb_debug ("  %d %d-byte sectors (%d MB)\n", MSC_INST (dev)->numblocks,
-		MSC_INST (dev)->blocksize,
-		/* round down high block counts to avoid integer overflow */
-		MSC_INST (dev)->numblocks > 1000000
-			? (MSC_INST (dev)->numblocks / 1000) * MSC_INST (dev)->blocksize / 1000 :
-		MSC_INST (dev)->numblocks * MSC_INST (dev)->blocksize / 1000 / 1000);
+	/* The last block doesn't fit, the device has more than 2^32 */
+	if (count < 20 && ntohl(buf[0]) == 0xffffffff) {
+		usb_debug ("  reading capacity with READ CAPACITY(16).\n");
+		ret = read_capacity_16 (dev);
+		if (ret == MSC_COMMAND_DETACHED)
+			return ret;
+	}
+	usb_debug ("  %llu %d-byte sectors (%llu MB)\n",
+		MSC_INST (dev)->numblocks, MSC_INST (dev)->blocksize,
+		MSC_INST (dev)->numblocks * MSC_INST (dev)->blocksize
+			/ 1000 / 1000);
 	return MSC_COMMAND_OK;
 }
 
@@ -598,6 +1091,8 @@ usb_msc_init (usbdev_t *dev)
 
 	dev->destroy = usb_msc_destroy;
 	dev->poll = usb_msc_poll;
+	/* Polling sends a TEST UNIT READY, don't do that all the time */
+	dev->poll_interval = MSC_POLL_INTERVAL;
 
 	configuration_descriptor_t *cd =
 		(configuration_descriptor_t *) dev->configuration;
@@ -632,6 +1127,20 @@ usb_msc_init (usbdev_t *dev)
 	MSC_INST (dev)->bulk_in = 0;
 	MSC_INST (dev)->bulk_out = 0;
 	MSC_INST (dev)->usbdisk_created = 0;
+	MSC_INST (dev)->uas_command = 0;
+	MSC_INST (dev)->uas_status = 0;
+	MSC_INST (dev)->uas_tags = 0;
+	MSC_INST (dev)->uas_iu = 0;
+
+	/* UAS sets up the data pipes as bulk_in and bulk_out. If it can't,
+	   switch back to alternate setting 0 and use Bulk-Only Transport. */
+	if (uas_init (dev) < 0) {
+		usb_debug ("couldn't set up UAS, falling back to BOT.\n");
+		if (usb_configure_interface (dev, interface) < 0) {
+			usb_detach_device (dev->controller, dev->address);
+			return;
+		}
+	}
 
 	for (i = 1; i <= dev->num_endp; i++) {
 		if (dev->endpoints[i].endpoint == 0)
@@ -41,6 +41,8 @@ static void xhci_reset (hci_t *controller);
 static void xhci_reinit (hci_t *controller);
 static void xhci_shutdown (hci_t *controller);
 static int xhci_bulk (endpoint_t *ep, int size, u8 *data, int finalize);
+static int xhci_bulk_submit (endpoint_t *ep, int stream, int size, u8 *data);
+static int xhci_bulk_reap (endpoint_t *ep, int stream);
 static int xhci_control (usbdev_t *dev, direction_t dir, int drlen, void *devreq,
 			 int dalen, u8 *data);
 static void* xhci_create_intr_queue (endpoint_t *ep, int reqsize, int reqcount, int reqtiming);
@@ -168,6 +170,9 @@ xhci_init (unsigned long physical_bar)
 	controller->create_intr_queue	= xhci_create_intr_queue;
 	controller->destroy_intr_queue	= xhci_destroy_intr_queue;
 	controller->poll_intr_queue	= xhci_poll_intr_queue;
+	controller->bulk_submit		= xhci_bulk_submit;
+	controller->bulk_reap		= xhci_bulk_reap;
+	controller->handle_events	= xhci_handle_controller_events;
 	controller->pcidev		= 0;
 
 	controller->reg_base = (uintptr_t)physical_bar;
@@ -205,6 +210,10 @@ xhci_init (unsigned long physical_bar)
 	xhci_debug("context size: %dB\n", CTXSIZE(xhci));
 	xhci_debug("maxslots: 0x%02lx\n", xhci->capreg->MaxSlots);
 	xhci_debug("maxports: 0x%02lx\n", xhci->capreg->MaxPorts);
+	if (xhci->capreg->MaxPSASize)
+		controller->max_streams =
+			MIN(MAX_STREAMS, 2 << xhci->capreg->MaxPSASize) - 1;
+	xhci_debug("maxstreams: %d\n", controller->max_streams);
 	const unsigned pagesize = xhci->opreg->pagesize << 12;
 	xhci_debug("pagesize: 0x%04x\n", pagesize);
 
@@ -506,6 +515,11 @@ xhci_reset_endpoint(usbdev_t *const dev, endpoint_t *const ep)
 			return 1;
 		}
 		xhci_init_cycle_ring(tr, TRANSFER_RING_SIZE);
+
+		/* Queued TDs are gone with the old ring */
+		bulkq_t *const bulkq = xhci->dev[slot_id].bulk_queues[ep_id];
+		if (bulkq)
+			memset(bulkq, 0, sizeof(*bulkq));
 	}
 
 	xhci_debug("Finished resetting ID %d EP %d (ep state: %d)\n",
@@ -726,6 +740,7 @@ xhci_bulk(endpoint_t *const ep, const int size, u8 *const src,
 	const int ep_id = xhci_ep_id(ep);
 	epctx_t *const epctx = xhci->dev[slot_id].ctx.ep[ep_id];
 	transfer_ring_t *const tr = xhci->dev[slot_id].transfer_rings[ep_id];
+	const bulkq_t *const bulkq = xhci->dev[slot_id].bulk_queues[ep_id];
 
 	const size_t off = (size_t)data & 0xffff;
 	if ((off + size) > ((TRANSFER_RING_SIZE - 2) << 16)) {
@@ -733,6 +748,16 @@ xhci_bulk(endpoint_t *const ep, const int size, u8 *const src,
 		return -1;
 	}
 
+	/* We'd take the transfer event of a queued TD */
+	if (bulkq && bulkq->head != bulkq->tail) {
+		xhci_debug("Bulk transfer with queued TDs pending\n");
+		return -1;
+	}
+	if (xhci->dev[slot_id].streams[ep_id]) {
+		xhci_debug("Bulk transfer on an endpoint with streams\n");
+		return -1;
+	}
+
 	if (!dma_coherent(src)) {
 		data = xhci->dma_buffer;
 		if (size > DMA_SIZE) {
@@ -778,6 +803,142 @@ xhci_bulk(endpoint_t *const ep, const int size, u8 *const src,
 	return ret;
 }
 
+/* find ring and completion queue for bulk TDs on `ep`, stream 0 for none */
+static int
+xhci_get_bulkq(endpoint_t *const ep, const int stream,
+	       transfer_ring_t **const tr, bulkq_t **const bulkq)
+{
+	xhci_t *const xhci = XHCI_INST(ep->dev->controller);
+	devinfo_t *const di = &xhci->dev[ep->dev->address];
+	const int ep_id = xhci_ep_id(ep);
+	streams_t *const streams = di->streams[ep_id];
+
+	if (streams) {
+		if (stream <= 0 || stream > ep->max_streams) {
+			xhci_debug("Invalid stream %d\n", stream);
+			return -1;
+		}
+		*tr = streams->rings[stream];
+		*bulkq = &streams->queues[stream];
+		return 0;
+	}
+
+	if (stream) {
+		xhci_debug("No streams on ID %d EP %d\n",
+			   ep->dev->address, ep_id);
+		return -1;
+	}
+	if (!di->bulk_queues[ep_id]) {
+		di->bulk_queues[ep_id] = malloc(sizeof(bulkq_t));
+		if (!di->bulk_queues[ep_id]) {
+			xhci_debug("Out of memory\n");
+			return -1;
+		}
+		memset(di->bulk_queues[ep_id], 0, sizeof(bulkq_t));
+	}
+	*tr = di->transfer_rings[ep_id];
+	*bulkq = di->bulk_queues[ep_id];
+	return 0;
+}
+
+/* queue a TD without waiting for it, returns 0 on success */
+static int
+xhci_bulk_submit(endpoint_t *const ep, const int stream, const int size,
+		 u8 *const data)
+{
+	xhci_t *const xhci = XHCI_INST(ep->dev->controller);
+	const int slot_id = ep->dev->address;
+	const int ep_id = xhci_ep_id(ep);
+	epctx_t *const epctx = xhci->dev[slot_id].ctx.ep[ep_id];
+	transfer_ring_t *tr;
+	bulkq_t *bulkq;
+
+	/* No bounce buffer, the TD may still be in flight when we return */
+	if (!dma_coherent(data))
+		return -1;
+
+	if (xhci_get_bulkq(ep, stream, &tr, &bulkq))
+		return -1;
+
+	/* Reset endpoint if it's not running, unless TDs are pending.
+	   We can't recover endpoints with streams this way. */
+	const unsigned ep_state = EC_GET(STATE, epctx);
+	if (ep_state > 1) {
+		if (stream || bulkq->head != bulkq->tail)
+			return -1;
+		if (xhci_reset_endpoint(ep->dev, ep))
+			return -1;
+	}
+
+	/* One TRB per 64KiB page touched, plus the Event Data TRB */
+	const size_t off = (size_t)data & 0xffff;
+	const size_t trbs = MAX((off + size + 0xffff) >> 16, 1) + 1;
+	if (bulkq->tail - bulkq->head >= BULKQ_SIZE ||
+			bulkq->trbs_used + trbs > TRANSFER_RING_SIZE - 2)
+		return -1;
+
+	/* Enqueue transfer and ring doorbell, with the stream as target */
+	const unsigned mps = EC_GET(MPS, epctx);
+	const unsigned dir = (ep->direction == OUT) ? TRB_DIR_OUT : TRB_DIR_IN;
+	xhci_enqueue_td(tr, ep_id, mps, size, data, dir);
+	wmb();
+	xhci->dbreg[slot_id] = ep_id | stream << 16;
+
+	bulkq->trbs[bulkq->tail % BULKQ_SIZE] = trbs;
+	bulkq->trbs_used += trbs;
+	++bulkq->tail;
+	return 0;
+}
+
+/* returns amount of bytes transferred by the oldest queued TD on success,
+   negative CC on error */
+static int
+xhci_bulk_reap(endpoint_t *const ep, const int stream)
+{
+	xhci_t *const xhci = XHCI_INST(ep->dev->controller);
+	const int slot_id = ep->dev->address;
+	const int ep_id = xhci_ep_id(ep);
+	transfer_ring_t *tr;
+	bulkq_t *bulkq;
+
+	if (xhci_get_bulkq(ep, stream, &tr, &bulkq) ||
+			bulkq->head == bulkq->tail)
+		return -1;
+
+	/* 3s, like xhci_wait_for_transfer() */
+	unsigned long timeout_us = 3 * 1000 * 1000;
+	xhci_handle_events(xhci);
+	while (bulkq->done == bulkq->head && !bulkq->failed && timeout_us) {
+		udelay(1);
+		--timeout_us;
+		xhci_handle_events(xhci);
+	}
+
+	int ret;
+	if (bulkq->done != bulkq->head) {
+		ret = bulkq->result[bulkq->head % BULKQ_SIZE];
+	} else if (bulkq->failed) {
+		/* Behind a failed TD, the controller won't get here */
+		ret = -1;
+	} else {
+		xhci_debug("Queued bulk transfer timed out, "
+			   "stopping ID %d EP %d\n", slot_id, ep_id);
+		xhci_cmd_stop_endpoint(xhci, slot_id, ep_id);
+		bulkq->failed = 1;
+		ret = TIMEOUT;
+
+		/* That stopped all streams of the endpoint */
+		streams_t *const streams = xhci->dev[slot_id].streams[ep_id];
+		size_t i;
+		for (i = 1; streams && i < streams->count; ++i)
+			streams->queues[i].failed = 1;
+	}
+
+	bulkq->trbs_used -= bulkq->trbs[bulkq->head % BULKQ_SIZE];
+	++bulkq->head;
+	return ret;
+}
+
 static trb_t *
 xhci_next_trb(trb_t *cur, int *const pcs)
 {
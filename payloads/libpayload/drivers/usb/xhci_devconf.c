@@ -311,8 +311,84 @@ xhci_bound_interval(const endpoint_t *const ep)
 	}
 }
 
+static void
+xhci_free_streams(streams_t *const streams)
+{
+	size_t i;
+
+	if (!streams)
+		return;
+	for (i = 1; i < streams->count; ++i) {
+		if (streams->rings[i])
+			free((void *)streams->rings[i]->ring);
+		free(streams->rings[i]);
+	}
+	free((void *)streams->ctx);
+	free(streams);
+}
+
+/* Sets up a Primary Stream Array for a bulk endpoint that supports streams */
+static int
+xhci_finish_ep_streams(endpoint_t *const ep, epctx_t *const epctx)
+{
+	xhci_t *const xhci = XHCI_INST(ep->dev->controller);
+	const int ep_id = xhci_ep_id(ep);
+	size_t count, i;
+
+	/* Primary Stream Arrays have 2^(MaxPSASize + 1) entries at most */
+	if (!xhci->capreg->MaxPSASize) {
+		xhci_debug("Controller doesn't support streams\n");
+		ep->max_streams = 0;
+		return 0;
+	}
+	count = MIN(MAX_STREAMS, 2 << xhci->capreg->MaxPSASize);
+
+	streams_t *const streams = malloc(sizeof(*streams));
+	if (!streams) {
+		xhci_debug("Out of memory\n");
+		return OUT_OF_MEMORY;
+	}
+	memset(streams, 0, sizeof(*streams));
+	streams->count = count;
+	streams->ctx = xhci_align(16, count * sizeof(*streams->ctx));
+	if (!streams->ctx)
+		goto _free_return;
+	memset((void *)streams->ctx, 0, count * sizeof(*streams->ctx));
+
+	for (i = 1; i < count; ++i) {
+		transfer_ring_t *const tr = malloc(sizeof(*tr));
+		streams->rings[i] = tr;
+		if (!tr)
+			goto _free_return;
+		tr->ring = xhci_align(16, TRANSFER_RING_SIZE * sizeof(trb_t));
+		if (!tr->ring)
+			goto _free_return;
+		xhci_init_cycle_ring(tr, TRANSFER_RING_SIZE);
+		streams->ctx[i].tr_dq_low = virt_to_phys(tr->ring) |
+					    SCT_PRIMARY_TR << 1 | 1;
+		streams->ctx[i].tr_dq_high = 0;
+	}
+
+	/* With streams, the dequeue pointer points to the stream array */
+	epctx->tr_dq_low	= virt_to_phys((void *)streams->ctx);
+	epctx->tr_dq_high	= 0;
+	EC_SET(MAXPSTREAMS,	epctx, __builtin_ctz(count) - 1);
+	EC_SET(LSA,		epctx, 1);
+
+	/* Stream 0 is reserved */
+	ep->max_streams = MIN(ep->max_streams, count - 1);
+	xhci->dev[ep->dev->address].streams[ep_id] = streams;
+	xhci_debug("Set up %d streams\n", ep->max_streams);
+	return 0;
+
+_free_return:
+	xhci_debug("Out of memory\n");
+	xhci_free_streams(streams);
+	return OUT_OF_MEMORY;
+}
+
 static int
-xhci_finish_ep_config(const endpoint_t *const ep, inputctx_t *const ic)
+xhci_finish_ep_config(endpoint_t *const ep, inputctx_t *const ic)
 {
 	xhci_t *const xhci = XHCI_INST(ep->dev->controller);
 	const int ep_id = xhci_ep_id(ep);
@@ -363,9 +439,27 @@ xhci_finish_ep_config(const endpoint_t *const ep, inputctx_t *const ic)
 		EC_SET(BPKTS, epctx, 1);
 		EC_SET(BBM, epctx, 1);
 	}
+
+	if (ep->type == BULK && ep->max_streams)
+		return xhci_finish_ep_streams(ep, epctx);
 	return 0;
 }
 
+static void
+xhci_free_ep_state(devinfo_t *const di, const int ep_id)
+{
+	if (di->transfer_rings[ep_id])
+		free((void *)di->transfer_rings[ep_id]->ring);
+	free(di->transfer_rings[ep_id]);
+	di->transfer_rings[ep_id] = NULL;
+	free(di->interrupt_queues[ep_id]);
+	di->interrupt_queues[ep_id] = NULL;
+	free(di->bulk_queues[ep_id]);
+	di->bulk_queues[ep_id] = NULL;
+	xhci_free_streams(di->streams[ep_id]);
+	di->streams[ep_id] = NULL;
+}
+
 int
 xhci_finish_device_config(usbdev_t *const dev)
 {
@@ -383,6 +477,19 @@ xhci_finish_device_config(usbdev_t *const dev)
 
 	*ic->add = (1 << 0); /* Slot Context */
 
+	/* When switching alternate settings, drop the endpoints of the
+	   previous one. Their rings are freed once the new ones are in. */
+	devinfo_t old = *di;
+	for (i = 2; i < NUM_EPS; ++i) {
+		if (!di->transfer_rings[i])
+			continue;
+		*ic->drop |= (1 << i);
+		di->transfer_rings[i] = NULL;
+		di->interrupt_queues[i] = NULL;
+		di->bulk_queues[i] = NULL;
+		di->streams[i] = NULL;
+	}
+
 	xhci_dump_slotctx(di->ctx.slot);
 	ic->dev.slot->f1 = di->ctx.slot->f1;
 	ic->dev.slot->f2 = di->ctx.slot->f2;
@@ -392,7 +499,7 @@ xhci_finish_device_config(usbdev_t *const dev)
 	if (dev->descriptor->bDeviceClass == 0x09) {
 		ret = xhci_finish_hub_config(dev, ic);
 		if (ret)
-			goto _free_return;
+			goto _free_ep_ctx_return;
 	}
 
 	for (i = 1; i < dev->num_endp; ++i) {
@@ -418,14 +525,17 @@ xhci_finish_device_config(usbdev_t *const dev)
 		xhci_debug("Endpoints configured\n");
 	}
 
+	for (i = 2; i < NUM_EPS; ++i)
+		xhci_free_ep_state(&old, i);
 	goto _free_return;
 
 _free_ep_ctx_return:
-	for (i = 2; i < 31; ++i) {
-		if (di->transfer_rings[i])
-			free((void *)di->transfer_rings[i]->ring);
-		free(di->transfer_rings[i]);
-		di->transfer_rings[i] = NULL;
+	for (i = 2; i < NUM_EPS; ++i) {
+		xhci_free_ep_state(di, i);
+		di->transfer_rings[i] = old.transfer_rings[i];
+		di->interrupt_queues[i] = old.interrupt_queues[i];
+		di->bulk_queues[i] = old.bulk_queues[i];
+		di->streams[i] = old.streams[i];
 	}
 _free_return:
 	free(ic->raw);
@@ -464,6 +574,10 @@ xhci_destroy_dev(hci_t *const controller, const int slot_id)
 			free((void *)di->transfer_rings[i]->ring);
 		free(di->transfer_rings[i]);
 		free(di->interrupt_queues[i]);
+		free(di->bulk_queues[i]);
+		di->bulk_queues[i] = NULL;
+		xhci_free_streams(di->streams[i]);
+		di->streams[i] = NULL;
 	}
 
 	xhci_spew("Stopped slot %d, but not disabling it yet.\n", slot_id);
@@ -77,6 +77,62 @@ xhci_advance_event_ring(xhci_t *const xhci)
 	}
 }
 
+/* TDs of a bulk queue complete in order, so it's always the oldest one */
+static void
+xhci_complete_bulkq(bulkq_t *const bulkq, const trb_t *const ev)
+{
+	const int cc = TRB_GET(CC, ev);
+	int *const result = &bulkq->result[bulkq->done % BULKQ_SIZE];
+
+	if (cc == CC_SUCCESS || cc == CC_SHORT_PACKET) {
+		*result = TRB_GET(EVTL, ev);
+	} else {
+		xhci_debug("Queued Bulk Transfer failed: %d\n", cc);
+		*result = -cc;
+		bulkq->failed = 1;
+	}
+	++bulkq->done;
+}
+
+/* Transfer events don't tell the stream, but point into its ring */
+static int
+xhci_event_stream(const streams_t *const streams, const trb_t *const ev)
+{
+	const size_t ring_size = TRANSFER_RING_SIZE * sizeof(trb_t);
+	size_t i;
+
+	if (ev->ptr_high)
+		return 0;
+	for (i = 1; i < streams->count; ++i) {
+		const u32 ring = virt_to_phys(streams->rings[i]->ring);
+		if (ev->ptr_low >= ring && ev->ptr_low - ring < ring_size)
+			return i;
+	}
+	return 0;
+}
+
+static void
+xhci_handle_stream_event(streams_t *const streams, const trb_t *const ev)
+{
+	const int stream = xhci_event_stream(streams, ev);
+	bulkq_t *const bulkq = &streams->queues[stream];
+	size_t i;
+
+	if (!stream || bulkq->done == bulkq->tail) {
+		xhci_debug("Warning: Spurious stream event: %d\n",
+			   TRB_GET(CC, ev));
+		return;
+	}
+
+	xhci_complete_bulkq(bulkq, ev);
+
+	/* A halted endpoint stops all of its streams */
+	if (bulkq->failed) {
+		for (i = 1; i < streams->count; ++i)
+			streams->queues[i].failed = 1;
+	}
+}
+
 static void
 xhci_handle_transfer_event(xhci_t *const xhci)
 {
@@ -87,11 +143,14 @@ xhci_handle_transfer_event(xhci_t *const xhci)
 	const int ep = TRB_GET(EP, ev);
 
 	intrq_t *intrq;
+	bulkq_t *bulkq;
+	streams_t *streams;
 
 	if (id && id <= xhci->max_slots_en &&
 			(intrq = xhci->dev[id].interrupt_queues[ep])) {
 		/* It's a running interrupt endpoint */
 		intrq->ready = phys_to_virt(ev->ptr_low);
+		intrq->ep->dev->poll_pending = 1;
 		if (cc == CC_SUCCESS || cc == CC_SHORT_PACKET) {
 			TRB_SET(TL, intrq->ready,
 				intrq->size - TRB_GET(EVTL, ev));
@@ -102,6 +161,15 @@ xhci_handle_transfer_event(xhci_t *const xhci)
 		}
 	} else if (cc == CC_STOPPED || cc == CC_STOPPED_LENGTH_INVALID) {
 		/* Ignore 'Forced Stop Events' */
+	} else if (id && id <= xhci->max_slots_en &&
+			(streams = xhci->dev[id].streams[ep])) {
+		/* It's a bulk endpoint with streams */
+		xhci_handle_stream_event(streams, ev);
+	} else if (id && id <= xhci->max_slots_en &&
+			(bulkq = xhci->dev[id].bulk_queues[ep]) &&
+			bulkq->done != bulkq->tail) {
+		/* It's a queued bulk TD */
+		xhci_complete_bulkq(bulkq, ev);
 	} else {
 		xhci_debug("Warning: "
 			   "Spurious transfer event for ID %d, EP %d:\n"
@@ -179,8 +247,10 @@ xhci_handle_event(xhci_t *const xhci)
 	case TRB_EV_PORTSC:
 		xhci_debug("Port Status Change Event for %d: %d\n",
 			   TRB_GET(PORT, ev), TRB_GET(CC, ev));
-		/* We ignore the event as we look for the PORTSC
-		   registers instead, at a time when it suits _us_. */
+		/* We look at the PORTSC registers instead, at a time when
+		   it suits _us_. Just have the root hub polled. */
+		if (xhci->roothub)
+			xhci->roothub->poll_pending = 1;
 		xhci_advance_event_ring(xhci);
 		break;
 	case TRB_EV_HOST:
@@ -202,6 +272,12 @@ xhci_handle_events(xhci_t *const xhci)
 	xhci_update_event_dq(xhci);
 }
 
+void
+xhci_handle_controller_events(hci_t *const controller)
+{
+	xhci_handle_events(XHCI_INST(controller));
+}
+
 static unsigned long
 xhci_wait_for_event(const event_ring_t *const er,
 		    unsigned long *const timeout_us)
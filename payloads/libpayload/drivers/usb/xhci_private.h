@@ -224,6 +224,12 @@ typedef volatile struct slotctx {
 #define EC_STATE_FIELD		f1		/* STATE - Endpoint State */
 #define EC_STATE_START		0
 #define EC_STATE_LEN		3
+#define EC_MAXPSTREAMS_FIELD	f1		/* MaxPStreams - Max Primary Streams */
+#define EC_MAXPSTREAMS_START	10
+#define EC_MAXPSTREAMS_LEN	5
+#define EC_LSA_FIELD		f1		/* LSA - Linear Stream Array */
+#define EC_LSA_START		15
+#define EC_LSA_LEN		1
 #define EC_INTVAL_FIELD		f1		/* INTVAL - Interval */
 #define EC_INTVAL_START		16
 #define EC_INTVAL_LEN		8
@@ -308,10 +314,41 @@ typedef struct intrq {
 	endpoint_t *ep;
 } intrq_t;
 
+/* TDs queued by xhci_bulk_submit(), the xHC completes them in order */
+#define BULKQ_SIZE 16
+typedef struct bulkq {
+	int result[BULKQ_SIZE];	/* Bytes transferred or negative CC */
+	u8 trbs[BULKQ_SIZE];	/* TRBs taken on the transfer ring */
+	size_t head;		/* The oldest TD not reaped yet */
+	size_t done;		/* TDs completed by the controller */
+	size_t tail;		/* TDs queued */
+	size_t trbs_used;	/* TRBs taken by TDs not reaped yet */
+	int failed;		/* Endpoint halted or stopped, TDs left won't complete */
+} bulkq_t;
+
+#define SCT_PRIMARY_TR		1	/* SCT - Stream Context Type */
+typedef volatile struct streamctx {
+	u32 tr_dq_low;	/* SCT in bits 3:1, DCS in bit 0 */
+	u32 tr_dq_high;
+	u32 edtla;
+	u32 rsvd;
+} streamctx_t;
+
+/* Primary Stream Array entries we set up at most, stream 0 is reserved */
+#define MAX_STREAMS 8
+typedef struct streams {
+	streamctx_t *ctx;	/* Stream Context Array */
+	size_t count;		/* Entries in the array */
+	transfer_ring_t *rings[MAX_STREAMS];
+	bulkq_t queues[MAX_STREAMS];
+} streams_t;
+
 typedef struct devinfo {
 	devctx_t ctx;
 	transfer_ring_t *transfer_rings[NUM_EPS];
 	intrq_t *interrupt_queues[NUM_EPS];
+	bulkq_t *bulk_queues[NUM_EPS];
+	streams_t *streams[NUM_EPS];
 } devinfo_t;
 
 typedef struct erst_entry {
@@ -497,6 +534,7 @@ void xhci_reset_event_ring(event_ring_t *);
 void xhci_advance_event_ring(xhci_t *);
 void xhci_update_event_dq(xhci_t *);
 void xhci_handle_events(xhci_t *);
+void xhci_handle_controller_events(hci_t *);
 int xhci_wait_for_command_aborted(xhci_t *, const trb_t *);
 int xhci_wait_for_command_done(xhci_t *, const trb_t *, int clear_event);
 int xhci_wait_for_transfer(xhci_t *, const int slot_id, const int ep_id);
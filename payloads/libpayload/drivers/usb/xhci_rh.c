@@ -72,7 +72,12 @@ xhci_rh_port_in_reset(usbdev_t *const dev, const int port)
 	xhci_t *const xhci = XHCI_INST(dev->controller);
 	volatile u32 *const portsc = &xhci->opreg->prs[port - 1].portsc;
 
-	return !!(*portsc & PORTSC_PR);
+	if (*portsc & PORTSC_PR)
+		return 1;
+
+	/* Clear reset status bits, since port is out of reset. */
+	*portsc = (*portsc & PORTSC_RW_MASK) | PORTSC_PRC | PORTSC_WRC;
+	return 0;
 }
 
 static int
@@ -100,7 +105,7 @@ xhci_rh_port_speed(usbdev_t *const dev, const int port)
 }
 
 static int
-xhci_rh_reset_port(usbdev_t *const dev, const int port)
+xhci_rh_start_port_reset(usbdev_t *const dev, const int port)
 {
 	xhci_t *const xhci = XHCI_INST(dev->controller);
 	volatile u32 *const portsc = &xhci->opreg->prs[port - 1].portsc;
@@ -108,13 +113,18 @@ xhci_rh_reset_port(usbdev_t *const dev, const int port)
 	/* Trigger port reset. */
 	*portsc = (*portsc & PORTSC_RW_MASK) | PORTSC_PR;
 
+	return 0;
+}
+
+static int
+xhci_rh_reset_port(usbdev_t *const dev, const int port)
+{
+	xhci_rh_start_port_reset(dev, port);
+
 	/* Wait for port_in_reset == 0, up to 150 * 1000us = 150ms */
 	if (generic_hub_wait_for_port(dev, port, 0, xhci_rh_port_in_reset,
 				      150, 1000) == 0)
 		usb_debug("xhci_rh: Reset timed out at port %d\n", port);
-	else
-		/* Clear reset status bits, since port is out of reset. */
-		*portsc = (*portsc & PORTSC_RW_MASK) | PORTSC_PRC | PORTSC_WRC;
 
 	return 0;
 }
@@ -146,7 +156,7 @@ static const generic_hub_ops_t xhci_rh_ops = {
 	.port_speed		= xhci_rh_port_speed,
 	.enable_port		= xhci_rh_enable_port,
 	.disable_port		= NULL,
-	.start_port_reset	= NULL,
+	.start_port_reset	= xhci_rh_start_port_reset,
 	.reset_port		= xhci_rh_reset_port,
 };
 
@@ -162,6 +172,8 @@ xhci_rh_init (usbdev_t *dev)
 	const int num_ports = /* TODO: maybe we need to read extended caps */
 		(XHCI_INST(dev->controller)->capreg->hcsparams1 >> 24) & 0xff;
 	generic_hub_init(dev, num_ports, &xhci_rh_ops);
+	/* Port changes are also signaled by Port Status Change Events */
+	dev->poll_interval = USB_EVENT_POLL_INTERVAL;
 
 	usb_debug("xHCI: root hub init done\n");
 }
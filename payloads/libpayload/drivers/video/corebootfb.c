@@ -61,45 +61,92 @@ static const u32 vga_colors[] = {
 	(0xFF << 16) | (0xFF << 8) | 0xFF,
 };
 
+/*
+ * Cache of glyphs rendered in the framebuffer format, indexed by a hash of
+ * character and attributes. A miss just renders the glyph again.
+ */
+#define GLYPH_CACHE_ENTRIES 128
+#define GLYPH_INVALID 0xffffffff
+
+struct glyph {
+	unsigned int ch;
+	unsigned char pixels[0];
+};
+
 /* Addresses for the various components */
 static unsigned long fbinfo;
 static unsigned long fbaddr;
 static unsigned long chars;
+static unsigned long shown;
+static unsigned long dirty;
+static unsigned long glyphs;
 
 #define FI ((struct cb_framebuffer *) phys_to_virt(fbinfo))
 #define FB ((unsigned char *) phys_to_virt(fbaddr))
 #define CHARS ((unsigned short *) phys_to_virt(chars))
+/* What each cell currently shows in the framebuffer */
+#define SHOWN ((unsigned short *) phys_to_virt(shown))
+/* Rows that may differ from the framebuffer */
+#define DIRTY ((unsigned char *) phys_to_virt(dirty))
+#define GLYPHS ((unsigned char *) phys_to_virt(glyphs))
 
-static void corebootfb_scroll_up(void)
+/* Scrolls since the last flush */
+static unsigned int scrolls;
+/* Set when others drew to the framebuffer since the last clear */
+static int shared;
+
+#define GLYPH_PIXEL_BYTES (FONT_WIDTH * FONT_HEIGHT * (FI->bits_per_pixel >> 3))
+#define GLYPH_ENTRY_SIZE (sizeof(struct glyph) + GLYPH_PIXEL_BYTES)
+
+/*
+ * Text changes are only made to CHARS. Rows are marked dirty, and the
+ * affected cells are drawn by corebootfb_flush(), which the video console
+ * calls once it's done with a piece of output.
+ */
+static void corebootfb_mark_dirty(unsigned int row)
 {
-	unsigned char *dst = FB;
-	unsigned char *src = FB + (FI->bytes_per_line * FONT_HEIGHT);
-	int y;
+	if (row < coreboot_video_console.rows)
+		DIRTY[row] = 1;
+}
 
-	/* Scroll all lines up */
-	for(y = 0; y < FI->y_resolution - FONT_HEIGHT; y++) {
-		memcpy(dst, src, FI->x_resolution * (FI->bits_per_pixel >> 3));
+static void corebootfb_scroll_up(void)
+{
+	const int columns = coreboot_video_console.columns;
+	const int rows = coreboot_video_console.rows;
+	int column;
 
-		dst += FI->bytes_per_line;
-		src += FI->bytes_per_line;
-	}
+	/*
+	 * The first scroll after a flush moves the framebuffer along with
+	 * SHOWN and DIRTY. With one line per write, that's cheaper than
+	 * drawing the whole screen again. Further scrolls before the next
+	 * flush only move the text, the flush draws the cells that changed.
+	 * Pixels drawn by others are always moved with the text.
+	 */
+	if (shared || !scrolls++) {
+		const int line = FONT_HEIGHT * FI->bytes_per_line;
+		unsigned char *dst = FB + (rows - 1) * line;
+		int y;
+
+		memmove(FB, FB + line, (rows - 1) * line);
+		for (y = 0; y < FONT_HEIGHT; y++) {
+			memset(dst, 0, FI->x_resolution * (FI->bits_per_pixel >> 3));
+			dst += FI->bytes_per_line;
+		}
 
-	/* Erase last line */
-	dst = FB + (FI->y_resolution - FONT_HEIGHT) * FI->bytes_per_line;
+		memmove(SHOWN, SHOWN + columns, columns * (rows - 1) * 2);
+		for (column = 0; column < columns; column++)
+			SHOWN[(rows - 1) * columns + column] =
+				(VGA_COLOR_DEFAULT << 8);
 
-	for(; y < FI->y_resolution; y++) {
-		memset(dst, 0, FI->x_resolution * (FI->bits_per_pixel >> 3));
-		dst += FI->bytes_per_line;
+		memmove(DIRTY, DIRTY + 1, rows - 1);
+		DIRTY[rows - 1] = 0;
+	} else {
+		memset(DIRTY, 1, rows);
 	}
 
-	/* And update the char buffer */
-	dst = (unsigned char *) CHARS;
-	src = (unsigned char *) (CHARS + coreboot_video_console.columns);
-	memcpy(dst, src, coreboot_video_console.columns *
-			(coreboot_video_console.rows - 1) * 2);
-	int column;
-	for (column = 0; column < coreboot_video_console.columns; column++)
-		CHARS[(coreboot_video_console.rows - 1) * coreboot_video_console.columns + column] = (VGA_COLOR_DEFAULT << 8);
+	memmove(CHARS, CHARS + columns, columns * (rows - 1) * 2);
+	for (column = 0; column < columns; column++)
+		CHARS[(rows - 1) * columns + column] = (VGA_COLOR_DEFAULT << 8);
 
 	cursor_y--;
 }
@@ -115,96 +162,148 @@ static void corebootfb_clear(void)
 		ptr += FI->bytes_per_line;
 	}
 
-	/* And update the char buffer */
+	/* And update the char buffer, a blank cell is all black */
 	for(row = 0; row < coreboot_video_console.rows; row++)
 		for (column = 0; column < coreboot_video_console.columns; column++)
-			CHARS[row * coreboot_video_console.columns + column] = (VGA_COLOR_DEFAULT << 8);
+			CHARS[row * coreboot_video_console.columns + column] =
+				SHOWN[row * coreboot_video_console.columns + column] =
+				(VGA_COLOR_DEFAULT << 8);
+
+	/* The cursor still has to be drawn */
+	memset(DIRTY, 1, coreboot_video_console.rows);
+	shared = 0;
 }
 
-static void corebootfb_putchar(u8 row, u8 col, unsigned int ch)
+static u32 corebootfb_color(unsigned char color)
 {
-	unsigned char *dst;
-	unsigned char *glyph = font8x16 + ((ch & 0xFF) * FONT_HEIGHT);
-
-	unsigned char bg = (ch >> 12) & 0xF;
-	unsigned char fg = (ch >> 8) & 0xF;
-	u32 fgval = 0, bgval = 0;
-	u16 *dst16;
-	u32 *dst32;
-
-	int x, y;
-
-	if (FI->bits_per_pixel > 8) {
-		bgval = ((((vga_colors[bg] >> 0) & 0xff) >> (8 - FI->blue_mask_size)) << FI->blue_mask_pos) |
-			((((vga_colors[bg] >> 8) & 0xff) >> (8 - FI->green_mask_size)) << FI->green_mask_pos) |
-			((((vga_colors[bg] >> 16) & 0xff) >> (8 - FI->red_mask_size)) << FI->red_mask_pos);
-		fgval = ((((vga_colors[fg] >> 0) & 0xff) >> (8 - FI->blue_mask_size)) << FI->blue_mask_pos) |
-			((((vga_colors[fg] >> 8) & 0xff) >> (8 - FI->green_mask_size)) << FI->green_mask_pos) |
-			((((vga_colors[fg] >> 16) & 0xff) >> (8 - FI->red_mask_size)) << FI->red_mask_pos);
+	/* Indexed */
+	if (FI->bits_per_pixel == 8)
+		return color;
+
+	return ((((vga_colors[color] >> 0) & 0xff) >> (8 - FI->blue_mask_size)) << FI->blue_mask_pos) |
+		((((vga_colors[color] >> 8) & 0xff) >> (8 - FI->green_mask_size)) << FI->green_mask_pos) |
+		((((vga_colors[color] >> 16) & 0xff) >> (8 - FI->red_mask_size)) << FI->red_mask_pos);
+}
+
+/* Render a character into a buffer in the framebuffer format. */
+static void corebootfb_render(unsigned char *dst, int stride, unsigned int ch)
+{
+	const unsigned char *glyph = font8x16 + ((ch & 0xFF) * FONT_HEIGHT);
+	const u32 bgval = corebootfb_color((ch >> 12) & 0xF);
+	const u32 fgval = corebootfb_color((ch >> 8) & 0xF);
+	const int bytes = FI->bits_per_pixel >> 3;
+	int x, y, i;
+
+	for(y = 0; y < FONT_HEIGHT; y++, dst += stride, glyph++) {
+		switch (bytes) {
+		case 2: /* 16 bpp */
+			for(x = 0; x < FONT_WIDTH; x++)
+				((u16 *)dst)[x] = (*glyph & (0x80 >> x)) ?
+						  fgval : bgval;
+			break;
+		case 4: /* 32 bpp */
+			for(x = 0; x < FONT_WIDTH; x++)
+				((u32 *)dst)[x] = (*glyph & (0x80 >> x)) ?
+						  fgval : bgval;
+			break;
+		default: /* Indexed and 24 bpp */
+			for(x = 0; x < FONT_WIDTH; x++) {
+				const u32 val = (*glyph & (0x80 >> x)) ?
+						fgval : bgval;
+				for (i = 0; i < bytes; i++)
+					dst[x * bytes + i] = val >> (i * 8);
+			}
+			break;
+		}
 	}
+}
 
+static void corebootfb_putchar(u8 row, u8 col, unsigned int ch)
+{
+	const int bytes = FONT_WIDTH * (FI->bits_per_pixel >> 3);
+	unsigned char *dst;
+	struct glyph *cached;
+	int y;
 
 	dst = FB + ((row * FONT_HEIGHT) * FI->bytes_per_line);
-	dst += (col * FONT_WIDTH * (FI->bits_per_pixel >> 3));
+	dst += col * bytes;
 
-	for(y = 0; y < FONT_HEIGHT; y++) {
-		for(x = FONT_WIDTH - 1; x >= 0; x--) {
-
-			switch (FI->bits_per_pixel) {
-			case 8: /* Indexed */
-				dst[(FONT_WIDTH - x) * (FI->bits_per_pixel >> 3)] = (*glyph & (1 << x)) ?  fg : bg;
-				break;
-			case 16: /* 16 bpp */
-				dst16 = (u16 *)(dst + (FONT_WIDTH - x) * (FI->bits_per_pixel >> 3));
-				*dst16 = (*glyph & (1 << x)) ? fgval : bgval;
-				break;
-			case 24: /* 24 bpp */
-				if (*glyph & (1 << x)) {
-					dst[(FONT_WIDTH - x) * (FI->bits_per_pixel >> 3) + 0] = fgval & 0xff;
-					dst[(FONT_WIDTH - x) * (FI->bits_per_pixel >> 3) + 1] = (fgval >> 8) & 0xff;
-					dst[(FONT_WIDTH - x) * (FI->bits_per_pixel >> 3) + 2] = (fgval >> 16) & 0xff;
-				} else {
-					dst[(FONT_WIDTH - x) * (FI->bits_per_pixel >> 3) + 0] = bgval & 0xff;
-					dst[(FONT_WIDTH - x) * (FI->bits_per_pixel >> 3) + 1] = (bgval >> 8) & 0xff;
-					dst[(FONT_WIDTH - x) * (FI->bits_per_pixel >> 3) + 2] = (bgval >> 16) & 0xff;
-				}
-				break;
-			case 32: /* 32 bpp */
-				dst32 = (u32 *)(dst + (FONT_WIDTH - x) * (FI->bits_per_pixel >> 3));
-				*dst32 = (*glyph & (1 << x)) ? fgval : bgval;
-				break;
-			}
-		}
+	if (!glyphs) {
+		corebootfb_render(dst, FI->bytes_per_line, ch);
+		return;
+	}
+
+	cached = (struct glyph *)(GLYPHS + GLYPH_ENTRY_SIZE *
+			(((ch & 0xff) ^ ((ch >> 8) * 37)) % GLYPH_CACHE_ENTRIES));
+	if (cached->ch != ch) {
+		corebootfb_render(cached->pixels, bytes, ch);
+		cached->ch = ch;
+	}
 
+	for(y = 0; y < FONT_HEIGHT; y++) {
+		memcpy(dst, cached->pixels + y * bytes, bytes);
 		dst += FI->bytes_per_line;
-		glyph++;
 	}
 }
 
 static void corebootfb_putc(u8 row, u8 col, unsigned int ch)
 {
 	CHARS[row * coreboot_video_console.columns + col] = ch;
-	corebootfb_putchar(row, col, ch);
+	/* Others may have drawn over the cell, so make sure it's drawn */
+	if (shared)
+		SHOWN[row * coreboot_video_console.columns + col] = ~ch;
+	corebootfb_mark_dirty(row);
 }
 
-static void corebootfb_update_cursor(void)
+/* What a cell should show, including the cursor. */
+static unsigned short corebootfb_paint(unsigned int row, unsigned int col)
 {
-	int ch, paint;
-	if(cursor_en) {
-		ch = CHARS[cursor_y * coreboot_video_console.columns + cursor_x];
-		paint = (ch & 0xff) | ((ch<<4) & 0xf000) | ((ch >> 4) & 0x0f00);
-	} else {
-		paint = CHARS[cursor_y * coreboot_video_console.columns + cursor_x];
+	unsigned short ch = CHARS[row * coreboot_video_console.columns + col];
+
+	if (cursor_en && row == cursor_y && col == cursor_x)
+		ch = (ch & 0xff) | ((ch<<4) & 0xf000) | ((ch >> 4) & 0x0f00);
+
+	return ch;
+}
+
+static void corebootfb_flush(void)
+{
+	const int columns = coreboot_video_console.columns;
+	int row, col;
+
+	for (row = 0; row < coreboot_video_console.rows; row++) {
+		if (!DIRTY[row])
+			continue;
+		DIRTY[row] = 0;
+
+		for (col = 0; col < columns; col++) {
+			const unsigned short paint = corebootfb_paint(row, col);
+
+			if (SHOWN[row * columns + col] == paint)
+				continue;
+
+			SHOWN[row * columns + col] = paint;
+			corebootfb_putchar(row, col, paint);
+		}
 	}
 
-	if (cursor_y < coreboot_video_console.rows)
-		corebootfb_putchar(cursor_y, cursor_x, paint);
+	scrolls = 0;
+}
+
+/*
+ * Someone else drew to the framebuffer, so SHOWN can't be trusted for the
+ * cells the console writes. Until the next clear, written cells are always
+ * drawn and scrolling moves the framebuffer like the text.
+ */
+static void corebootfb_invalidate(void)
+{
+	shared = 1;
 }
 
 static void corebootfb_enable_cursor(int state)
 {
 	cursor_en = state;
-	corebootfb_update_cursor();
+	corebootfb_mark_dirty(cursor_y);
 }
 
 static void corebootfb_get_cursor(unsigned int *x, unsigned int *y, unsigned int *en)
@@ -216,15 +315,12 @@ static void corebootfb_get_cursor(unsigned int *x, unsigned int *y, unsigned int
 
 static void corebootfb_set_cursor(unsigned int x, unsigned int y)
 {
-	int cursor_remember = cursor_en;
-	if (cursor_remember)
-		corebootfb_enable_cursor(0);
+	corebootfb_mark_dirty(cursor_y);
 
 	cursor_x = x;
 	cursor_y = y;
 
-	if (cursor_remember)
-		corebootfb_enable_cursor(1);
+	corebootfb_mark_dirty(cursor_y);
 }
 
 static int corebootfb_init(void)
@@ -242,8 +338,33 @@ static int corebootfb_init(void)
 	coreboot_video_console.rows = FI->y_resolution / FONT_HEIGHT;
 
 	/* See setting of fbinfo above. */
-	chars = virt_to_phys(malloc(coreboot_video_console.rows *
-				    coreboot_video_console.columns * 2));
+	void *ptr = malloc(coreboot_video_console.rows *
+			   coreboot_video_console.columns * 2);
+	if (!ptr)
+		return -1;
+	chars = virt_to_phys(ptr);
+
+	ptr = malloc(coreboot_video_console.rows *
+		     coreboot_video_console.columns * 2);
+	if (!ptr)
+		return -1;
+	shown = virt_to_phys(ptr);
+
+	ptr = malloc(coreboot_video_console.rows);
+	if (!ptr)
+		return -1;
+	dirty = virt_to_phys(ptr);
+
+	/* The glyph cache is optional, glyphs are rendered directly without. */
+	ptr = malloc(GLYPH_CACHE_ENTRIES * GLYPH_ENTRY_SIZE);
+	glyphs = 0;
+	if (ptr) {
+		int i;
+		for (i = 0; i < GLYPH_CACHE_ENTRIES; i++)
+			((struct glyph *)(ptr + i * GLYPH_ENTRY_SIZE))->ch =
+				GLYPH_INVALID;
+		glyphs = virt_to_phys(ptr);
+	}
 
 	// clear boot splash screen if there is one.
 	corebootfb_clear();
@@ -255,6 +376,8 @@ struct video_console coreboot_video_console = {
 	.putc = corebootfb_putc,
 	.clear = corebootfb_clear,
 	.scroll_up = corebootfb_scroll_up,
+	.flush = corebootfb_flush,
+	.invalidate = corebootfb_invalidate,
 
 	.get_cursor = corebootfb_get_cursor,
 	.set_cursor = corebootfb_set_cursor,
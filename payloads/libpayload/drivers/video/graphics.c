@@ -48,6 +48,35 @@ static struct rect screen;
 static struct cb_framebuffer *fbinfo;
 static uint8_t *fbaddr;
 
+/*
+ * Optional back buffer. While it's enabled, everything is drawn into it and
+ * the bounding box of what was drawn is copied to the framebuffer by
+ * flush_graphics_buffer(). This avoids many small writes to framebuffers
+ * which are mapped uncached.
+ */
+static uint8_t *gfx_buffer;
+static struct rect dirty;
+
+/*
+ * Bitmaps already converted to the framebuffer format at the size they were
+ * drawn, most recently used first. Entries are looked up by the address and
+ * size of the bitmap data, so the data must not change while it's cached.
+ */
+struct bitmap_cache_entry {
+	struct bitmap_cache_entry *next;
+	const void *bitmap;
+	size_t size;
+	/* Requested size, all zero for draw_bitmap_direct() */
+	struct scale dim_rel;
+	struct vector dim;
+	size_t bytes;
+	uint8_t pixels[0];
+};
+
+static struct bitmap_cache_entry *bitmap_cache;
+static size_t bitmap_cache_budget;
+static size_t bitmap_cache_used;
+
 #define LOG(x...)	printf("CBGFX: " x)
 #define PIVOT_H_MASK	(PIVOT_H_LEFT|PIVOT_H_CENTER|PIVOT_H_RIGHT)
 #define PIVOT_V_MASK	(PIVOT_V_TOP|PIVOT_V_CENTER|PIVOT_V_BOTTOM)
@@ -118,18 +147,107 @@ static inline uint32_t calculate_color(const struct rgb_color *rgb)
 	return color;
 }
 
+/* Address of a pixel in the back buffer, or in the framebuffer if there's none */
+static inline uint8_t *pixel_addr(int x, int y)
+{
+	uint8_t * const base = gfx_buffer ? gfx_buffer : fbaddr;
+	return base + y * fbinfo->bytes_per_line +
+	       x * (fbinfo->bits_per_pixel / 8);
+}
+
 /*
- * Plot a pixel in a framebuffer. This is called from tight loops. Keep it slim
- * and do the validation at callers' site.
+ * Grow the area to be copied by the next flush_graphics_buffer(). Without
+ * a back buffer, the framebuffer itself was drawn to.
  */
-static inline void set_pixel(struct vector *coord, uint32_t color)
+static void mark_dirty(const struct vector *top_left, const struct vector *size)
+{
+	struct vector t;
+
+	if (size->width <= 0 || size->height <= 0)
+		return;
+
+	if (!gfx_buffer) {
+		if (IS_ENABLED(CONFIG_LP_VIDEO_CONSOLE))
+			video_console_invalidate();
+		return;
+	}
+
+	if (dirty.size.width == 0) {
+		dirty.offset = *top_left;
+		dirty.size = *size;
+		return;
+	}
+
+	t.x = MAX(dirty.offset.x + dirty.size.width, top_left->x + size->width);
+	t.y = MAX(dirty.offset.y + dirty.size.height,
+		  top_left->y + size->height);
+	dirty.offset.x = MIN(dirty.offset.x, top_left->x);
+	dirty.offset.y = MIN(dirty.offset.y, top_left->y);
+	dirty.size.width = t.x - dirty.offset.x;
+	dirty.size.height = t.y - dirty.offset.y;
+}
+
+/*
+ * Plot a pixel. This is called from tight loops. Keep it slim and do the
+ * validation at callers' site. bpp is a constant at most call sites, which
+ * turns this into a single store for 16 and 32 bpp.
+ */
+static inline __attribute__((always_inline))
+void write_pixel(uint8_t *pixel, uint32_t color, const int bpp)
 {
-	const int bpp = fbinfo->bits_per_pixel;
 	int i;
-	uint8_t * const pixel = fbaddr + (coord->x +
-			coord->y * fbinfo->x_resolution) * bpp / 8;
-	for (i = 0; i < bpp / 8; i++)
-		pixel[i] = (color >> (i * 8));
+
+	switch (bpp) {
+	case 32:
+		*(uint32_t *)pixel = htole32(color);
+		break;
+	case 16:
+		*(uint16_t *)pixel = htole16(color);
+		break;
+	default:
+		for (i = 0; i < bpp / 8; i++)
+			pixel[i] = (color >> (i * 8));
+	}
+}
+
+/* Fill count pixels of a row, starting at pixel. */
+static void fill_span(uint8_t *pixel, int count, uint32_t color)
+{
+	const int bpp = fbinfo->bits_per_pixel;
+	uint32_t *p;
+
+	switch (bpp) {
+	case 32:
+		for (p = (uint32_t *)pixel; count > 0; count--)
+			*p++ = htole32(color);
+		break;
+	case 16:
+		/* Store two pixels at a time */
+		if ((uintptr_t)pixel & 2 && count > 0) {
+			write_pixel(pixel, color, 16);
+			pixel += 2;
+			count--;
+		}
+		for (p = (uint32_t *)pixel; count > 1; count -= 2)
+			*p++ = htole32(color | color << 16);
+		if (count > 0)
+			write_pixel((uint8_t *)p, color, 16);
+		break;
+	default:
+		for (; count > 0; count--, pixel += bpp / 8)
+			write_pixel(pixel, color, bpp);
+	}
+}
+
+static void fill_rect(const struct vector *top_left, const struct vector *size,
+		      uint32_t color)
+{
+	int y;
+
+	for (y = top_left->y; y < top_left->y + size->height; y++)
+		fill_span(pixel_addr(top_left->x, y), size->width, color);
+
+	mark_dirty(top_left, size);
 }
 
 /*
@@ -176,7 +294,7 @@ int draw_box(const struct rect *box, const struct rgb_color *rgb)
 {
 	struct vector top_left;
 	struct vector size;
-	struct vector p, t;
+	struct vector t;
 	const uint32_t color = calculate_color(rgb);
 	const struct scale top_left_s = {
 		.x = { .n = box->offset.x, .d = CANVAS_SCALE, },
@@ -198,9 +316,7 @@ int draw_box(const struct rect *box, const struct rgb_color *rgb)
 		return CBGFX_ERROR_BOUNDARY;
 	}
 
-	for (p.y = top_left.y; p.y < t.y; p.y++)
-		for (p.x = top_left.x; p.x < t.x; p.x++)
-			set_pixel(&p, color);
+	fill_rect(&top_left, &size, color);
 
 	return CBGFX_SUCCESS;
 }
@@ -226,7 +342,6 @@ int clear_screen(const struct rgb_color *rgb)
 	if (cbgfx_init())
 		return CBGFX_ERROR_INIT;
 
-	struct vector p;
 	uint32_t color = calculate_color(rgb);
 	const int bpp = fbinfo->bits_per_pixel;
 	const int bpl = fbinfo->bytes_per_line;
@@ -235,32 +350,81 @@ int clear_screen(const struct rgb_color *rgb)
 	 * We assume that for 32bpp the high byte gets ignored anyway. */
 	if ((((color >> 8) & 0xff) == (color & 0xff)) && (bpp == 16 ||
 	    (((color >> 16) & 0xff) == (color & 0xff)))) {
-		memset(fbaddr, color & 0xff, screen.size.height * bpl);
+		memset(pixel_addr(0, 0), color & 0xff,
+		       screen.size.height * bpl);
+		mark_dirty(&screen.offset, &screen.size);
 	} else {
-		for (p.y = 0; p.y < screen.size.height; p.y++)
-			for (p.x = 0; p.x < screen.size.width; p.x++)
-				set_pixel(&p, color);
+		fill_rect(&screen.offset, &screen.size, color);
 	}
 
 	return CBGFX_SUCCESS;
 }
 
+/* Fixed point weights of the bilinear interpolation */
+#define BLI_SHIFT	10
+#define BLI_ONE		(1 << BLI_SHIFT)
+
 /*
  * Bi-linear Interpolation
  *
  * It estimates the value of a middle point (tx, ty) using the values from four
- * adjacent points (q00, q01, q10, q11).
+ * adjacent points (q00, q01, q10, q11). wx and wy are the distances of the
+ * middle point from q00 in units of 1 / BLI_ONE.
  */
-static uint32_t bli(uint32_t q00, uint32_t q10, uint32_t q01, uint32_t q11,
-		    struct fraction *tx, struct fraction *ty)
+static inline uint32_t bli(uint32_t q00, uint32_t q10, uint32_t q01,
+			   uint32_t q11, uint32_t wx, uint32_t wy)
+{
+	uint32_t r0 = q00 * (BLI_ONE - wx) + q10 * wx;
+	uint32_t r1 = q01 * (BLI_ONE - wx) + q11 * wx;
+	return (r0 * (BLI_ONE - wy) + r1 * wy) >> (2 * BLI_SHIFT);
+}
+
+/* Source pixels and weight for one column of a scaled bitmap */
+struct bli_column {
+	int32_t s0;
+	int32_t s1;
+	uint32_t wx;
+};
+
+static inline __attribute__((always_inline))
+void draw_bitmap_row(uint8_t *pixel, int width,
+		     const uint8_t *data0, const uint8_t *data1, uint32_t wy,
+		     const struct bli_column *cols,
+		     const struct bitmap_palette_element_v3 *pal,
+		     const uint32_t *colors, const int bpp)
 {
-	uint32_t r0 = (tx->n * q10 + (tx->d - tx->n) * q00) / tx->d;
-	uint32_t r1 = (tx->n * q11 + (tx->d - tx->n) * q01) / tx->d;
-	uint32_t p = (ty->n * r1 + (ty->d - ty->n) * r0) / ty->d;
-	return p;
+	int x;
+
+	for (x = 0; x < width; x++, pixel += bpp / 8) {
+		const struct bli_column *col = &cols[x];
+		uint8_t c00 = data0[col->s0];
+
+		if (col->wx == 0 && wy == 0) {
+			write_pixel(pixel, colors[c00], bpp);
+			continue;
+		}
+
+		uint8_t c10 = data0[col->s1];
+		uint8_t c01 = data1[col->s0];
+		uint8_t c11 = data1[col->s1];
+		const struct rgb_color rgb = {
+			.red = bli(pal[c00].red, pal[c10].red,
+				   pal[c01].red, pal[c11].red, col->wx, wy),
+			.green = bli(pal[c00].green, pal[c10].green,
+				     pal[c01].green, pal[c11].green,
+				     col->wx, wy),
+			.blue = bli(pal[c00].blue, pal[c10].blue,
+				    pal[c01].blue, pal[c11].blue, col->wx, wy),
+		};
+		write_pixel(pixel, calculate_color(&rgb), bpp);
+	}
 }
 
-static int draw_bitmap_v3(const struct vector *top_left,
+/*
+ * Render a bitmap at dim into dst. stride is the distance of two rows in
+ * dst in bytes, the pixel format is the framebuffer's.
+ */
+static int draw_bitmap_v3(uint8_t *dst, size_t stride,
 			  const struct scale *scale,
 			  const struct vector *dim,
 			  const struct vector *dim_org,
@@ -269,8 +433,10 @@ static int draw_bitmap_v3(const struct vector *top_left,
 			  const uint8_t *pixel_array)
 {
 	const int bpp = header->bits_per_pixel;
-	int32_t dir;
+	uint32_t colors[256];
+	struct bli_column *cols;
 	struct vector p;
+	int i;
 
 	if (header->compression) {
 		LOG("Compressed bitmaps are not supported\n");
@@ -290,26 +456,31 @@ static int draw_bitmap_v3(const struct vector *top_left,
 	}
 
 	const int32_t y_stride = ROUNDUP(dim_org->width * bpp / 8, 4);
-	/*
-	 * header->height can be positive or negative.
-	 *
-	 * If it's negative, pixel data is stored from top to bottom. We render
-	 * image from the lowest row to the highest row.
-	 *
-	 * If it's positive, pixel data is stored from bottom to top. We render
-	 * image from the highest row to the lowest row.
-	 */
-	p.y = top_left->y;
-	if (header->height < 0) {
-		dir = 1;
-	} else {
-		p.y += dim->height - 1;
-		dir = -1;
+
+	/* Check the color indices once instead of for every pixel drawn. */
+	if (header->colors_used < ARRAY_SIZE(colors)) {
+		for (p.y = 0; p.y < dim_org->height; p.y++) {
+			const uint8_t *data = pixel_array + p.y * y_stride;
+			for (p.x = 0; p.x < dim_org->width; p.x++) {
+				if (data[p.x] >= header->colors_used) {
+					LOG("Color index exceeds palette boundary\n");
+					return CBGFX_ERROR_BITMAP_DATA;
+				}
+			}
+		}
+	}
+	for (i = 0; i < ARRAY_SIZE(colors) && i < header->colors_used; i++) {
+		const struct rgb_color rgb = {
+			.red = pal[i].red,
+			.green = pal[i].green,
+			.blue = pal[i].blue,
+		};
+		colors[i] = calculate_color(&rgb);
 	}
+
 	/*
-	 * Plot pixels scaled by the bilinear interpolation. We scan over the
-	 * image on canvas (using d) and find the corresponding pixel in the
-	 * bitmap data (using s0, s1).
+	 * The source columns and weights are the same for every row, so
+	 * calculate them once.
 	 *
 	 * When d hits the right bottom corner, s0 also hits the right bottom
 	 * corner of the pixel array because that's how scale->x and scale->y
@@ -317,51 +488,199 @@ static int draw_bitmap_v3(const struct vector *top_left,
 	 * parse_bitmap_header_v3, s0 is guranteed not to exceed pixel array
 	 * boundary.
 	 */
+	cols = malloc(dim->width * sizeof(*cols));
+	if (!cols)
+		return CBGFX_ERROR_NO_MEMORY;
+	for (i = 0; i < dim->width; i++) {
+		cols[i].s0 = i * scale->x.d / scale->x.n;
+		cols[i].s1 = cols[i].s0;
+		if (cols[i].s1 + 1 < dim_org->width)
+			cols[i].s1++;
+		cols[i].wx = (i * scale->x.d) % scale->x.n * BLI_ONE /
+			     scale->x.n;
+	}
+
+	/*
+	 * Plot pixels scaled by the bilinear interpolation, one row at a time.
+	 * We scan over the image on canvas (using d) and find the
+	 * corresponding rows in the bitmap data (using s0, s1).
+	 */
 	struct vector s0, s1, d;
-	struct fraction tx, ty;
-	for (d.y = 0; d.y < dim->height; d.y++, p.y += dir) {
+	uint32_t wy;
+	for (d.y = 0; d.y < dim->height; d.y++) {
 		s0.y = d.y * scale->y.d / scale->y.n;
 		s1.y = s0.y;
 		if (s0.y + 1 < dim_org->height)
 			s1.y++;
-		ty.d = scale->y.n;
-		ty.n = (d.y * scale->y.d) % scale->y.n;
+		wy = (d.y * scale->y.d) % scale->y.n * BLI_ONE / scale->y.n;
 		const uint8_t *data0 = pixel_array + s0.y * y_stride;
 		const uint8_t *data1 = pixel_array + s1.y * y_stride;
-		p.x = top_left->x;
-		for (d.x = 0; d.x < dim->width; d.x++, p.x++) {
-			s0.x = d.x * scale->x.d / scale->x.n;
-			s1.x = s0.x;
-			if (s1.x + 1 < dim_org->width)
-				s1.x++;
-			tx.d = scale->x.n;
-			tx.n = (d.x * scale->x.d) % scale->x.n;
-			uint8_t c00 = data0[s0.x];
-			uint8_t c10 = data0[s1.x];
-			uint8_t c01 = data1[s0.x];
-			uint8_t c11 = data1[s1.x];
-			if (c00 >= header->colors_used
-					|| c10 >= header->colors_used
-					|| c01 >= header->colors_used
-					|| c11 >= header->colors_used) {
-				LOG("Color index exceeds palette boundary\n");
-				return CBGFX_ERROR_BITMAP_DATA;
-			}
-			const struct rgb_color rgb = {
-				.red = bli(pal[c00].red, pal[c10].red,
-					   pal[c01].red, pal[c11].red,
-					   &tx, &ty),
-				.green = bli(pal[c00].green, pal[c10].green,
-					     pal[c01].green, pal[c11].green,
-					     &tx, &ty),
-				.blue = bli(pal[c00].blue, pal[c10].blue,
-					    pal[c01].blue, pal[c11].blue,
-					    &tx, &ty),
-			};
-			set_pixel(&p, calculate_color(&rgb));
+		/*
+		 * header->height can be positive or negative.
+		 *
+		 * If it's negative, pixel data is stored from top to bottom.
+		 * If it's positive, pixel data is stored from bottom to top.
+		 */
+		uint8_t *pixel = dst + stride * (header->height < 0 ?
+					d.y : dim->height - 1 - d.y);
+
+		switch (fbinfo->bits_per_pixel) {
+		case 32:
+			draw_bitmap_row(pixel, dim->width, data0, data1, wy,
+					cols, pal, colors, 32);
+			break;
+		case 16:
+			draw_bitmap_row(pixel, dim->width, data0, data1, wy,
+					cols, pal, colors, 16);
+			break;
+		default:
+			draw_bitmap_row(pixel, dim->width, data0, data1, wy,
+					cols, pal, colors,
+					fbinfo->bits_per_pixel);
 		}
 	}
 
+	free(cols);
+
+	return CBGFX_SUCCESS;
+}
+
+static struct bitmap_cache_entry *bitmap_cache_find(const void *bitmap,
+						    size_t size,
+						    const struct scale *dim_rel)
+{
+	struct bitmap_cache_entry **link, *entry;
+
+	for (link = &bitmap_cache; (entry = *link); link = &entry->next) {
+		if (entry->bitmap != bitmap || entry->size != size ||
+		    memcmp(&entry->dim_rel, dim_rel, sizeof(*dim_rel)))
+			continue;
+
+		/* Move to the front of the list */
+		*link = entry->next;
+		entry->next = bitmap_cache;
+		bitmap_cache = entry;
+		return entry;
+	}
+
+	return NULL;
+}
+
+/* Drop the least recently used entry. */
+static void bitmap_cache_evict(void)
+{
+	struct bitmap_cache_entry **link = &bitmap_cache;
+
+	if (!bitmap_cache)
+		return;
+
+	while ((*link)->next)
+		link = &(*link)->next;
+
+	bitmap_cache_used -= (*link)->bytes;
+	free(*link);
+	*link = NULL;
+}
+
+/*
+ * Make room for and add an entry of dim to the cache. Returns NULL if the
+ * cache is disabled or the bitmap doesn't fit into it.
+ */
+static struct bitmap_cache_entry *bitmap_cache_add(const void *bitmap,
+						   size_t size,
+						   const struct scale *dim_rel,
+						   const struct vector *dim)
+{
+	struct bitmap_cache_entry *entry;
+	const size_t bytes = sizeof(*entry) + dim->width * dim->height *
+			     (fbinfo->bits_per_pixel / 8);
+
+	if (bytes > bitmap_cache_budget)
+		return NULL;
+
+	while (bitmap_cache_used + bytes > bitmap_cache_budget)
+		bitmap_cache_evict();
+
+	entry = malloc(bytes);
+	if (!entry)
+		return NULL;
+
+	entry->bitmap = bitmap;
+	entry->size = size;
+	entry->dim_rel = *dim_rel;
+	entry->dim = *dim;
+	entry->bytes = bytes;
+	entry->next = bitmap_cache;
+	bitmap_cache = entry;
+	bitmap_cache_used += bytes;
+
+	return entry;
+}
+
+static void bitmap_cache_remove(struct bitmap_cache_entry *entry)
+{
+	struct bitmap_cache_entry **link;
+
+	for (link = &bitmap_cache; *link; link = &(*link)->next) {
+		if (*link == entry) {
+			*link = entry->next;
+			bitmap_cache_used -= entry->bytes;
+			free(entry);
+			return;
+		}
+	}
+}
+
+/* Copy a cached bitmap to the screen. */
+static void bitmap_cache_blit(const struct bitmap_cache_entry *entry,
+			      const struct vector *top_left)
+{
+	const size_t row = entry->dim.width * (fbinfo->bits_per_pixel / 8);
+	int y;
+
+	for (y = 0; y < entry->dim.height; y++)
+		memcpy(pixel_addr(top_left->x, top_left->y + y),
+		       entry->pixels + y * row, row);
+
+	mark_dirty(top_left, &entry->dim);
+}
+
+/*
+ * Draw a bitmap at top_left, going through the bitmap cache if it's enabled.
+ * dim_rel is the cache key besides the bitmap data.
+ */
+static int render_bitmap(const void *bitmap, size_t size,
+			 const struct scale *dim_rel,
+			 const struct vector *top_left,
+			 const struct scale *scale,
+			 const struct vector *dim,
+			 const struct vector *dim_org,
+			 const struct bitmap_header_v3 *header,
+			 const struct bitmap_palette_element_v3 *palette,
+			 const uint8_t *pixel_array)
+{
+	struct bitmap_cache_entry *entry;
+	int rv;
+
+	entry = bitmap_cache_add(bitmap, size, dim_rel, dim);
+	if (!entry) {
+		rv = draw_bitmap_v3(pixel_addr(top_left->x, top_left->y),
+				    fbinfo->bytes_per_line, scale, dim,
+				    dim_org, header, palette, pixel_array);
+		mark_dirty(top_left, dim);
+		return rv;
+	}
+
+	rv = draw_bitmap_v3(entry->pixels,
+			    dim->width * (fbinfo->bits_per_pixel / 8),
+			    scale, dim, dim_org, header, palette, pixel_array);
+	if (rv) {
+		bitmap_cache_remove(entry);
+		return rv;
+	}
+
+	bitmap_cache_blit(entry, top_left);
+
 	return CBGFX_SUCCESS;
 }
 
@@ -556,12 +875,31 @@ int draw_bitmap(const void *bitmap, size_t size,
 	const struct bitmap_palette_element_v3 *palette;
 	const uint8_t *pixel_array;
 	struct vector top_left, dim, dim_org;
+	struct bitmap_cache_entry *entry;
 	struct scale scale;
 	int rv;
 
 	if (cbgfx_init())
 		return CBGFX_ERROR_INIT;
 
+	/* Already converted at this size, just copy it to the screen */
+	entry = bitmap_cache_find(bitmap, size, dim_rel);
+	if (entry) {
+		rv = calculate_position(&entry->dim, pos_rel, pivot,
+					&top_left);
+		if (rv)
+			return rv;
+
+		rv = check_boundary(&top_left, &entry->dim, &canvas);
+		if (rv) {
+			LOG("Bitmap image exceeds canvas boundary\n");
+			return rv;
+		}
+
+		bitmap_cache_blit(entry, &top_left);
+		return CBGFX_SUCCESS;
+	}
+
 	/* only v3 is supported now */
 	rv = parse_bitmap_header_v3(bitmap, size,
 				    &header, &palette, &pixel_array, &dim_org);
@@ -590,8 +928,8 @@ int draw_bitmap(const void *bitmap, size_t size,
 		return rv;
 	}
 
-	return draw_bitmap_v3(&top_left, &scale, &dim, &dim_org,
-			      &header, palette, pixel_array);
+	return render_bitmap(bitmap, size, dim_rel, &top_left, &scale, &dim,
+			     &dim_org, &header, palette, pixel_array);
 }
 
 int draw_bitmap_direct(const void *bitmap, size_t size,
@@ -601,12 +939,26 @@ int draw_bitmap_direct(const void *bitmap, size_t size,
 	const struct bitmap_palette_element_v3 *palette;
 	const uint8_t *pixel_array;
 	struct vector dim;
+	struct bitmap_cache_entry *entry;
 	struct scale scale;
+	const struct scale no_scale = { };
 	int rv;
 
 	if (cbgfx_init())
 		return CBGFX_ERROR_INIT;
 
+	entry = bitmap_cache_find(bitmap, size, &no_scale);
+	if (entry) {
+		rv = check_boundary(top_left, &entry->dim, &screen);
+		if (rv) {
+			LOG("Bitmap image exceeds screen boundary\n");
+			return rv;
+		}
+
+		bitmap_cache_blit(entry, top_left);
+		return CBGFX_SUCCESS;
+	}
+
 	/* only v3 is supported now */
 	rv = parse_bitmap_header_v3(bitmap, size,
 				    &header, &palette, &pixel_array, &dim);
@@ -625,8 +977,8 @@ int draw_bitmap_direct(const void *bitmap, size_t size,
 		return rv;
 	}
 
-	return draw_bitmap_v3(top_left, &scale, &dim, &dim,
-			      &header, palette, pixel_array);
+	return render_bitmap(bitmap, size, &no_scale, top_left, &scale, &dim,
+			     &dim, &header, palette, pixel_array);
 }
 
 int get_bitmap_dimension(const void *bitmap, size_t sz, struct scale *dim_rel)
@@ -659,3 +1011,73 @@ int get_bitmap_dimension(const void *bitmap, size_t sz, struct scale *dim_rel)
 
 	return CBGFX_SUCCESS;
 }
+
+int enable_graphics_buffer(void)
+{
+	if (cbgfx_init())
+		return CBGFX_ERROR_INIT;
+
+	if (gfx_buffer)
+		return CBGFX_SUCCESS;
+
+	gfx_buffer = malloc(fbinfo->bytes_per_line * screen.size.height);
+	if (!gfx_buffer) {
+		LOG("Failed to allocate graphics buffer\n");
+		return CBGFX_ERROR_NO_MEMORY;
+	}
+
+	/* Start from what's on the screen, nothing to copy back yet. */
+	memcpy(gfx_buffer, fbaddr,
+	       fbinfo->bytes_per_line * screen.size.height);
+	dirty.size = vzero;
+
+	return CBGFX_SUCCESS;
+}
+
+int flush_graphics_buffer(void)
+{
+	const int bpp = fbinfo ? fbinfo->bits_per_pixel : 0;
+	int y;
+
+	if (!gfx_buffer)
+		return CBGFX_SUCCESS;
+
+	if (IS_ENABLED(CONFIG_LP_VIDEO_CONSOLE) && dirty.size.width)
+		video_console_invalidate();
+
+	for (y = dirty.offset.y; y < dirty.offset.y + dirty.size.height; y++) {
+		const size_t offset = y * fbinfo->bytes_per_line +
+				      dirty.offset.x * (bpp / 8);
+		memcpy(fbaddr + offset, gfx_buffer + offset,
+		       dirty.size.width * (bpp / 8));
+	}
+	dirty.size = vzero;
+
+	return CBGFX_SUCCESS;
+}
+
+int disable_graphics_buffer(void)
+{
+	int rv;
+
+	rv = flush_graphics_buffer();
+	free(gfx_buffer);
+	gfx_buffer = NULL;
+
+	return rv;
+}
+
+int set_bitmap_cache_size(size_t size)
+{
+	bitmap_cache_budget = size;
+	while (bitmap_cache_used > bitmap_cache_budget)
+		bitmap_cache_evict();
+
+	return CBGFX_SUCCESS;
+}
+
+void clear_bitmap_cache(void)
+{
+	while (bitmap_cache)
+		bitmap_cache_evict();
+}
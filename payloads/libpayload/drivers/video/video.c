@@ -71,6 +71,16 @@ void video_get_rows_cols(unsigned int *rows, unsigned int *cols)
 	}
 }
 
+/*
+ * Consoles may only update their text buffer when characters are put and
+ * draw the changes on a flush, so every public function ends with one.
+ */
+static void video_console_flush(void)
+{
+	if (console && console->flush)
+		console->flush();
+}
+
 static void video_console_fixup_cursor(void)
 {
 	if (!console)
@@ -100,6 +110,8 @@ void video_console_cursor_enable(int state)
 {
 	if (console && console->enable_cursor)
 		console->enable_cursor(state);
+
+	video_console_flush();
 }
 
 void video_console_clear(void)
@@ -112,15 +124,19 @@ void video_console_clear(void)
 
 	if (console && console->set_cursor)
 		console->set_cursor(cursorx, cursory);
+
+	video_console_flush();
 }
 
 void video_console_putc(u8 row, u8 col, unsigned int ch)
 {
 	if (console)
 		console->putc(row, col, ch);
+
+	video_console_flush();
 }
 
-void video_console_putchar(unsigned int ch)
+static void video_console_put(unsigned int ch)
 {
 	if (!console)
 		return;
@@ -162,6 +178,23 @@ void video_console_putchar(unsigned int ch)
 	video_console_fixup_cursor();
 }
 
+void video_console_putchar(unsigned int ch)
+{
+	video_console_put(ch);
+	video_console_flush();
+}
+
+/* Draw all of the output at once instead of character by character. */
+static void video_console_write(const void *buffer, size_t count)
+{
+	const unsigned char *ptr;
+
+	for (ptr = buffer; (void *)ptr < buffer + count; ptr++)
+		video_console_put(*ptr);
+
+	video_console_flush();
+}
+
 void video_printf(int foreground, int background, enum video_printf_align align,
 		  const char *fmt, ...)
 {
@@ -204,7 +237,9 @@ void video_printf(int foreground, int background, enum video_printf_align align,
 	background <<= 12;
 
 	while (str[i])
-		video_console_putchar(str[i++] | foreground | background);
+		video_console_put(str[i++] | foreground | background);
+
+	video_console_flush();
 }
 
 void video_console_get_cursor(unsigned int *x, unsigned int *y, unsigned int *en)
@@ -225,10 +260,19 @@ void video_console_set_cursor(unsigned int x, unsigned int y)
 	cursorx = x;
 	cursory = y;
 	video_console_fixup_cursor();
+	video_console_flush();
+}
+
+/* Tell the console that something else drew to the screen. */
+void video_console_invalidate(void)
+{
+	if (console && console->invalidate)
+		console->invalidate();
 }
 
 static struct console_output_driver cons = {
-	.putchar = video_console_putchar
+	.putchar = video_console_putchar,
+	.write = video_console_write,
 };
 
 int video_init(void)
@@ -253,6 +297,7 @@ int video_init(void)
 		}
 
 		video_console_fixup_cursor();
+		video_console_flush();
 		return 0;
 	}
 	return 1;
@@ -57,6 +57,8 @@
 #define CBGFX_ERROR_FRAMEBUFFER_ADDR	0x15
 /* portrait screen not supported */
 #define CBGFX_ERROR_PORTRAIT_SCREEN	0x16
+/* out of memory */
+#define CBGFX_ERROR_NO_MEMORY		0x17
 
 struct fraction {
 	int32_t n;
@@ -184,3 +186,52 @@ int draw_bitmap_direct(const void *bitmap, size_t size,
  * in the original size are returned.
  */
 int get_bitmap_dimension(const void *bitmap, size_t sz, struct scale *dim_rel);
+
+/**
+ * Draw into a back buffer instead of the framebuffer
+ *
+ * Until disable_graphics_buffer() is called, drawing functions only update a
+ * copy of the screen in memory. This is much faster for framebuffers which
+ * are mapped uncached.
+ *
+ * @return CBGFX_* error codes
+ */
+int enable_graphics_buffer(void);
+
+/**
+ * Copy everything drawn into the back buffer since the last flush to the
+ * framebuffer. Does nothing if the back buffer is disabled.
+ *
+ * @return CBGFX_* error codes
+ */
+int flush_graphics_buffer(void);
+
+/**
+ * Flush and free the back buffer, and draw to the framebuffer directly again
+ *
+ * @return CBGFX_* error codes
+ */
+int disable_graphics_buffer(void);
+
+/**
+ * Set the memory budget of the bitmap cache
+ *
+ * Bitmaps drawn while the cache is enabled are kept in the framebuffer format
+ * at the size they were drawn. Drawing them at that size again is a plain
+ * copy. The least recently used bitmaps are dropped to stay within size.
+ *
+ * Bitmaps are identified by the address and size of their data, which must
+ * not change while they are cached. Call clear_bitmap_cache() before freeing
+ * or reusing bitmap data.
+ *
+ * @param[in] size	Memory budget in bytes. 0 disables the cache, which is
+ *			the default.
+ *
+ * @return CBGFX_* error codes
+ */
+int set_bitmap_cache_size(size_t size);
+
+/**
+ * Drop all bitmaps from the bitmap cache
+ */
+void clear_bitmap_cache(void);
@@ -218,6 +218,7 @@ struct lb_range {
 #define CB_TAG_MRC_CACHE	0x0018
 #define CB_TAG_ACPI_GNVS	0x0024
 #define CB_TAG_WIFI_CALIBRATION	0x0027
+#define CB_TAG_TCPA_LOG		0x0033
 struct cb_cbmem_tab {
 	uint32_t tag;
 	uint32_t size;
@@ -45,6 +45,7 @@ typedef enum {
 	PORT_TYPE_IDE	= (1 << 0),
 	PORT_TYPE_SATA	= (1 << 1),
 	PORT_TYPE_USB	= (1 << 2),
+	PORT_TYPE_NVME	= (1 << 3),
 } storage_port_t;
 
 typedef enum {
@@ -65,6 +66,16 @@ typedef struct storage_dev {
 	ssize_t (*read_blocks512)(struct storage_dev *, lba_t start, size_t count, unsigned char *buf);
 	ssize_t (*write_blocks512)(struct storage_dev *, lba_t start, size_t count, const unsigned char *buf);
 
+	/*
+	 * Optional queued reads: submit_read512() queues a read of the whole
+	 * range and returns a tag >= 0, or -1 if it can't be queued right now.
+	 * reap_read512() waits for the read with that tag to finish and
+	 * returns the number of blocks read. Queued reads complete in any
+	 * order, but every tag has to be reaped.
+	 */
+	int (*submit_read512)(struct storage_dev *, lba_t start, size_t count, unsigned char *buf);
+	ssize_t (*reap_read512)(struct storage_dev *, int tag);
+
 	void (*detach_device)(struct storage_dev *);
 } storage_dev_t;
 
@@ -74,5 +85,6 @@ int storage_attach_device(storage_dev_t *dev);
 
 storage_poll_t storage_probe(size_t dev_num);
 ssize_t storage_read_blocks512(size_t dev_num, lba_t start, size_t count, unsigned char *buf);
+ssize_t storage_read_blocks512_queued(size_t dev_num, lba_t start, size_t count, unsigned char *buf);
 
 #endif
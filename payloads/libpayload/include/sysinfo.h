@@ -111,6 +111,8 @@ struct sysinfo_t {
 	u32		board_id;
 	u32		ram_code;
 	void		*wifi_calibration;
+	/* TCG PC Client event log, zeroed past the last event. */
+	void		*tcpa_log;
 	uint64_t	ramoops_buffer;
 	uint32_t	ramoops_buffer_size;
 	struct {
@@ -46,6 +46,7 @@ enum {
 	DT_STR = 3,
 	DT_INTF = 4,
 	DT_ENDP = 5,
+	DT_SS_ENDP_COMP = 0x30,
 };
 
 typedef enum {
@@ -184,6 +185,7 @@ typedef struct {
 	endpoint_type type;
 	int interval; /* expressed as binary logarithm of the number
 			 of microframes (i.e. t = 125us * 2^interval) */
+	int max_streams; /* highest bulk stream ID usable, 0 if none */
 } endpoint_t;
 
 typedef enum {
@@ -205,6 +207,12 @@ struct usbdev {
 	void (*init) (usbdev_t *dev);
 	void (*destroy) (usbdev_t *dev);
 	void (*poll) (usbdev_t *dev);
+	/* Polling schedule, see usb_poll(). poll_interval is the time
+	   between polls in microseconds, 0 to poll on every usb_poll().
+	   Controllers set poll_pending to poll the device right away. */
+	unsigned int poll_interval;
+	u64 next_poll;
+	int poll_pending;
 };
 
 typedef enum { OHCI = 0, UHCI = 1, EHCI = 2, XHCI = 3, DWC2 = 4} hc_type;
@@ -238,6 +246,31 @@ struct usbdev_hc {
 	void* (*create_intr_queue) (endpoint_t *ep, int reqsize, int reqcount, int reqtiming);
 	void (*destroy_intr_queue) (endpoint_t *ep, void *queue);
 	u8* (*poll_intr_queue) (void *queue);
+	/* bulk_submit():		Optional, queue a bulk transfer and
+					return without waiting for it. `data`
+					has to be DMA coherent and stay valid
+					until the transfer is reaped. `stream`
+					is 0 unless the endpoint has streams.
+					Returns 0 on success, < 0 if it can't
+					be queued (e.g. the queue is full). */
+	int (*bulk_submit) (endpoint_t *ep, int stream, int size, u8 *data);
+	/* bulk_reap():			Wait for the oldest transfer queued on
+					`ep` and `stream`. Returns the number
+					of bytes transferred, < 0 on error.
+					Transfers queued after a failed one
+					won't complete and have to be reaped as
+					well. */
+	int (*bulk_reap) (endpoint_t *ep, int stream);
+	/* max_streams:			Highest bulk stream ID bulk_submit()
+					takes, 0 if the controller doesn't
+					support streams. */
+	int max_streams;
+	/* handle_events():		Optional, process completions and
+					port changes reported by the
+					controller and set `poll_pending` of
+					the devices concerned. Called by
+					usb_poll() before polling devices. */
+	void (*handle_events) (hci_t *controller);
 	void *instance;
 
 	/* set_address():		Tell the usb device its address (xHCI
@@ -256,12 +289,25 @@ struct usbdev_hc {
 	void (*destroy_device) (hci_t *controller, int devaddr);
 };
 
+extern hci_t *usb_hcs;
+
 hci_t *usb_add_mmio_hc(hc_type type, void *bar);
 hci_t *new_controller (void);
 void detach_controller (hci_t *controller);
 void usb_poll (void);
 usbdev_t *init_device_entry (hci_t *controller, int num);
 
+/* Polling intervals in microseconds, see usbdev_t */
+#define USB_ROOT_HUB_POLL_INTERVAL	(32 * 1000)
+/* For devices that are also polled on controller events */
+#define USB_EVENT_POLL_INTERVAL		(100 * 1000)
+
+/* Time between two transactions of a periodic endpoint in microseconds */
+static inline unsigned int usb_endpoint_interval_us(const endpoint_t *ep)
+{
+	return 125 << ep->interval;
+}
+
 int usb_decode_mps0 (usb_speed speed, u8 bMaxPacketSize0);
 int speed_to_default_mps(usb_speed speed);
 int set_feature (usbdev_t *dev, int endp, int feature, int rtype);
@@ -269,6 +315,8 @@ int get_status (usbdev_t *dev, int endp, int rtype, int len, void *data);
 int get_descriptor (usbdev_t *dev, int rtype, int descType, int descIdx,
 		    void *data, size_t len);
 int set_configuration (usbdev_t *dev);
+int set_interface (usbdev_t *dev, int intf, int alt);
+int usb_configure_interface (usbdev_t *dev, interface_descriptor_t *intf);
 int clear_feature (usbdev_t *dev, int endp, int feature, int rtype);
 int clear_stall (endpoint_t *ep);
 
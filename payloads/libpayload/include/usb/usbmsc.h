@@ -31,13 +31,18 @@
 #define __USBMSC_H
 typedef struct {
 	unsigned int blocksize;
-	unsigned int numblocks;
+	u64 numblocks;
 	endpoint_t *bulk_in;
 	endpoint_t *bulk_out;
 	u8 usbdisk_created;
 	s8 ready;
 	u8 lun;
 	u8 num_luns;
+	/* USB Attached SCSI, unused with Bulk-Only Transport */
+	endpoint_t *uas_command;
+	endpoint_t *uas_status;
+	u8 uas_tags;
+	void *uas_iu;
 	void *data; /* For use by consumers of libpayload. */
 } usbmsc_inst_t;
 
@@ -53,7 +58,7 @@ enum {
 typedef enum { cbw_direction_data_in = 0x80, cbw_direction_data_out = 0
 } cbw_direction;
 
-int readwrite_blocks_512 (usbdev_t *dev, int start, int n, cbw_direction dir, u8 *buf);
-int readwrite_blocks (usbdev_t *dev, int start, int n, cbw_direction dir, u8 *buf);
+int readwrite_blocks_512 (usbdev_t *dev, u64 start, int n, cbw_direction dir, u8 *buf);
+int readwrite_blocks (usbdev_t *dev, u64 start, int n, cbw_direction dir, u8 *buf);
 
 #endif
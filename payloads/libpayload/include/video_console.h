@@ -35,6 +35,10 @@ struct video_console {
 	void (*putc)(u8, u8, unsigned int);
 	void (*clear)(void);
 	void (*scroll_up)(void);
+	/* Optional, makes the output so far visible */
+	void (*flush)(void);
+	/* Optional, others drew to the screen */
+	void (*invalidate)(void);
 
 	void (*get_cursor)(unsigned int *, unsigned int *, unsigned int *);
 	void (*set_cursor)(unsigned int, unsigned int);
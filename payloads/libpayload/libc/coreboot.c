@@ -192,6 +192,12 @@ static void cb_parse_wifi_calibration(void *ptr, struct sysinfo_t *info)
 	info->wifi_calibration = phys_to_virt(cbmem->cbmem_tab);
 }
 
+static void cb_parse_tcpa_log(void *ptr, struct sysinfo_t *info)
+{
+	struct cb_cbmem_tab *const cbmem = (struct cb_cbmem_tab *)ptr;
+	info->tcpa_log = phys_to_virt(cbmem->cbmem_tab);
+}
+
 static void cb_parse_ramoops(void *ptr, struct sysinfo_t *info)
 {
 	struct lb_range *ramoops = (struct lb_range *)ptr;
@@ -381,6 +387,9 @@ int cb_parse_header(void *addr, int len, struct sysinfo_t *info)
 		case CB_TAG_WIFI_CALIBRATION:
 			cb_parse_wifi_calibration(ptr, info);
 			break;
+		case CB_TAG_TCPA_LOG:
+			cb_parse_tcpa_log(ptr, info);
+			break;
 		case CB_TAG_RAM_OOPS:
 			cb_parse_ramoops(ptr, info);
 			break;
@@ -29,12 +29,18 @@
  */
 
 /*
- * This is a classically weak malloc() implementation. We have a relatively
- * small and static heap, so we take the easy route with an O(N) loop
- * through the tree for every malloc() and free(). Obviously, this doesn't
- * scale past a few hundred KB (if that).
+ * A small segregated fit allocator. Every block has a header with its size
+ * and flags; free blocks also repeat the header at their end (a boundary
+ * tag), so both neighbours of a block can be found in O(1) and adjacent
+ * free blocks are always merged right away.
  *
- * We're also susceptible to the usual buffer overrun poisoning, though the
+ * Free blocks are kept in doubly linked lists by size class: one class per
+ * 8 bytes below 256 bytes and four classes per power of two above. A
+ * request is rounded up to the next class boundary, then any block of the
+ * first non-empty class at or above it fits, which a bitmap finds without
+ * walking the heap.
+ *
+ * We're still susceptible to the usual buffer overrun poisoning, though the
  * risk is within acceptable ranges for this implementation (don't overrun
  * your buffers, kids!).
  */
@@ -43,10 +49,21 @@
 #include <libpayload.h>
 #include <stdint.h>
 
+#define SMALL_BINS	32		/* 8 byte classes below SMALL_LIMIT */
+#define SMALL_FL	8
+#define SMALL_LIMIT	(1 << SMALL_FL)
+#define SL_BITS		2		/* 4 classes per power of two */
+#define SL_COUNT	(1 << SL_BITS)
+#define FL_MAX		31
+#define NUM_BINS	(SMALL_BINS + (FL_MAX - SMALL_FL + 1) * SL_COUNT)
+
+struct free_block;
+
 struct memory_type {
 	void *start;
 	void *end;
-	struct align_region_t* align_regions;
+	struct free_block *bins[NUM_BINS];
+	u32 bin_map[NUM_BINS / 32];
 #if IS_ENABLED(CONFIG_LP_DEBUG_MALLOC)
 	int magic_initialized;
 	size_t minimal_free;
@@ -56,21 +73,23 @@ struct memory_type {
 
 extern char _heap, _eheap;	/* Defined in the ldscript. */
 
-static struct memory_type default_type =
-	{ (void *)&_heap, (void *)&_eheap, NULL
+static struct memory_type default_type = {
+	.start = (void *)&_heap,
+	.end = (void *)&_eheap,
 #if IS_ENABLED(CONFIG_LP_DEBUG_MALLOC)
-	, 0, 0, "HEAP"
+	.name = "HEAP",
 #endif
-	};
+};
 static struct memory_type *const heap = &default_type;
 static struct memory_type *dma = &default_type;
 
 typedef u64 hdrtype_t;
 #define HDRSIZE (sizeof(hdrtype_t))
 
-#define SIZE_BITS ((HDRSIZE << 3) - 7)
-#define MAGIC     (((hdrtype_t)0x2a) << (SIZE_BITS + 1))
-#define FLAG_FREE (((hdrtype_t)0x01) << (SIZE_BITS + 0))
+#define SIZE_BITS ((HDRSIZE << 3) - 8)
+#define MAGIC     (((hdrtype_t)0x2a) << (SIZE_BITS + 2))
+#define FLAG_FREE (((hdrtype_t)0x01) << (SIZE_BITS + 1))
+#define FLAG_PREV_FREE (((hdrtype_t)0x01) << (SIZE_BITS + 0))
 #define MAX_SIZE  ((((hdrtype_t)0x01) << SIZE_BITS) - 1)
 
 #define SIZE(_h) ((_h) & MAX_SIZE)
@@ -83,7 +102,18 @@ typedef u64 hdrtype_t;
 #define IS_FREE(_h) (((_h) & (MAGIC | FLAG_FREE)) == (MAGIC | FLAG_FREE))
 #define HAS_MAGIC(_h) (((_h) & MAGIC) == MAGIC)
 
-static int free_aligned(void* addr, struct memory_type *type);
+struct free_block {
+	hdrtype_t hdr;
+	struct free_block *next;
+	struct free_block *prev;
+	/* ... and a copy of hdr in the last HDRSIZE bytes */
+};
+
+/* Smallest block, it has to hold the list links and the boundary tag. */
+#define MIN_DATA ALIGN_UP(2 * sizeof(void *) + HDRSIZE, HDRSIZE)
+/* Largest allocation, keeps the rounded up size class below FL_MAX. */
+#define MAX_ALLOC ((size_t)1 << (FL_MAX - 1))
+
 void print_malloc_map(void);
 
 void init_dma_memory(void *start, u32 size)
@@ -102,7 +132,6 @@ void init_dma_memory(void *start, u32 size)
 	dma = malloc(sizeof(*dma));
 	dma->start = start;
 	dma->end = start + size;
-	dma->align_regions = NULL;
 
 #if IS_ENABLED(CONFIG_LP_DEBUG_MALLOC)
 	dma->minimal_free = 0;
@@ -124,134 +153,238 @@ int dma_coherent(void *ptr)
 	return !dma_initialized() || (dma->start <= ptr && dma->end > ptr);
 }
 
-static void *alloc(int len, struct memory_type *type)
+static void panic(const char *const what)
 {
-	hdrtype_t header;
-	hdrtype_t volatile *ptr = (hdrtype_t volatile *)type->start;
+	printf("memory allocator panic. (%s)\n", what);
+	halt();
+}
 
-	/* Align the size. */
-	len = ALIGN_UP(len, HDRSIZE);
+static inline hdrtype_t *next_block(hdrtype_t *const h)
+{
+	return (void *)h + HDRSIZE + SIZE(*h);
+}
 
-	if (!len || len > MAX_SIZE)
-		return (void *)NULL;
+static inline hdrtype_t *prev_block(hdrtype_t *const h)
+{
+	const hdrtype_t *const tag = (void *)h - HDRSIZE;
+	return (void *)tag - SIZE(*tag);
+}
 
-	/* Make sure the region is setup correctly. */
-	if (!HAS_MAGIC(*ptr)) {
-		size_t size = (type->end - type->start) - HDRSIZE;
-		*ptr = FREE_BLOCK(size);
-#if IS_ENABLED(CONFIG_LP_DEBUG_MALLOC)
-		type->magic_initialized = 1;
-		type->minimal_free = size;
-#endif
-	}
+static inline void set_tag(hdrtype_t *const h)
+{
+	*(hdrtype_t *)((void *)h + SIZE(*h)) = *h;
+}
 
-	/* Find some free space. */
-	do {
-		header = *ptr;
-		int size = SIZE(header);
+/* The last HDRSIZE bytes of a heap are a used block of size 0. */
+static inline hdrtype_t *heap_fence(const struct memory_type *const type)
+{
+	return (hdrtype_t *)(ALIGN_DOWN((uintptr_t)type->end, HDRSIZE)
+			     - HDRSIZE);
+}
 
-		if (!HAS_MAGIC(header) || size == 0) {
-			printf("memory allocator panic. (%s%s)\n",
-			       !HAS_MAGIC(header) ? " no magic " : "",
-				   size == 0 ? " size=0 " : "");
-			halt();
-		}
+static inline int fls(const size_t x)
+{
+	return (sizeof(unsigned long) << 3) - 1 - __builtin_clzl(x);
+}
 
-		if (header & FLAG_FREE) {
-			if (len <= size) {
-				hdrtype_t volatile *nptr = (hdrtype_t volatile *)((uintptr_t)ptr + HDRSIZE + len);
-				int nsize = size - (HDRSIZE + len);
-
-				/* If there is still room in this block,
-				 * then mark it as such otherwise account
-				 * the whole space for that block.
-				 */
-
-				if (nsize > 0) {
-					/* Mark the block as used. */
-					*ptr = USED_BLOCK(len);
-
-					/* Create a new free block. */
-					*nptr = FREE_BLOCK(nsize);
-				} else {
-					/* Mark the block as used. */
-					*ptr = USED_BLOCK(size);
-				}
-
-				return (void *)((uintptr_t)ptr + HDRSIZE);
-			}
-		}
+/* Size class of a free block of the given size. */
+static int bin_index(const size_t size)
+{
+	if (size < SMALL_LIMIT)
+		return size >> 3;
 
-		ptr = (hdrtype_t volatile *)((uintptr_t)ptr + HDRSIZE + size);
+	const int fl = fls(size);
+	if (fl > FL_MAX)
+		return NUM_BINS - 1;
 
-	} while (ptr < (hdrtype_t *) type->end);
+	const int sl = (size >> (fl - SL_BITS)) & (SL_COUNT - 1);
+	return SMALL_BINS + (fl - SMALL_FL) * SL_COUNT + sl;
+}
 
-	/* Nothing available. */
-	return (void *)NULL;
+/* First size class whose blocks are all at least size bytes. */
+static int bin_index_fit(size_t size)
+{
+	if (size >= SMALL_LIMIT)
+		size += ((size_t)1 << (fls(size) - SL_BITS)) - 1;
+	return bin_index(size);
 }
 
-static void _consolidate(struct memory_type *type)
+/* First non-empty size class at or above idx, or -1. */
+static int bin_find(const struct memory_type *const type, const int idx)
 {
-	void *ptr = type->start;
+	int word = idx >> 5;
+	u32 bits = type->bin_map[word] & (~0U << (idx & 31));
 
-	while (ptr < type->end) {
-		void *nptr;
-		hdrtype_t hdr = *((hdrtype_t *) ptr);
-		unsigned int size = 0;
+	while (!bits) {
+		if (++word == ARRAY_SIZE(type->bin_map))
+			return -1;
+		bits = type->bin_map[word];
+	}
+	return (word << 5) + __builtin_ctz(bits);
+}
 
-		if (!IS_FREE(hdr)) {
-			ptr += HDRSIZE + SIZE(hdr);
-			continue;
-		}
+static void bin_insert(struct memory_type *const type, hdrtype_t *const h)
+{
+	struct free_block *const b = (struct free_block *)h;
+	const int idx = bin_index(SIZE(*h));
+
+	b->prev = NULL;
+	b->next = type->bins[idx];
+	if (b->next)
+		b->next->prev = b;
+	type->bins[idx] = b;
+	type->bin_map[idx >> 5] |= 1U << (idx & 31);
+}
 
-		size = SIZE(hdr);
-		nptr = ptr + HDRSIZE + SIZE(hdr);
+static void bin_remove(struct memory_type *const type, hdrtype_t *const h)
+{
+	struct free_block *const b = (struct free_block *)h;
+	const int idx = bin_index(SIZE(*h));
+
+	if (b->prev)
+		b->prev->next = b->next;
+	else
+		type->bins[idx] = b->next;
+	if (b->next)
+		b->next->prev = b->prev;
+	if (!type->bins[idx])
+		type->bin_map[idx >> 5] &= ~(1U << (idx & 31));
+}
 
-		while (nptr < type->end) {
-			hdrtype_t nhdr = *((hdrtype_t *) nptr);
+static void heap_init(struct memory_type *const type)
+{
+	hdrtype_t *const first = type->start;
+	hdrtype_t *const fence = heap_fence(type);
+	const size_t size = (void *)fence - type->start - HDRSIZE;
 
-			if (!(IS_FREE(nhdr)))
-				break;
+	memset(type->bins, 0, sizeof(type->bins));
+	memset(type->bin_map, 0, sizeof(type->bin_map));
 
-			size += SIZE(nhdr) + HDRSIZE;
+	*first = FREE_BLOCK(size);
+	set_tag(first);
+	*fence = USED_BLOCK(0) | FLAG_PREV_FREE;
+	bin_insert(type, first);
 
-			*((hdrtype_t *) nptr) = 0;
+#if IS_ENABLED(CONFIG_LP_DEBUG_MALLOC)
+	type->magic_initialized = 1;
+	type->minimal_free = size;
+#endif
+}
 
-			nptr += (HDRSIZE + SIZE(nhdr));
-		}
+/* Turn a used block into a free one, merging it with free neighbours. */
+static void release(struct memory_type *const type, hdrtype_t *h)
+{
+	size_t size = SIZE(*h);
+	hdrtype_t *next = next_block(h);
 
-		*((hdrtype_t *) ptr) = FREE_BLOCK(size);
-		ptr = nptr;
+	if (!HAS_MAGIC(*next))
+		panic("no magic");
+
+	if (IS_FREE(*next)) {
+		bin_remove(type, next);
+		size += HDRSIZE + SIZE(*next);
+	}
+	if (*h & FLAG_PREV_FREE) {
+		h = prev_block(h);
+		if (!IS_FREE(*h))
+			panic("bad boundary tag");
+		bin_remove(type, h);
+		size += HDRSIZE + SIZE(*h);
 	}
+
+	*h = FREE_BLOCK(size);
+	set_tag(h);
+	next = next_block(h);
+	*next |= FLAG_PREV_FREE;
+	bin_insert(type, h);
 }
 
-void free(void *ptr)
+/* Give back everything of a used block beyond len bytes. */
+static void shrink(struct memory_type *const type, hdrtype_t *const h,
+		   const size_t len)
 {
-	hdrtype_t hdr;
-	struct memory_type *type = heap;
+	const size_t size = SIZE(*h);
 
-	/* Sanity check. */
-	if (ptr < type->start || ptr >= type->end) {
-		type = dma;
-		if (ptr < type->start || ptr >= type->end)
-			return;
+	if (size < len + HDRSIZE + MIN_DATA)
+		return;
+
+	*h = USED_BLOCK(len) | (*h & FLAG_PREV_FREE);
+	hdrtype_t *const rest = next_block(h);
+	*rest = USED_BLOCK(size - len - HDRSIZE);
+	release(type, rest);
+}
+
+static inline size_t block_size(const size_t len)
+{
+	return MAX(ALIGN_UP(len, HDRSIZE), MIN_DATA);
+}
+
+static void *alloc(size_t len, struct memory_type *type)
+{
+	hdrtype_t *h;
+	int idx;
+
+	if (!len || len > MAX_ALLOC)
+		return (void *)NULL;
+
+	len = block_size(len);
+
+	/* Make sure the region is setup correctly. */
+	if (!HAS_MAGIC(*(hdrtype_t *)type->start))
+		heap_init(type);
+
+	idx = bin_find(type, bin_index_fit(len));
+	if (idx >= 0) {
+		h = &type->bins[idx]->hdr;
+	} else {
+		/* Blocks in len's own class might still be large enough. */
+		struct free_block *b = type->bins[bin_index(len)];
+
+		while (b && SIZE(b->hdr) < len)
+			b = b->next;
+		if (!b)
+			return (void *)NULL;	/* Nothing available. */
+		h = &b->hdr;
 	}
 
-	if (free_aligned(ptr, type)) return;
+	if (!IS_FREE(*h))
+		panic("used block in free list");
+	bin_remove(type, h);
+
+	*h = USED_BLOCK(SIZE(*h));
+	*next_block(h) &= ~FLAG_PREV_FREE;
+	shrink(type, h, len);
 
-	ptr -= HDRSIZE;
-	hdr = *((hdrtype_t *) ptr);
+	return (void *)h + HDRSIZE;
+}
+
+static struct memory_type *type_of(void *const ptr)
+{
+	if (ptr >= heap->start && ptr < heap->end)
+		return heap;
+	if (ptr >= dma->start && ptr < dma->end)
+		return dma;
+	return NULL;
+}
+
+void free(void *ptr)
+{
+	struct memory_type *const type = type_of(ptr);
+	hdrtype_t *const h = ptr - HDRSIZE;
+
+	/* Sanity check. */
+	if (!type)
+		return;
 
 	/* Not our header (we're probably poisoned). */
-	if (!HAS_MAGIC(hdr))
+	if (!HAS_MAGIC(*h))
 		return;
 
 	/* Double free. */
-	if (hdr & FLAG_FREE)
+	if (*h & FLAG_FREE)
 		return;
 
-	*((hdrtype_t *) ptr) = FREE_BLOCK(SIZE(hdr));
-	_consolidate(type);
+	release(type, h);
 }
 
 void *malloc(size_t size)
@@ -267,8 +400,12 @@ void *dma_malloc(size_t size)
 void *calloc(size_t nmemb, size_t size)
 {
 	size_t total = nmemb * size;
-	void *ptr = alloc(total, heap);
+	void *ptr;
 
+	if (size && total / size != nmemb)
+		return NULL;
+
+	ptr = alloc(total, heap);
 	if (ptr)
 		memset(ptr, 0, total);
 
@@ -277,255 +414,80 @@ void *calloc(size_t nmemb, size_t size)
 
 void *realloc(void *ptr, size_t size)
 {
-	void *ret, *pptr;
-	unsigned int osize;
-	struct memory_type *type = heap;
+	struct memory_type *type;
+	hdrtype_t *h, *next;
+	void *ret;
 
 	if (ptr == NULL)
-		return alloc(size, type);
+		return alloc(size, heap);
 
-	pptr = ptr - HDRSIZE;
-
-	if (!HAS_MAGIC(*((hdrtype_t *) pptr)))
+	type = type_of(ptr);
+	h = ptr - HDRSIZE;
+	if (!type || !HAS_MAGIC(*h) || (*h & FLAG_FREE))
 		return NULL;
 
-	if (ptr < type->start || ptr >= type->end)
-		type = dma;
-
-	/* Get the original size of the block. */
-	osize = SIZE(*((hdrtype_t *) pptr));
-
-	/*
-	 * Free the memory to update the tables - this won't touch the actual
-	 * memory, so we can still use it for the copy after we have
-	 * reallocated the new space.
-	 */
-	free(ptr);
-	ret = alloc(size, type);
-
-	/*
-	 * if ret == NULL, then doh - failure.
-	 * if ret == ptr then woo-hoo! no copy needed.
-	 */
-	if (ret == NULL || ret == ptr)
-		return ret;
-
-	/* Copy the memory to the new location. */
-	memcpy(ret, ptr, osize > size ? size : osize);
-
-	return ret;
-}
-
-struct align_region_t
-{
-	/* If alignment is 0 then the region reqpresents a large region which
-	 * has no metadata for tracking subelements. */
-	int alignment;
-	/* start in memory, and size in bytes */
-	void* start;
-	int size;
-	/* layout within a region:
-	  - num_elements bytes, 0: free, 1: used, 2: used, combines with next
-	  - padding to alignment
-	  - data section
-	  - waste space
-
-	  start_data points to the start of the data section
-	*/
-	void* start_data;
-	/* number of free blocks sized "alignment" */
-	int free;
-	struct align_region_t *next;
-};
-
-static inline int region_is_large(const struct align_region_t *r)
-{
-	return r->alignment == 0;
-}
-
-static inline int addr_in_region(const struct align_region_t *r, void *addr)
-{
-	return ((addr >= r->start_data) && (addr < r->start_data + r->size));
-}
-
-/* num_elements == 0 indicates a large aligned region instead of a smaller
- * region comprised of alignment-sized chunks. */
-static struct align_region_t *allocate_region(int alignment, int num_elements,
-					size_t size, struct memory_type *type)
-{
-	struct align_region_t *r;
-	size_t extra_space;
-
-#if IS_ENABLED(CONFIG_LP_DEBUG_MALLOC)
-	printf("%s(old align_regions=%p, alignment=%u, num_elements=%u, size=%zu)\n",
-		__func__, type->align_regions, alignment, num_elements, size);
-#endif
-
-	r = malloc(sizeof(*r));
-
-	if (r == NULL)
+	if (!size || size > MAX_ALLOC) {
+		if (!size)
+			free(ptr);
 		return NULL;
-
-	memset(r, 0, sizeof(*r));
-
-	if (num_elements != 0) {
-		r->alignment = alignment;
-		r->size = num_elements * alignment;
-		r->free = num_elements;
-		/* Allocate enough memory for alignment requirements and
-		 * metadata for each chunk. */
-		extra_space = num_elements;
-	} else {
-		/* Large aligned allocation. Set alignment = 0. */
-		r->alignment = 0;
-		r->size = size;
-		extra_space = 0;
 	}
 
-	r->start = alloc(r->size + alignment + extra_space, type);
+	const size_t len = block_size(size);
 
-	if (r->start == NULL) {
-		free(r);
-		return NULL;
+	/* Shrink in place or grow into a free neighbour. */
+	next = next_block(h);
+	if (SIZE(*h) < len && IS_FREE(*next) &&
+			SIZE(*h) + HDRSIZE + SIZE(*next) >= len) {
+		bin_remove(type, next);
+		*h = USED_BLOCK(SIZE(*h) + HDRSIZE + SIZE(*next)) |
+			(*h & FLAG_PREV_FREE);
+		*next_block(h) &= ~FLAG_PREV_FREE;
 	}
-
-	r->start_data = (void *)ALIGN_UP((uintptr_t)r->start + extra_space,
-					alignment);
-
-	/* Clear any (if requested) metadata. */
-	memset(r->start, 0, extra_space);
-
-	/* Link the region with the rest. */
-	r->next = type->align_regions;
-	type->align_regions = r;
-
-	return r;
-}
-
-static void try_free_region(struct align_region_t **prev_link)
-{
-	struct align_region_t *r = *prev_link;
-
-	/* All large regions are immediately free-able. Non-large regions
-	 * need to be checked for the fully freed state. */
-	if (!region_is_large(r)) {
-		if (r->free != r->size / r->alignment)
-			return;
+	if (SIZE(*h) >= len) {
+		shrink(type, h, len);
+		return ptr;
 	}
 
-	/* Unlink region from link list. */
-	*prev_link = r->next;
-
-	/* Free the data and metadata. */
-	free(r->start);
-	free(r);
-}
-
-static int free_aligned(void* addr, struct memory_type *type)
-{
-	struct align_region_t **prev_link = &type->align_regions;
-
-	while (*prev_link != NULL)
-	{
-		if (!addr_in_region(*prev_link, addr)) {
-			prev_link = &((*prev_link)->next);
-			continue;
-		}
+	ret = alloc(size, type);
+	if (ret == NULL)
+		return NULL;
 
-		if (region_is_large(*prev_link)) {
-			try_free_region(prev_link);
-			return 1;
-		}
+	memcpy(ret, ptr, SIZE(*h));
+	release(type, h);
 
-		int i = (addr-(*prev_link)->start_data)/(*prev_link)->alignment;
-		u8 *meta = (*prev_link)->start;
-		while (meta[i] == 2)
-		{
-			meta[i++] = 0;
-			(*prev_link)->free++;
-		}
-		meta[i] = 0;
-		(*prev_link)->free++;
-		try_free_region(prev_link);
-		return 1;
-	}
-	return 0;
+	return ret;
 }
 
 static void *alloc_aligned(size_t align, size_t size, struct memory_type *type)
 {
-	/* Define a large request to be 1024 bytes for either alignment or
-	 * size of allocation. */
-	const size_t large_request = 1024;
+	hdrtype_t *h, *ah;
+	void *ptr, *aligned;
 
 	if (size == 0) return 0;
-	if (type->align_regions == 0) {
-		type->align_regions = malloc(sizeof(struct align_region_t));
-		if (type->align_regions == NULL)
-			return NULL;
-		memset(type->align_regions, 0, sizeof(struct align_region_t));
-	}
-	struct align_region_t *reg = type->align_regions;
+	if (align <= HDRSIZE)
+		return alloc(size, type);
 
-	if (size >= large_request || align >= large_request) {
-		reg = allocate_region(align, 0, size, type);
-		if (reg == NULL)
-			return NULL;
-		return reg->start_data;
-	}
+	size = block_size(size);
 
-look_further:
-	while (reg != 0)
-	{
-		if ((reg->alignment == align) && (reg->free >= (size + align - 1)/align))
-		{
-#if IS_ENABLED(CONFIG_LP_DEBUG_MALLOC)
-			printf("  found memalign region. %x free, %x required\n", reg->free, (size + align - 1)/align);
-#endif
-			break;
-		}
-		reg = reg->next;
-	}
-	if (reg == 0)
-	{
-#if IS_ENABLED(CONFIG_LP_DEBUG_MALLOC)
-		printf("  need to allocate a new memalign region\n");
-#endif
-		/* get align regions */
-		reg = allocate_region(align, large_request/align, size, type);
-#if IS_ENABLED(CONFIG_LP_DEBUG_MALLOC)
-		printf("  ... returned %p\n", reg);
-#endif
-	}
-	if (reg == 0) {
-		/* Nothing available. */
-		return (void *)NULL;
-	}
+	/* Leave room to split off a free block in front of the aligned one. */
+	ptr = alloc(size + align + HDRSIZE + MIN_DATA, type);
+	if (ptr == NULL)
+		return NULL;
+	h = ptr - HDRSIZE;
 
-	int i, count = 0, target = (size+align-1)/align;
-	for (i = 0; i < (reg->size/align); i++)
-	{
-		if (((u8*)reg->start)[i] == 0)
-		{
-			count++;
-			if (count == target) {
-				count = i+1-count;
-				for (i=0; i<target-1; i++)
-				{
-					((u8*)reg->start)[count+i]=2;
-				}
-				((u8*)reg->start)[count+target-1]=1;
-				reg->free -= target;
-				return reg->start_data+(align*count);
-			}
-		} else {
-			count = 0;
-		}
+	if (ALIGN_UP((uintptr_t)ptr, align) == (uintptr_t)ptr) {
+		shrink(type, h, size);
+		return ptr;
 	}
-	/* The free space in this region is fragmented,
-	   so we will move on and try the next one: */
-	reg = reg->next;
-	goto look_further; // end condition is once a new region is allocated - it always has enough space
+
+	aligned = (void *)ALIGN_UP((uintptr_t)ptr + HDRSIZE + MIN_DATA, align);
+	ah = aligned - HDRSIZE;
+	*ah = USED_BLOCK(SIZE(*h) - (aligned - ptr));
+	*h = USED_BLOCK(aligned - ptr - HDRSIZE) | (*h & FLAG_PREV_FREE);
+	release(type, h);
+	shrink(type, ah, size);
+
+	return aligned;
 }
 
 void *memalign(size_t align, size_t size)
@@ -550,7 +512,7 @@ again:
 	ptr = type->start;
 	free_memory = 0;
 
-	while (ptr < type->end) {
+	while (ptr < (void *)heap_fence(type)) {
 		hdrtype_t hdr = *((hdrtype_t *) ptr);
 
 		if (!HAS_MAGIC(hdr)) {
@@ -561,11 +523,9 @@ again:
 			break;
 		}
 
-		/* FIXME: Verify the size of the block. */
-
 		printf("%s %x: %s (%x bytes)\n", type->name,
 		       (unsigned int)(ptr - type->start),
-		       hdr & FLAG_FREE ? "FREE" : "USED", SIZE(hdr));
+		       hdr & FLAG_FREE ? "FREE" : "USED", (unsigned int)SIZE(hdr));
 
 		if (hdr & FLAG_FREE)
 			free_memory += SIZE(hdr);
@@ -0,0 +1,225 @@
+/* system headers */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Host test and benchmark for libc/malloc.c. The allocator is built with
+ * its symbols renamed to lp_* (see Makefile), so it doesn't clash with
+ * the host's malloc.
+ */
+
+void *lp_malloc(size_t size);
+void *lp_calloc(size_t nmemb, size_t size);
+void *lp_realloc(void *ptr, size_t size);
+void lp_free(void *ptr);
+void *lp_memalign(size_t align, size_t size);
+void *lp_dma_malloc(size_t size);
+void *lp_dma_memalign(size_t align, size_t size);
+void lp_init_dma_memory(void *start, uint32_t size);
+
+#define HEAP_SIZE	(4 << 20)
+#define DMA_SIZE	(1 << 20)
+
+/* The heap is delimited by linker script symbols in libpayload. */
+char test_heap[HEAP_SIZE] __attribute__((aligned(16)));
+asm(".globl _heap\n.set _heap, test_heap\n"
+    ".globl _eheap\n.set _eheap, test_heap + 0x400000\n");
+static char test_dma[DMA_SIZE] __attribute__((aligned(16)));
+
+void halt(void)
+{
+	fprintf(stderr, "halt() called\n");
+	exit(1);
+}
+
+int fail(const char *str)
+{
+	fprintf(stderr, "%s", str);
+	exit(1);
+}
+
+struct slot {
+	unsigned char *ptr;
+	size_t size;
+	unsigned char seed;
+	int dma;
+};
+
+#define SLOTS 2048
+static struct slot slots[SLOTS];
+
+static size_t random_size(void)
+{
+	/* Mostly small, sometimes large allocations. */
+	const int bits = rand() % 100 < 90 ? rand() % 9 : rand() % 16;
+	return (rand() & ((1 << bits) - 1)) + 1;
+}
+
+static void fill(struct slot *s)
+{
+	size_t i;
+	for (i = 0; i < s->size; ++i)
+		s->ptr[i] = s->seed + i * 7;
+}
+
+static void check(const struct slot *s, size_t size)
+{
+	size_t i;
+	for (i = 0; i < size; ++i)
+		if (s->ptr[i] != (unsigned char)(s->seed + i * 7))
+			fail("allocation contents corrupted\n");
+}
+
+static int in_range(const void *p, size_t size, const char *start, size_t len)
+{
+	return (const char *)p >= start && (const char *)p + size <= start + len;
+}
+
+static void allocate(struct slot *s)
+{
+	const size_t align = (size_t)8 << (rand() % 10);
+
+	s->size = random_size();
+	s->seed = rand();
+	s->dma = 0;
+
+	switch (rand() % 6) {
+	case 0:
+		s->ptr = lp_calloc(1, s->size);
+		if (s->ptr) {
+			size_t i;
+			for (i = 0; i < s->size; ++i)
+				if (s->ptr[i])
+					fail("calloc returned dirty memory\n");
+		}
+		break;
+	case 1:
+		s->ptr = lp_memalign(align, s->size);
+		if (s->ptr && ((uintptr_t)s->ptr & (align - 1)))
+			fail("memalign returned misaligned memory\n");
+		break;
+	case 2:
+		s->ptr = lp_dma_malloc(s->size);
+		s->dma = 1;
+		break;
+	case 3:
+		s->ptr = lp_dma_memalign(align, s->size);
+		if (s->ptr && ((uintptr_t)s->ptr & (align - 1)))
+			fail("dma_memalign returned misaligned memory\n");
+		s->dma = 1;
+		break;
+	default:
+		s->ptr = lp_malloc(s->size);
+		break;
+	}
+
+	if (!s->ptr)
+		return;
+	if ((uintptr_t)s->ptr & 7)
+		fail("allocation not 8 byte aligned\n");
+	if (s->dma ? !in_range(s->ptr, s->size, test_dma, DMA_SIZE)
+		   : !in_range(s->ptr, s->size, test_heap, HEAP_SIZE))
+		fail("allocation outside of its memory type\n");
+	fill(s);
+}
+
+static void stress(int rounds)
+{
+	int i;
+
+	for (i = 0; i < rounds; ++i) {
+		struct slot *const s = &slots[rand() % SLOTS];
+
+		if (!s->ptr) {
+			allocate(s);
+			continue;
+		}
+
+		check(s, s->size);
+		if (rand() % 4 == 0) {
+			/* Grow or shrink, the common prefix has to survive. */
+			const size_t size = random_size();
+			unsigned char *const p = lp_realloc(s->ptr, size);
+			if (!p)
+				continue;
+			s->ptr = p;
+			check(s, size < s->size ? size : s->size);
+			s->size = size;
+			fill(s);
+		} else {
+			lp_free(s->ptr);
+			s->ptr = NULL;
+		}
+	}
+
+	for (i = 0; i < SLOTS; ++i) {
+		if (slots[i].ptr) {
+			check(&slots[i], slots[i].size);
+			lp_free(slots[i].ptr);
+			slots[i].ptr = NULL;
+		}
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Alloc/free with a working set of live objects of up to 512 bytes. */
+static void benchmark(const char *name, int live, int rounds)
+{
+	void **ptrs = calloc(live, sizeof(*ptrs));
+	int i;
+
+	for (i = 0; i < live; ++i)
+		ptrs[i] = lp_malloc(rand() % 512 + 1);
+
+	const double start = now();
+	for (i = 0; i < rounds; ++i) {
+		const int j = rand() % live;
+		lp_free(ptrs[j]);
+		ptrs[j] = lp_malloc(rand() % 512 + 1);
+		if (!ptrs[j])
+			fail("benchmark allocation failed\n");
+	}
+	const double secs = now() - start;
+
+	for (i = 0; i < live; ++i)
+		lp_free(ptrs[i]);
+	free(ptrs);
+
+	printf("%s: %d live objects, %.0f ns per free+malloc\n",
+	       name, live, secs * 1e9 / rounds);
+}
+
+int main(int argc, char **argv)
+{
+	void *p;
+
+	srand(1);
+
+	lp_init_dma_memory(test_dma, DMA_SIZE);
+
+	stress(500000);
+
+	/* Everything was freed, so each memory type is one free block again. */
+	p = lp_malloc(HEAP_SIZE - 4096);
+	if (!p)
+		fail("heap wasn't coalesced\n");
+	lp_free(p);
+	p = lp_dma_malloc(DMA_SIZE - 64);
+	if (!p)
+		fail("DMA memory wasn't coalesced\n");
+	lp_free(p);
+
+	benchmark("malloc", 100, 1000000);
+	benchmark("malloc", 5000, 1000000);
+
+	exit(0);
+}
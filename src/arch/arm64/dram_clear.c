@@ -0,0 +1,65 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <arch/barrier.h>
+#include <arch/lib_helpers.h>
+#include <commonlib/helpers.h>
+#include <dram_clear.h>
+#include <stdint.h>
+#include <string.h>
+
+#define DCZID_DZP	(1 << 4)
+#define DCZID_BS_MASK	0xf
+
+static uint64_t read_dczid(void)
+{
+	uint64_t dczid;
+
+	__asm__ __volatile__("mrs %0, dczid_el0" : "=r" (dczid));
+
+	return dczid;
+}
+
+/* Zero whole blocks with DC ZVA when it's permitted, memset() otherwise. */
+int arch_dram_clear(uint64_t base, uint64_t size)
+{
+	uint64_t dczid = read_dczid();
+	uint64_t end = base + size;
+	uint64_t block;
+	uint64_t head;
+	uint64_t tail;
+
+	if (dczid & DCZID_DZP) {
+		memset((void *)base, 0, size);
+		return 0;
+	}
+
+	/* Block size is log2 of the number of 4 byte words. */
+	block = 4 << (dczid & DCZID_BS_MASK);
+	head = ALIGN_UP(base, block);
+	tail = ALIGN_DOWN(end, block);
+
+	if (head >= tail) {
+		memset((void *)base, 0, size);
+		return 0;
+	}
+
+	memset((void *)base, 0, head - base);
+	for (; head < tail; head += block)
+		dczva(head);
+	memset((void *)tail, 0, end - tail);
+
+	dsb();
+
+	return 0;
+}
@@ -46,6 +46,7 @@
 #include <cpu/x86/lapic_def.h>
 #include <cpu/cpu.h>
 #include <cbfs.h>
+#include <tcpa_log.h>
 
 u8 acpi_checksum(u8 *table, u32 length)
 {
@@ -256,7 +257,7 @@ void acpi_create_mcfg(acpi_mcfg_t *mcfg)
 static void *get_tcpa_log(u32 *size)
 {
 	const struct cbmem_entry *ce;
-	const u32 tcpa_default_log_len = 0x10000;
+	const u32 tcpa_default_log_len = TCPA_CBMEM_LOG_SIZE;
 	void *lasa;
 	ce = cbmem_entry_find(CBMEM_ID_TCPA_LOG);
 	if (ce) {
@@ -42,6 +42,7 @@
 #define CBMEM_ID_MPTABLE	0x534d5054
 #define CBMEM_ID_MRCDATA	0x4d524344
 #define CBMEM_ID_MTC		0xcb31d31c
+#define CBMEM_ID_MTRR_SOLUTION	0x4d545252
 #define CBMEM_ID_NONE		0x00000000
 #define CBMEM_ID_PIRQ		0x49525154
 #define CBMEM_ID_POWER_STATE	0x50535454
@@ -92,6 +93,7 @@
 	{ CBMEM_ID_MPTABLE,		"SMP TABLE  " }, \
 	{ CBMEM_ID_MRCDATA,		"MRC DATA   " }, \
 	{ CBMEM_ID_MTC,			"MTC        " }, \
+	{ CBMEM_ID_MTRR_SOLUTION,	"MTRR SOLVED" }, \
 	{ CBMEM_ID_PIRQ,		"IRQ TABLE  " }, \
 	{ CBMEM_ID_POWER_STATE,		"POWER STATE" }, \
 	{ CBMEM_ID_RAM_OOPS,		"RAMOOPS    " }, \
@@ -184,6 +184,8 @@ extern const struct region_device_ops mem_rdev_rw_ops;
 
 struct mmap_helper_region_device {
 	struct mem_pool pool;
+	/* Number of outstanding mappings handed out from pool. */
+	size_t mappings;
 	struct region_device rdev;
 };
 
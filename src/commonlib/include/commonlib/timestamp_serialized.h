@@ -49,10 +49,17 @@ enum timestamp_id {
 	TS_END_ULZMA = 16,
 	TS_START_ULZ4F = 17,
 	TS_END_ULZ4F = 18,
+	TS_START_DRAM_CLEAR = 25,
+	TS_END_DRAM_CLEAR = 26,
 	TS_DEVICE_ENUMERATE = 30,
 	TS_DEVICE_CONFIGURE = 40,
 	TS_DEVICE_ENABLE = 50,
 	TS_DEVICE_INITIALIZE = 60,
+	TS_START_MP_INIT = 62,
+	TS_MP_APS_ARRIVED = 63,
+	TS_START_SMM_RELOCATION = 64,
+	TS_END_SMM_RELOCATION = 65,
+	TS_END_MP_INIT = 66,
 	TS_DEVICE_DONE = 70,
 	TS_CBMEM_POST = 75,
 	TS_WRITE_TABLES = 80,
@@ -132,10 +139,17 @@ static const struct timestamp_id_to_name {
 	{ TS_END_ULZMA,		"finished LZMA decompress (ignore for x86)" },
 	{ TS_START_ULZ4F,	"starting LZ4 decompress (ignore for x86)" },
 	{ TS_END_ULZ4F,		"finished LZ4 decompress (ignore for x86)" },
+	{ TS_START_DRAM_CLEAR,	"starting to clear DRAM" },
+	{ TS_END_DRAM_CLEAR,	"finished clearing DRAM" },
 	{ TS_DEVICE_ENUMERATE,	"device enumeration" },
 	{ TS_DEVICE_CONFIGURE,	"device configuration" },
 	{ TS_DEVICE_ENABLE,	"device enable" },
 	{ TS_DEVICE_INITIALIZE,	"device initialization" },
+	{ TS_START_MP_INIT,	"starting MP initialization" },
+	{ TS_MP_APS_ARRIVED,	"all APs checked in" },
+	{ TS_START_SMM_RELOCATION, "starting SMM relocation" },
+	{ TS_END_SMM_RELOCATION, "finished SMM relocation" },
+	{ TS_END_MP_INIT,	"finished MP initialization" },
 	{ TS_DEVICE_DONE,	"device setup done" },
 	{ TS_CBMEM_POST,	"cbmem post" },
 	{ TS_WRITE_TABLES,	"write tables" },
@@ -305,6 +305,7 @@ void mmap_helper_device_init(struct mmap_helper_region_device *mdev,
 				void *cache, size_t cache_size)
 {
 	mem_pool_init(&mdev->pool, cache, cache_size);
+	mdev->mappings = 0;
 }
 
 void *mmap_helper_rdev_mmap(const struct region_device *rd, size_t offset,
@@ -325,6 +326,8 @@ void *mmap_helper_rdev_mmap(const struct region_device *rd, size_t offset,
 		return NULL;
 	}
 
+	mdev->mappings++;
+
 	return mapping;
 }
 
@@ -334,8 +337,24 @@ int mmap_helper_rdev_munmap(const struct region_device *rd, void *mapping)
 
 	mdev = container_of((void *)rd, __typeof__(*mdev), rdev);
 
+	/*
+	 * The device may have been switched to another cache while mappings
+	 * from the previous one were still outstanding. Those don't count
+	 * against the current cache.
+	 */
+	if ((uint8_t *)mapping < mdev->pool.buf ||
+	    (uint8_t *)mapping >= mdev->pool.buf + mdev->pool.size)
+		return 0;
+
 	mem_pool_free(&mdev->pool, mapping);
 
+	/*
+	 * Mappings are not necessarily released in reverse order. Reclaim
+	 * the whole cache once the last outstanding mapping is gone.
+	 */
+	if (mdev->mappings > 0 && --mdev->mappings == 0)
+		mem_pool_reset(&mdev->pool);
+
 	return 0;
 }
 
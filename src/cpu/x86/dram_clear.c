@@ -0,0 +1,139 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; version 2 of
+ * the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <arch/cpu.h>
+#include <console/console.h>
+#include <cpu/x86/mp.h>
+#include <cpu/x86/pae.h>
+#include <dram_clear.h>
+#include <string.h>
+#include <symbols.h>
+
+#define CPUID_FEATURE_SSE2 (1 << 26)
+
+#define PAE_PAGE_SHIFT 21
+#define PAE_PAGE_SIZE (1ULL << PAE_PAGE_SHIFT)
+
+/*
+ * Zero memory using non-temporal stores. This avoids pulling every line
+ * into the caches just to evict it again right away.
+ */
+static void memset_nt(void *dest, size_t size)
+{
+	uintptr_t p = (uintptr_t)dest;
+	uintptr_t end = p + size;
+	uintptr_t head = ALIGN_UP(p, 16);
+	const uint32_t zero = 0;
+
+	if (head > end)
+		head = end;
+	memset((void *)p, 0, head - p);
+
+	for (p = head; end - p >= 16; p += 16) {
+		__asm__ __volatile__(
+			"movnti %1, 0(%0)\n\t"
+			"movnti %1, 4(%0)\n\t"
+			"movnti %1, 8(%0)\n\t"
+			"movnti %1, 12(%0)\n\t"
+			: : "r" (p), "r" (zero) : "memory");
+	}
+
+	memset((void *)p, 0, end - p);
+
+	/* Make the stores globally visible before returning. */
+	__asm__ __volatile__("sfence" : : : "memory");
+}
+
+static void clear_mapped(void *dest, size_t size)
+{
+	if (cpuid_edx(1) & CPUID_FEATURE_SSE2)
+		memset_nt(dest, size);
+	else
+		memset(dest, 0, size);
+}
+
+/*
+ * 32-bit stages reach memory above 4GiB through a 2MiB PAE window. The
+ * window is placed at the first 2MiB slot not used by the running stage,
+ * the rest of the lower 4GiB stays identity mapped. Nothing but the memory
+ * being cleared is accessed while the window is up.
+ */
+static int clear_above_4g(uint64_t base, uint64_t size)
+{
+	const uintptr_t program_start = (uintptr_t)_program;
+	const uintptr_t program_end = (uintptr_t)_eprogram;
+	uint64_t end = base + size;
+	unsigned long slot;
+	int ret = 0;
+
+	for (slot = 0; slot < 2048; slot++) {
+		uint64_t slot_start = (uint64_t)slot << PAE_PAGE_SHIFT;
+
+		if (slot_start + PAE_PAGE_SIZE <= program_start ||
+		    slot_start >= program_end)
+			break;
+	}
+
+	while (base < end) {
+		uint64_t page_end = ALIGN_DOWN(base, PAE_PAGE_SIZE) +
+					PAE_PAGE_SIZE;
+		size_t len = MIN(end, page_end) - base;
+		uint8_t *window;
+
+		window = map_2M_page_at(slot, base >> PAE_PAGE_SHIFT);
+		if (window == MAPPING_ERROR) {
+			ret = -1;
+			break;
+		}
+
+		clear_mapped(window + (base & (PAE_PAGE_SIZE - 1)), len);
+		base += len;
+	}
+
+	/* Turn paging off again. */
+	map_2M_page(0);
+
+	if (ret < 0)
+		printk(BIOS_ERR, "DRAM clear: can't map %llx-%llx\n",
+			base, end - 1);
+
+	return ret;
+}
+
+int arch_dram_clear(uint64_t base, uint64_t size)
+{
+	const uint64_t limit_4g = 4ULL * GiB;
+
+	if (IS_ENABLED(CONFIG_ARCH_RAMSTAGE_X86_32) && base + size > limit_4g) {
+		if (base < limit_4g) {
+			clear_mapped((void *)(uintptr_t)base, limit_4g - base);
+			size -= limit_4g - base;
+			base = limit_4g;
+		}
+		return clear_above_4g(base, size);
+	}
+
+	clear_mapped((void *)(uintptr_t)base, size);
+
+	return 0;
+}
+
+int arch_dram_clear_run_parallel(void (*work)(void))
+{
+	if (!IS_ENABLED(CONFIG_PARALLEL_MP_AP_WORK))
+		return -1;
+
+	/* Clearing hundreds of GiB takes a while. Don't time out. */
+	return mp_run_on_all_cpus(work, 0);
+}
@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <rmodule.h>
 #include <arch/cpu.h>
+#include <bootstate.h>
 #include <cpu/cpu.h>
 #include <cpu/intel/microcode.h>
 #include <cpu/x86/cache.h>
@@ -36,6 +37,8 @@
 #include <smp/spinlock.h>
 #include <symbols.h>
 #include <thread.h>
+#include <timer.h>
+#include <timestamp.h>
 
 #define MAX_APIC_IDS 256
 
@@ -137,6 +140,21 @@ struct cpu_map {
 /* Keep track of APIC and device structure for each CPU. */
 static struct cpu_map cpus[CONFIG_MAX_CPUS];
 
+/*
+ * With PARALLEL_MP_AP_WORK the APs don't park after the flight plan. They
+ * wait for callbacks handed to them through their slot in ap_callbacks[].
+ * A slot is cleared once the AP picked up the callback and ap_work_done is
+ * incremented after it returned.
+ */
+struct mp_callback {
+	void (*func)(void);
+};
+
+static struct mp_callback *ap_callbacks[CONFIG_MAX_CPUS];
+static atomic_t ap_work_done;
+static int global_num_aps;
+static int aps_parked;
+
 static inline void barrier_wait(atomic_t *b)
 {
 	while (atomic_read(b) == 0) {
@@ -185,6 +203,49 @@ static void ap_do_flight_plan(void)
 	}
 }
 
+static struct mp_callback *read_callback(struct mp_callback **slot)
+{
+	return *(struct mp_callback * volatile *)slot;
+}
+
+static void store_callback(struct mp_callback **slot, struct mp_callback *val)
+{
+	*(struct mp_callback * volatile *)slot = val;
+}
+
+static void ap_wait_for_instruction(void)
+{
+	struct mp_callback lcb;
+	struct mp_callback **per_cpu_slot;
+
+	if (!IS_ENABLED(CONFIG_PARALLEL_MP_AP_WORK))
+		return;
+
+	per_cpu_slot = &ap_callbacks[cpu_index()];
+
+	while (1) {
+		struct mp_callback *cb = read_callback(per_cpu_slot);
+
+		if (cb == NULL) {
+			asm ("pause");
+			continue;
+		}
+
+		/* Copy to local variable before signalling consumption. */
+		memcpy(&lcb, cb, sizeof(lcb));
+		mfence();
+		store_callback(per_cpu_slot, NULL);
+
+		/* A NULL callback asks the AP to park for good. */
+		if (lcb.func == NULL)
+			return;
+
+		lcb.func();
+		mfence();
+		atomic_inc(&ap_work_done);
+	}
+}
+
 /* By the time APs call ap_init() caching has been setup, and microcode has
  * been loaded. */
 static void asmlinkage ap_init(unsigned int cpu)
@@ -209,6 +270,9 @@ static void asmlinkage ap_init(unsigned int cpu)
 	/* Walk the flight plan */
 	ap_do_flight_plan();
 
+	/* Optionally wait for more work to do. */
+	ap_wait_for_instruction();
+
 	/* Park the AP. */
 	stop_this_cpu();
 }
@@ -589,6 +653,9 @@ static int mp_init(struct bus *cpu_bus, struct mp_params *p)
 	int num_cpus;
 	int num_aps;
 	atomic_t *ap_count;
+	int ret;
+
+	timestamp_add_now(TS_START_MP_INIT);
 
 	init_bsp(cpu_bus);
 
@@ -629,10 +696,143 @@ static int mp_init(struct bus *cpu_bus, struct mp_params *p)
 		return -1;
 	}
 
+	timestamp_add_now(TS_MP_APS_ARRIVED);
+
+	global_num_aps = num_aps;
+
 	/* Walk the flight plan for the BSP. */
-	return bsp_do_flight_plan(p);
+	ret = bsp_do_flight_plan(p);
+
+	timestamp_add_now(TS_END_MP_INIT);
+
+	return ret;
+}
+
+/* Hand cb to every AP. Returns < 0 if not all APs picked it up in time. */
+static int dispatch_ap_work(struct mp_callback *cb, struct stopwatch *sw,
+				long expire_us)
+{
+	int i;
+	int cur_cpu = cpu_index();
+
+	if (!IS_ENABLED(CONFIG_PARALLEL_MP_AP_WORK) || aps_parked) {
+		printk(BIOS_ERR, "APs are not waiting for work.\n");
+		return -1;
+	}
+
+	if (global_num_aps == 0)
+		return 0;
+
+	atomic_set(&ap_work_done, 0);
+
+	/* Wait for any previous work to be picked up. */
+	for (i = 0; i <= global_num_aps; i++) {
+		if (i == cur_cpu)
+			continue;
+		while (read_callback(&ap_callbacks[i]) != NULL) {
+			if (expire_us > 0 && stopwatch_expired(sw)) {
+				printk(BIOS_ERR, "AP %d is still busy.\n", i);
+				return -1;
+			}
+			asm ("pause");
+		}
+	}
+
+	mfence();
+	for (i = 0; i <= global_num_aps; i++) {
+		if (i == cur_cpu)
+			continue;
+		store_callback(&ap_callbacks[i], cb);
+	}
+	mfence();
+
+	/* Wait for all the APs to pick up the work. */
+	for (i = 0; i <= global_num_aps; i++) {
+		if (i == cur_cpu)
+			continue;
+		while (read_callback(&ap_callbacks[i]) != NULL) {
+			if (expire_us > 0 && stopwatch_expired(sw)) {
+				printk(BIOS_ERR, "AP %d did not pick up work.\n",
+					i);
+				return -1;
+			}
+			asm ("pause");
+		}
+	}
+
+	return 0;
+}
+
+static int wait_ap_work_done(struct stopwatch *sw, long expire_us)
+{
+	while (atomic_read(&ap_work_done) != global_num_aps) {
+		if (expire_us > 0 && stopwatch_expired(sw)) {
+			printk(BIOS_ERR, "%d/%d APs finished work.\n",
+				atomic_read(&ap_work_done), global_num_aps);
+			return -1;
+		}
+		asm ("pause");
+	}
+	mfence();
+
+	return 0;
+}
+
+int mp_run_on_aps(void (*func)(void), long expire_us)
+{
+	struct mp_callback lcb = { .func = func };
+	struct stopwatch sw;
+
+	stopwatch_init_usecs_expire(&sw, expire_us);
+
+	if (dispatch_ap_work(&lcb, &sw, expire_us) < 0)
+		return -1;
+
+	return wait_ap_work_done(&sw, expire_us);
+}
+
+int mp_run_on_all_cpus(void (*func)(void), long expire_us)
+{
+	struct mp_callback lcb = { .func = func };
+	struct stopwatch sw;
+
+	stopwatch_init_usecs_expire(&sw, expire_us);
+
+	if (dispatch_ap_work(&lcb, &sw, expire_us) < 0)
+		return -1;
+
+	/* The BSP does its share while the APs are busy. */
+	func();
+
+	return wait_ap_work_done(&sw, expire_us);
+}
+
+int mp_park_aps(void)
+{
+	struct mp_callback lcb = { .func = NULL };
+	struct stopwatch sw;
+	const long expire_us = 1000 * USECS_PER_MSEC;
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_PARALLEL_MP_AP_WORK) || aps_parked)
+		return 0;
+
+	stopwatch_init_usecs_expire(&sw, expire_us);
+	ret = dispatch_ap_work(&lcb, &sw, expire_us);
+	aps_parked = 1;
+
+	return ret;
 }
 
+static void park_aps(void *unused)
+{
+	mp_park_aps();
+}
+
+/* Don't leave the APs spinning on coreboot memory past this point. */
+BOOT_STATE_INIT_ENTRY(BS_PAYLOAD_LOAD, BS_ON_EXIT, park_aps, NULL);
+BOOT_STATE_INIT_ENTRY(BS_OS_RESUME, BS_ON_ENTRY, park_aps, NULL);
+
 /* Calls cpu_initialize(info->index) which calls the coreboot CPU drivers. */
 static void mp_initialize_cpu(void)
 {
@@ -663,11 +863,13 @@ void smm_initiate_relocation_parallel(void)
 
 	lapic_write_around(LAPIC_ICR2, SET_LAPIC_DEST_FIELD(lapicid()));
 	lapic_write_around(LAPIC_ICR, LAPIC_INT_ASSERT | LAPIC_DM_SMI);
-	if (apic_wait_timeout(1000 /* 1 ms */, 100 /* us */)) {
+	/*
+	 * The SMI is taken as soon as it is delivered. With relocation
+	 * serialized every CPU waits for the ones before it, so poll at a
+	 * fine step and keep the console out of the path.
+	 */
+	if (apic_wait_timeout(1000 /* 1 ms */, 1 /* us */))
 		printk(BIOS_DEBUG, "SMI Relocation timed out.\n");
-	} else
-		printk(BIOS_DEBUG, "Relocation complete.\n");
-
 }
 
 DECLARE_SPIN_LOCK(smm_relocation_lock);
@@ -732,7 +934,7 @@ static void asmlinkage smm_do_relocation(void *arg)
 	perm_smbase = mp_state.perm_smbase;
 	perm_smbase -= cpu * runtime->save_state_size;
 
-	printk(BIOS_DEBUG, "New SMBASE 0x%08lx\n", perm_smbase);
+	printk(BIOS_SPEW, "CPU %d: New SMBASE 0x%08lx\n", cpu, perm_smbase);
 
 	/* Setup code checks this callback for validity. */
 	mp_state.ops.relocation_handler(cpu, curr_smbase, perm_smbase);
@@ -838,13 +1040,30 @@ static void trigger_smm_relocation(void)
 	mp_state.ops.per_cpu_smm_trigger();
 }
 
+static void bsp_trigger_smm_relocation(void)
+{
+	if (is_smm_enabled())
+		timestamp_add_now(TS_START_SMM_RELOCATION);
+
+	trigger_smm_relocation();
+}
+
+/* The APs only check in here once they are done with their relocation. */
+static void bsp_initialize_cpu(void)
+{
+	if (is_smm_enabled())
+		timestamp_add_now(TS_END_SMM_RELOCATION);
+
+	mp_initialize_cpu();
+}
+
 static struct mp_flight_record mp_steps[] = {
 	/* Once the APs are up load the SMM handlers. */
 	MP_FR_BLOCK_APS(NULL, load_smm_handlers),
 	/* Perform SMM relocation. */
-	MP_FR_NOBLOCK_APS(trigger_smm_relocation, trigger_smm_relocation),
+	MP_FR_NOBLOCK_APS(trigger_smm_relocation, bsp_trigger_smm_relocation),
 	/* Initialize each CPU through the driver framework. */
-	MP_FR_BLOCK_APS(mp_initialize_cpu, mp_initialize_cpu),
+	MP_FR_BLOCK_APS(mp_initialize_cpu, bsp_initialize_cpu),
 	/* Wait for APs to finish everything else then let them park. */
 	MP_FR_BLOCK_APS(NULL, NULL),
 };
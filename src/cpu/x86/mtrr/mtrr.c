@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <bootstate.h>
+#include <cbmem.h>
 #include <console/console.h>
 #include <device/device.h>
 #include <device/pci_ids.h>
@@ -287,15 +288,25 @@ static void calc_fixed_mtrrs(void)
 	fixed_mtrr_types_initialized = 1;
 }
 
-static void commit_fixed_mtrrs(void)
+/*
+ * Fixed MTRR MSR values. They are computed once and then only written by
+ * every CPU calling into the MTRR setup.
+ */
+static msr_t fixed_msrs[NUM_FIXED_MTRRS];
+static unsigned long fixed_msr_index[NUM_FIXED_MTRRS];
+
+static void prepare_fixed_mtrrs(void)
 {
+	static int fixed_msrs_prepared;
 	int i;
 	int j;
 	int msr_num;
 	int type_index;
 	/* 8 ranges per msr. */
-	msr_t fixed_msrs[NUM_FIXED_MTRRS];
-	unsigned long msr_index[NUM_FIXED_MTRRS];
+	unsigned long *msr_index = fixed_msr_index;
+
+	if (fixed_msrs_prepared)
+		return;
 
 	memset(&fixed_msrs, 0, sizeof(fixed_msrs));
 
@@ -334,15 +345,23 @@ static void commit_fixed_mtrrs(void)
 		printk(BIOS_DEBUG, "MTRR: Fixed MSR 0x%lx 0x%08x%08x\n",
 		       msr_index[i], fixed_msrs[i].hi, fixed_msrs[i].lo);
 
+	fixed_msrs_prepared = 1;
+}
+
+static void commit_fixed_mtrrs(void)
+{
+	int i;
+
 	disable_cache();
 	for (i = 0; i < ARRAY_SIZE(fixed_msrs); i++)
-		wrmsr(msr_index[i], fixed_msrs[i]);
+		wrmsr(fixed_msr_index[i], fixed_msrs[i]);
 	enable_cache();
 }
 
 void x86_setup_fixed_mtrrs_no_enable(void)
 {
 	calc_fixed_mtrrs();
+	prepare_fixed_mtrrs();
 	commit_fixed_mtrrs();
 }
 
@@ -368,6 +387,32 @@ struct var_mtrr_solution {
 /* Global storage for variable MTRR solution. */
 static struct var_mtrr_solution mtrr_global_solution;
 
+/*
+ * The variable MTRR solution is kept in CBMEM so that it can be reused on
+ * S3 resume as long as the address space and solver inputs are unchanged.
+ * The address space is stored as it was before the solver updated any tags.
+ */
+struct var_mtrr_range {
+	uint64_t base;
+	uint64_t end;
+	uint64_t tag;
+};
+
+struct var_mtrr_cache {
+	/* Size of the whole entry, 0 until the solution is filled in. */
+	uint32_t size;
+	uint32_t above4gb;
+	uint32_t address_bits;
+	uint32_t bios_mtrrs;
+	uint32_t total_mtrrs;
+	uint32_t num_ranges;
+	struct var_mtrr_solution sol;
+	struct var_mtrr_range ranges[0];
+};
+
+/* The solver ran and changed tags in the physical address space. */
+static int addr_space_solved;
+
 struct var_mtrr_state {
 	struct memranges *addr_space;
 	int above4gb;
@@ -757,19 +802,147 @@ static void commit_var_mtrrs(const struct var_mtrr_solution *sol)
 
 }
 
+static size_t var_mtrr_cache_size(struct memranges *addr_space)
+{
+	struct range_entry *r;
+	size_t num_ranges = 0;
+
+	memranges_each_entry(r, addr_space)
+		num_ranges++;
+
+	return sizeof(struct var_mtrr_cache) +
+		num_ranges * sizeof(struct var_mtrr_range);
+}
+
+static int var_mtrr_cache_matches(const struct var_mtrr_cache *cache,
+				struct memranges *addr_space,
+				int above4gb, int address_bits)
+{
+	const struct var_mtrr_range *range = &cache->ranges[0];
+	struct range_entry *r;
+	uint32_t i = 0;
+
+	if (cache->size != var_mtrr_cache_size(addr_space) ||
+	    cache->above4gb != above4gb ||
+	    cache->address_bits != address_bits ||
+	    cache->bios_mtrrs != bios_mtrrs ||
+	    cache->total_mtrrs != total_mtrrs)
+		return 0;
+
+	memranges_each_entry(r, addr_space) {
+		if (i >= cache->num_ranges ||
+		    range[i].base != range_entry_base(r) ||
+		    range[i].end != range_entry_end(r) ||
+		    range[i].tag != range_entry_tag(r))
+			return 0;
+		i++;
+	}
+
+	return i == cache->num_ranges;
+}
+
+static int load_var_mtrr_solution(struct memranges *addr_space,
+				int above4gb, int address_bits,
+				struct var_mtrr_solution *sol)
+{
+	const struct var_mtrr_cache *cache;
+
+	cache = cbmem_find(CBMEM_ID_MTRR_SOLUTION);
+	if (cache == NULL ||
+	    !var_mtrr_cache_matches(cache, addr_space, above4gb,
+				    address_bits) ||
+	    cache->sol.num_used > total_mtrrs)
+		return -1;
+
+	memcpy(sol, &cache->sol, sizeof(*sol));
+	printk(BIOS_DEBUG, "MTRR: Reusing cached solution (%d MTRRs).\n",
+		sol->num_used);
+
+	return 0;
+}
+
+/*
+ * Record the solver inputs before the solver changes the address space.
+ * The solution is filled in with save_var_mtrr_solution().
+ */
+static struct var_mtrr_cache *save_var_mtrr_inputs(
+				struct memranges *addr_space,
+				int above4gb, int address_bits)
+{
+	const struct cbmem_entry *entry;
+	struct var_mtrr_cache *cache;
+	struct range_entry *r;
+	size_t size;
+	uint32_t i = 0;
+
+	size = var_mtrr_cache_size(addr_space);
+
+	/* An entry left over from before resume may be too small. */
+	cache = cbmem_add(CBMEM_ID_MTRR_SOLUTION, size);
+	entry = cbmem_entry_find(CBMEM_ID_MTRR_SOLUTION);
+	if (cache == NULL || entry == NULL || cbmem_entry_size(entry) < size)
+		return NULL;
+
+	cache->size = 0;
+	cache->above4gb = above4gb;
+	cache->address_bits = address_bits;
+	cache->bios_mtrrs = bios_mtrrs;
+	cache->total_mtrrs = total_mtrrs;
+
+	memranges_each_entry(r, addr_space) {
+		cache->ranges[i].base = range_entry_base(r);
+		cache->ranges[i].end = range_entry_end(r);
+		cache->ranges[i].tag = range_entry_tag(r);
+		i++;
+	}
+	cache->num_ranges = i;
+
+	return cache;
+}
+
+static void save_var_mtrr_solution(struct var_mtrr_cache *cache,
+				const struct var_mtrr_solution *sol)
+{
+	memcpy(&cache->sol, sol, sizeof(*sol));
+	cache->size = sizeof(*cache) +
+		cache->num_ranges * sizeof(struct var_mtrr_range);
+}
+
 void x86_setup_var_mtrrs(unsigned int address_bits, unsigned int above4gb)
 {
 	static struct var_mtrr_solution *sol = NULL;
+	static unsigned int sol_address_bits;
+	static unsigned int sol_above4gb;
+	struct var_mtrr_cache *cache = NULL;
 	struct memranges *addr_space;
 
 	addr_space = get_physical_address_space();
+	above4gb = !!above4gb;
 
-	if (sol == NULL) {
+	/*
+	 * The solution is computed once by the first caller, typically the
+	 * BSP, and then written by every other CPU as is. Once the solver
+	 * changed the address space it no longer matches what is cached.
+	 */
+	if (sol == NULL || sol_above4gb != above4gb ||
+	    sol_address_bits != address_bits) {
 		sol = &mtrr_global_solution;
-		sol->mtrr_default_type =
-			calc_var_mtrrs(addr_space, !!above4gb, address_bits);
-		prepare_var_mtrrs(addr_space, sol->mtrr_default_type,
-				  !!above4gb, address_bits, sol);
+		if (addr_space_solved ||
+		    load_var_mtrr_solution(addr_space, above4gb, address_bits,
+					   sol) != 0) {
+			if (!addr_space_solved)
+				cache = save_var_mtrr_inputs(addr_space,
+						above4gb, address_bits);
+			addr_space_solved = 1;
+			sol->mtrr_default_type = calc_var_mtrrs(addr_space,
+						above4gb, address_bits);
+			prepare_var_mtrrs(addr_space, sol->mtrr_default_type,
+					  above4gb, address_bits, sol);
+			if (cache != NULL)
+				save_var_mtrr_solution(cache, sol);
+		}
+		sol_above4gb = above4gb;
+		sol_address_bits = address_bits;
 	}
 
 	commit_var_mtrrs(sol);
@@ -777,12 +950,15 @@ void x86_setup_var_mtrrs(unsigned int address_bits, unsigned int above4gb)
 
 void x86_setup_mtrrs(void)
 {
-	int address_size;
+	static int address_size;
 
 	x86_setup_fixed_mtrrs();
-	address_size = cpu_phys_address_size();
-	printk(BIOS_DEBUG, "CPU physical address size: %d bits\n",
-		address_size);
+	/* All CPUs are assumed to report the same size as the first one. */
+	if (address_size == 0) {
+		address_size = cpu_phys_address_size();
+		printk(BIOS_DEBUG, "CPU physical address size: %d bits\n",
+			address_size);
+	}
 	/* Always handle addresses above 4GiB. */
 	x86_setup_var_mtrrs(address_size, 1);
 }
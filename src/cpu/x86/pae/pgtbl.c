@@ -43,19 +43,23 @@ static void paging_on(void *pdp)
 		);
 }
 
+struct pde {
+	uint32_t addr_lo;
+	uint32_t addr_hi;
+} __attribute__ ((packed));
+struct pg_table {
+	struct pde pd[2048];
+	struct pde pdp[512];
+} __attribute__ ((packed));
+
+static struct pg_table pgtbl[CONFIG_MAX_CPUS] __attribute__ ((aligned(4096)));
+static unsigned long mapped_window[CONFIG_MAX_CPUS];
+
+/* mapped_window[] value while map_2M_page_at() owns the tables */
+#define WINDOW_AT (~0UL)
+
 void *map_2M_page(unsigned long page)
 {
-	struct pde {
-		uint32_t addr_lo;
-		uint32_t addr_hi;
-	} __attribute__ ((packed));
-	struct pg_table {
-		struct pde pd[2048];
-		struct pde pdp[512];
-	} __attribute__ ((packed));
-
-	static struct pg_table pgtbl[CONFIG_MAX_CPUS] __attribute__ ((aligned(4096)));
-	static unsigned long mapped_window[CONFIG_MAX_CPUS];
 	unsigned long index;
 	unsigned long window;
 	void *result;
@@ -98,3 +102,32 @@ void *map_2M_page(unsigned long page)
 	}
 	return result;
 }
+
+void *map_2M_page_at(unsigned long slot, unsigned long page)
+{
+	struct pde *pd, *pdp;
+	unsigned long index;
+	int i;
+
+	index = cpu_index();
+	if (index >= CONFIG_MAX_CPUS || slot >= 2048)
+		return MAPPING_ERROR;
+
+	paging_off();
+	pd = pgtbl[index].pd;
+	pdp = pgtbl[index].pdp;
+	memset(pdp, 0, sizeof(pgtbl[index].pdp));
+	for (i = 0; i < 4; i++)
+		pdp[i].addr_lo = ((uint32_t)&pd[512*i])|1;
+	/* Identity map all of the lower 4GiB except for the slot */
+	for (i = 0; i < 2048; i++) {
+		pd[i].addr_lo = ((uint32_t)i << 21) | 0xE3;
+		pd[i].addr_hi = 0;
+	}
+	pd[slot].addr_lo = ((page & 0x7ff) << 21) | 0xE3;
+	pd[slot].addr_hi = page >> 11;
+	paging_on(pdp);
+	mapped_window[index] = WINDOW_AT;
+
+	return (void *)(slot << 21);
+}
@@ -86,13 +86,14 @@ static void smm_place_jmp_instructions(void *entry_start, int stride, int num,
 		uint32_t disp = (uint32_t)jmp_target;
 
 		disp -= sizeof(entry) + (uint32_t)cur;
-		printk(BIOS_DEBUG,
-		       "SMM Module: placing jmp sequence at %p rel16 0x%04x\n",
-		       cur, disp);
 		entry.rel16 = disp;
 		memcpy(cur, &entry, sizeof(entry));
 		cur -= stride;
 	}
+
+	/* One line for all entries, on large systems there are hundreds. */
+	printk(BIOS_DEBUG, "SMM Module: placed %d jmp sequences from %p to %p\n",
+	       num, entry_start, cur + stride);
 }
 
 /* Place stacks in base -> base + size region, but ensure the stacks don't
@@ -526,6 +526,117 @@ void dram_print_spd_ddr3(const dimm_attr * dimm)
 	print_ns("  tFAWmin           : ", dimm->tFAW);
 }
 
+/*==============================================================================
+ * = SPD acquisition
+ *----------------------------------------------------------------------------*/
+
+/* Largest burst read issued to the bus */
+#define SPD_BURST_SIZE		32
+/* Module ID, serial number and CRC identify a DIMM */
+#define SPD_DDR3_ID_START	117
+#define SPD_DDR3_ID_END		128
+#define SPD_DDR3_CRC_LO		126
+#define SPD_DDR3_CRC_HI		127
+
+static int spd_read_range(const struct spd_bus *bus, u8 addr, u8 *buf,
+			  int start, int end)
+{
+	int i = start;
+
+	if (bus->read_block) {
+		while (i < end) {
+			size_t len = MIN(SPD_BURST_SIZE, end - i);
+
+			if (bus->read_block(bus, addr, i, &buf[i], len) < 0)
+				break;
+			i += len;
+		}
+	}
+
+	/* Byte reads for buses without burst reads or after a failed burst */
+	for (; i < end; i++) {
+		int val = bus->read_byte(bus, addr, i);
+
+		if (val < 0)
+			return -1;
+		buf[i] = val;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Read a DDR3 SPD
+ *
+ * Uses burst reads where the bus supports them.
+ *
+ * @param bus bus the SPD is on
+ * @param addr address of the SPD on the bus
+ * @param spd buffer for the SPD data, zeroed when the SPD can't be read
+ *
+ * @return 0 on success, -1 if the SPD can't be read, e.g. no DIMM is present
+ */
+int spd_read_ddr3(const struct spd_bus *bus, u8 addr, spd_raw_data spd)
+{
+	if (spd_read_range(bus, addr, spd, 0, sizeof(spd_raw_data)) < 0) {
+		memset(spd, 0, sizeof(spd_raw_data));
+		return -1;
+	}
+
+	return 0;
+}
+
+static int spd_ddr3_crc_valid(const spd_raw_data spd)
+{
+	u16 crc = spd_ddr3_calc_crc((u8 *)spd, sizeof(spd_raw_data));
+
+	return crc != 0 && spd[SPD_DDR3_CRC_LO] == (crc & 0xff) &&
+	       spd[SPD_DDR3_CRC_HI] == (crc >> 8);
+}
+
+/**
+ * \brief Read a DDR3 SPD, reusing a cached copy if the DIMM didn't change
+ *
+ * Only the module ID, serial number and CRC are read from the DIMM. When
+ * they match one of the cached SPDs that has a valid CRC, the cached SPD is
+ * used and the full read is skipped.
+ *
+ * @param bus bus the SPD is on
+ * @param addr address of the SPD on the bus
+ * @param spd buffer for the SPD data, zeroed when the SPD can't be read
+ * @param cached SPDs saved on an earlier boot
+ * @param count number of cached SPDs
+ *
+ * @return 1 if a cached SPD was used, 0 if the SPD was read, -1 on error
+ */
+int spd_read_ddr3_cached(const struct spd_bus *bus, u8 addr,
+			 spd_raw_data spd, const spd_raw_data *cached,
+			 size_t count)
+{
+	size_t i;
+
+	if (spd_read_range(bus, addr, spd, SPD_DDR3_ID_START,
+			   SPD_DDR3_ID_END) < 0) {
+		memset(spd, 0, sizeof(spd_raw_data));
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (memcmp(&spd[SPD_DDR3_ID_START], &cached[i][SPD_DDR3_ID_START],
+			   SPD_DDR3_ID_END - SPD_DDR3_ID_START))
+			continue;
+
+		if (!spd_ddr3_crc_valid(cached[i]))
+			continue;
+
+		printram("SPD at 0x%02x unchanged, using cached copy\n", addr);
+		memcpy(spd, cached[i], sizeof(spd_raw_data));
+		return 1;
+	}
+
+	return spd_read_ddr3(bus, addr, spd);
+}
+
 /*==============================================================================
  *= DDR3 MRS helpers
  *----------------------------------------------------------------------------*/
@@ -401,6 +401,45 @@ static int elog_update_event_buffer_state(void)
 	return 0;
 }
 
+static void elog_write_header_in_mirror(void);
+
+/*
+ * Rebuild the mirror from the segments. The mirror keeps the linear layout
+ * of the non-segmented log so that the copy handed to the OS is unchanged.
+ */
+static int elog_scan_segments(void)
+{
+	const struct region_device *rdev = mirror_dev_get();
+	size_t start = elog_events_start();
+	size_t size = region_device_sz(rdev) - start;
+	ssize_t used;
+	uint8_t *events;
+
+	elog_debug("elog_scan_segments()\n");
+
+	elog_tandem_reset_last_write();
+	elog_write_header_in_mirror();
+
+	events = rdev_mmap(rdev, start, size);
+	if (events == NULL)
+		return -1;
+	memset(events, ELOG_TYPE_EOL, size);
+	used = elog_segments_load(events, size);
+	if (used > 0)
+		memset(&events[used], ELOG_TYPE_EOL, size - used);
+	rdev_munmap(rdev, events);
+
+	if (used <= 0) {
+		printk(BIOS_ERR, "ELOG: No valid segments.\n");
+		return -1;
+	}
+
+	elog_mirror_increment_last_write(used);
+	nv_last_write = mirror_last_write;
+
+	return 0;
+}
+
 static int elog_scan_flash(void)
 {
 	elog_debug("elog_scan_flash()\n");
@@ -408,6 +447,9 @@ static int elog_scan_flash(void)
 	const struct region_device *rdev = mirror_dev_get();
 	size_t size = region_device_sz(&nv_dev);
 
+	if (IS_ENABLED(CONFIG_ELOG_SEGMENTED))
+		return elog_scan_segments();
+
 	/* Fill memory buffer by reading from SPI */
 	mirror_buffer = rdev_mmap_full(rdev);
 	if (rdev_readat(&nv_dev, mirror_buffer, 0, size) != size) {
@@ -569,6 +611,19 @@ static int elog_shrink_by_size(size_t requested_size)
 static int elog_prepare_empty(void)
 {
 	elog_debug("elog_prepare_empty()\n");
+
+	if (IS_ENABLED(CONFIG_ELOG_SEGMENTED)) {
+		size_t cleared = mirror_last_write - elog_events_start();
+
+		if (elog_segments_format() < 0)
+			return -1;
+		elog_tandem_reset_last_write();
+		elog_move_events_to_front(elog_events_start(), 0);
+		elog_write_header_in_mirror();
+		nv_last_write = mirror_last_write;
+		return elog_add_event_word(ELOG_TYPE_LOG_CLEAR, cleared);
+	}
+
 	return elog_shrink_by_size(elog_events_total_space());
 }
 
@@ -579,6 +634,36 @@ static int elog_shrink(void)
 	return 0;
 }
 
+/*
+ * Append an event to the segments and the mirror. Events dropped with a
+ * recycled segment are dropped from the front of the mirror as well.
+ */
+static int elog_append_segmented(const struct event_header *event)
+{
+	const struct region_device *rdev = mirror_dev_get();
+	size_t start = elog_events_start();
+	size_t dropped;
+
+	if (elog_segments_append(event, event->length, &dropped) < 0)
+		return -1;
+
+	if (dropped) {
+		size_t remaining = mirror_last_write - start - dropped;
+
+		elog_move_events_to_front(start + dropped, remaining);
+		mirror_last_write = start + remaining;
+	}
+
+	if (rdev_writeat(rdev, event, mirror_last_write, event->length) !=
+	    event->length)
+		return -1;
+
+	elog_mirror_increment_last_write(event->length);
+	nv_last_write = mirror_last_write;
+
+	return 0;
+}
+
 /*
  * Convert a flash offset into a memory mapped flash address
  */
@@ -678,6 +763,15 @@ static int elog_find_flash(void)
 	printk(BIOS_INFO, "ELOG: NV offset 0x%zx size 0x%zx\n",
 		region_device_offset(rdev), region_device_sz(rdev));
 
+	if (IS_ENABLED(CONFIG_ELOG_SEGMENTED)) {
+		/* The mirror holds the events of all segments. */
+		total_size = MIN(CONFIG_ELOG_SEGMENTS * ELOG_SEGMENT_SIZE,
+				 region_device_sz(rdev));
+		total_size = ALIGN_DOWN(total_size, ELOG_SEGMENT_SIZE);
+		rdev_chain(rdev, rdev, 0, total_size);
+		return elog_segments_init(rdev);
+	}
+
 	/* Keep 4KiB max size until large malloc()s have been fixed. */
 	total_size = MIN(4*KiB, region_device_sz(rdev));
 	rdev_chain(rdev, rdev, 0, total_size);
@@ -836,6 +930,21 @@ static void elog_fill_timestamp(struct event_header *event)
 	}
 }
 
+static void elog_fill_event(struct event_header *event, u8 event_type,
+			    void *data, u8 data_size, u8 event_size)
+{
+	event->type = event_type;
+	event->length = event_size;
+	elog_fill_timestamp(event);
+
+	if (data_size)
+		memcpy(&event[1], data, data_size);
+
+	/* Zero the checksum byte and then compute checksum */
+	elog_update_checksum(event, 0);
+	elog_update_checksum(event, -(elog_checksum_event(event)));
+}
+
 /*
  * Add an event to the log
  */
@@ -858,6 +967,22 @@ int elog_add_event_raw(u8 event_type, void *data, u8 data_size)
 		return -1;
 	}
 
+	if (IS_ENABLED(CONFIG_ELOG_SEGMENTED)) {
+		u8 buffer[MAX_EVENT_SIZE];
+
+		event = (struct event_header *)buffer;
+		elog_fill_event(event, event_type, data, data_size,
+				event_size);
+		if (elog_append_segmented(event) < 0) {
+			printk(BIOS_ERR, "ELOG: Event(%X) append failed\n",
+			       event_type);
+			return -1;
+		}
+		printk(BIOS_INFO, "ELOG: Event(%X) added with size %d\n",
+		       event_type, event_size);
+		return 0;
+	}
+
 	/* Make sure event data can fit */
 	event = elog_get_next_event_buffer(event_size);
 	if (event == NULL) {
@@ -867,16 +992,7 @@ int elog_add_event_raw(u8 event_type, void *data, u8 data_size)
 	}
 
 	/* Fill out event data */
-	event->type = event_type;
-	event->length = event_size;
-	elog_fill_timestamp(event);
-
-	if (data_size)
-		memcpy(&event[1], data, data_size);
-
-	/* Zero the checksum byte and then compute checksum */
-	elog_update_checksum(event, 0);
-	elog_update_checksum(event, -(elog_checksum_event(event)));
+	elog_fill_event(event, event_type, data, data_size, event_size);
 	elog_put_event_buffer(event);
 
 	elog_mirror_increment_last_write(event_size);
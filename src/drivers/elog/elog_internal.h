@@ -45,4 +45,42 @@ struct event_header {
 /* SMBIOS Type 15 related constants */
 #define ELOG_HEADER_TYPE_OEM		0x88
 
+/*
+ * Segmented NV storage. The region is split into erase-block sized
+ * segments used as a ring. Every segment starts with a header carrying a
+ * sequence number, events are appended behind it. Only the oldest segment
+ * is ever erased, to make room for a new one.
+ */
+struct elog_segment_header {
+	u32 magic;
+	u32 sequence;
+	u8 version;
+	u8 header_size;
+	u8 reserved;
+	/* Header bytes sum up to 0. */
+	u8 checksum;
+} __attribute__ ((packed));
+
+#define ELOG_SEGMENT_SIGNATURE		0x47534c45  /* 'ELSG' */
+#define ELOG_SEGMENT_VERSION		1
+#define ELOG_SEGMENT_SIZE		(4 * KiB)
+
+struct region_device;
+
+/* Set up the segments in nv. Returns < 0 if there are fewer than two. */
+int elog_segments_init(const struct region_device *nv);
+/*
+ * Copy the events of all segments, oldest first, to buf and return the
+ * number of bytes copied or < 0 if there are no valid segments.
+ */
+ssize_t elog_segments_load(void *buf, size_t size);
+/* Erase all segments. */
+int elog_segments_format(void);
+/*
+ * Append an event. When a new segment has to be started, the oldest one is
+ * recycled and the number of event bytes lost with it is returned in
+ * dropped.
+ */
+int elog_segments_append(const void *event, size_t size, size_t *dropped);
+
 #endif /* ELOG_INTERNAL_H_ */
@@ -0,0 +1,327 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Log-structured event log storage.
+ *
+ * Segments are filled in ring order and every new segment gets the next
+ * sequence number, so the valid segments form a run of increasing sequence
+ * numbers. Power loss can leave at most one torn event at the end of the
+ * active segment or one segment with a torn header right behind it. Both
+ * are detected by checksums: the torn event is dropped and the active
+ * segment is closed, a torn segment is treated as free.
+ */
+
+#include <commonlib/region.h>
+#include <console/console.h>
+#include <elog.h>
+#include <lib.h>
+#include <stdint.h>
+#include <string.h>
+#include "elog_internal.h"
+
+#define ELOG_MAX_SEGMENTS	8
+
+static struct {
+	const struct region_device *nv;
+	size_t count;
+	/* Index of the segment taking new events. */
+	size_t active;
+	int have_active;
+	/* Active segment can't take further events. */
+	int closed;
+	u32 sequence;
+	/* Write offset in the active segment. */
+	size_t write_offset;
+	/* Event bytes stored in each segment. */
+	size_t used[ELOG_MAX_SEGMENTS];
+} segs;
+
+static size_t seg_offset(size_t seg)
+{
+	return seg * ELOG_SEGMENT_SIZE;
+}
+
+static u8 elog_segment_checksum(const void *data, size_t size)
+{
+	const u8 *p = data;
+	u8 sum = 0;
+
+	while (size--)
+		sum += *p++;
+
+	return sum;
+}
+
+/* Returns 1 and the sequence number if the segment header is valid. */
+static int seg_read_header(size_t seg, u32 *sequence)
+{
+	struct elog_segment_header hdr;
+
+	if (rdev_readat(segs.nv, &hdr, seg_offset(seg), sizeof(hdr)) !=
+	    sizeof(hdr))
+		return 0;
+
+	if (hdr.magic != ELOG_SEGMENT_SIGNATURE ||
+	    hdr.version != ELOG_SEGMENT_VERSION ||
+	    hdr.header_size != sizeof(hdr) ||
+	    elog_segment_checksum(&hdr, sizeof(hdr)) != 0)
+		return 0;
+
+	*sequence = hdr.sequence;
+	return 1;
+}
+
+/*
+ * Find the newest segment. Going from segment 0, sequence numbers increase
+ * up to the newest segment and every later segment is either older than
+ * segment 0 or invalid, so the newest one can be found by a binary search.
+ * If segment 0 itself is invalid, it was torn while being recycled and the
+ * newest segment is the last one.
+ */
+static int seg_find_active(size_t *active, u32 *sequence)
+{
+	size_t lo, hi;
+	u32 first, seq;
+
+	if (!seg_read_header(0, &first)) {
+		*active = segs.count - 1;
+		return seg_read_header(*active, sequence) ? 0 : -1;
+	}
+
+	/* Invariant: lo satisfies the predicate, hi doesn't. */
+	lo = 0;
+	hi = segs.count;
+	*sequence = first;
+
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (seg_read_header(mid, &seq) && seq - first == mid) {
+			lo = mid;
+			*sequence = seq;
+		} else {
+			hi = mid;
+		}
+	}
+
+	*active = lo;
+	return 0;
+}
+
+static size_t event_valid(const u8 *event, size_t avail)
+{
+	size_t len;
+
+	if (avail < sizeof(struct event_header) + 1)
+		return 0;
+
+	len = event[offsetof(struct event_header, length)];
+
+	if (len < sizeof(struct event_header) + 1 || len > MAX_EVENT_SIZE ||
+	    len > avail)
+		return 0;
+
+	if (elog_segment_checksum(event, len) != 0)
+		return 0;
+
+	return len;
+}
+
+/*
+ * Read the events of one segment to buf and return the size of the valid
+ * events. The rest of the segment has to be erased for it to take more
+ * events, which is noted in closed.
+ */
+static ssize_t seg_load(size_t seg, u8 *buf, size_t size, int *closed)
+{
+	const size_t start = sizeof(struct elog_segment_header);
+	size_t data_size = ELOG_SEGMENT_SIZE - start;
+	size_t offset = 0;
+	size_t tail;
+
+	if (data_size > size)
+		return -1;
+
+	if (rdev_readat(segs.nv, buf, seg_offset(seg) + start, data_size) !=
+	    data_size)
+		return -1;
+
+	while (offset < data_size && buf[offset] != ELOG_TYPE_EOL) {
+		size_t len = event_valid(&buf[offset], data_size - offset);
+
+		if (!len)
+			break;
+		offset += len;
+	}
+
+	/*
+	 * Only the last append can have been torn and appends are at most
+	 * MAX_EVENT_SIZE, so checking that much is enough.
+	 */
+	*closed = 0;
+	tail = MIN(data_size - offset, MAX_EVENT_SIZE);
+	while (tail--) {
+		if (buf[offset + tail] != ELOG_TYPE_EOL) {
+			*closed = 1;
+			break;
+		}
+	}
+
+	return offset;
+}
+
+int elog_segments_init(const struct region_device *nv)
+{
+	memset(&segs, 0, sizeof(segs));
+	segs.nv = nv;
+	segs.count = MIN(region_device_sz(nv) / ELOG_SEGMENT_SIZE,
+			 ELOG_MAX_SEGMENTS);
+
+	if (segs.count < 2) {
+		printk(BIOS_ERR, "ELOG: Need at least two %d byte segments\n",
+			ELOG_SEGMENT_SIZE);
+		return -1;
+	}
+
+	return 0;
+}
+
+ssize_t elog_segments_load(void *buf, size_t size)
+{
+	u8 *dest = buf;
+	size_t active;
+	u32 sequence;
+	size_t total = 0;
+	size_t i;
+
+	segs.have_active = 0;
+	memset(segs.used, 0, sizeof(segs.used));
+
+	if (seg_find_active(&active, &sequence) < 0)
+		return -1;
+
+	/* Go from the oldest to the active segment. */
+	for (i = 1; i <= segs.count; i++) {
+		size_t seg = (active + i) % segs.count;
+		u32 seq;
+		ssize_t used;
+		int closed;
+
+		if (!seg_read_header(seg, &seq) ||
+		    sequence - seq != segs.count - i)
+			continue;
+
+		used = seg_load(seg, &dest[total], size - total, &closed);
+		if (used < 0)
+			return -1;
+
+		segs.used[seg] = used;
+		total += used;
+
+		if (seg == active)
+			segs.closed = closed;
+	}
+
+	segs.active = active;
+	segs.sequence = sequence;
+	segs.write_offset = sizeof(struct elog_segment_header) +
+			    segs.used[active];
+	segs.have_active = 1;
+
+	return total;
+}
+
+int elog_segments_format(void)
+{
+	size_t size = segs.count * ELOG_SEGMENT_SIZE;
+
+	if (rdev_eraseat(segs.nv, 0, size) != size) {
+		printk(BIOS_ERR, "ELOG: erase failure.\n");
+		return -1;
+	}
+
+	segs.have_active = 0;
+	segs.closed = 0;
+	memset(segs.used, 0, sizeof(segs.used));
+
+	return 0;
+}
+
+/* Recycle the oldest segment as the new active one. */
+static int seg_start_next(size_t *dropped)
+{
+	struct elog_segment_header hdr = {
+		.magic = ELOG_SEGMENT_SIGNATURE,
+		.version = ELOG_SEGMENT_VERSION,
+		.header_size = sizeof(hdr),
+	};
+	size_t next = 0;
+
+	if (segs.have_active) {
+		next = (segs.active + 1) % segs.count;
+		hdr.sequence = segs.sequence + 1;
+	}
+
+	*dropped = segs.used[next];
+
+	/* A freshly formatted log doesn't need another erase. */
+	if (segs.have_active || segs.closed) {
+		if (rdev_eraseat(segs.nv, seg_offset(next), ELOG_SEGMENT_SIZE)
+		    != ELOG_SEGMENT_SIZE)
+			return -1;
+	}
+
+	hdr.checksum = -elog_segment_checksum(&hdr, sizeof(hdr));
+
+	segs.used[next] = 0;
+	segs.active = next;
+	segs.sequence = hdr.sequence;
+	segs.write_offset = sizeof(hdr);
+	segs.closed = 0;
+	segs.have_active = 1;
+
+	if (rdev_writeat(segs.nv, &hdr, seg_offset(next), sizeof(hdr)) !=
+	    sizeof(hdr)) {
+		segs.closed = 1;
+		return -1;
+	}
+
+	return 0;
+}
+
+int elog_segments_append(const void *event, size_t size, size_t *dropped)
+{
+	*dropped = 0;
+
+	if (!segs.have_active || segs.closed ||
+	    segs.write_offset + size > ELOG_SEGMENT_SIZE) {
+		if (seg_start_next(dropped) < 0) {
+			printk(BIOS_ERR, "ELOG: Unable to start new segment\n");
+			return -1;
+		}
+	}
+
+	if (rdev_writeat(segs.nv, event, seg_offset(segs.active) +
+			 segs.write_offset, size) != size) {
+		printk(BIOS_ERR, "ELOG: NV Write failed at 0x%zx, size 0x%zx\n",
+			seg_offset(segs.active) + segs.write_offset, size);
+		segs.closed = 1;
+		return -1;
+	}
+
+	segs.write_offset += size;
+	segs.used[segs.active] += size;
+
+	return 0;
+}
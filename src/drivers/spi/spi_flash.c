@@ -164,6 +164,55 @@ int spi_flash_cmd_read_slow(struct spi_flash *flash, u32 offset,
 					offset, len, data);
 }
 
+int __attribute__((weak)) spi_xfer_multi_io_read(struct spi_slave *slave,
+			const struct spi_multi_io_read *op, void *din,
+			unsigned int bytesin)
+{
+	return -1;
+}
+
+int spi_flash_cmd_read_multi_io(struct spi_flash *flash, u32 offset,
+			size_t len, void *data)
+{
+	struct spi_slave *spi = flash->spi;
+	struct spi_multi_io_read op = {
+		.opcode = flash->multi_io_read.opcode,
+		.mode = flash->multi_io_read.mode,
+		.mode_cycles = flash->multi_io_read.mode_cycles,
+		.mode_bits = SPI_MULTI_IO_MODE_BITS,
+		.dummy_cycles = flash->multi_io_read.dummy_cycles,
+	};
+	int ret;
+
+	while (len) {
+		size_t transfer_size;
+
+		if (spi->max_transfer_size)
+			transfer_size = min(len, spi->max_transfer_size);
+		else
+			transfer_size = len;
+
+		op.addr = offset;
+
+		if (spi_claim_bus(spi))
+			break;
+		ret = spi_xfer_multi_io_read(spi, &op, data, transfer_size);
+		spi_release_bus(spi);
+
+		if (ret) {
+			printk(BIOS_WARNING, "SF: Failed multi-I/O read "
+				"(%zu bytes): %d\n", transfer_size, ret);
+			break;
+		}
+
+		offset += transfer_size;
+		data = (void *)((uintptr_t)data + transfer_size);
+		len -= transfer_size;
+	}
+
+	return len != 0;
+}
+
 int spi_flash_cmd_poll_bit(struct spi_flash *flash, unsigned long timeout,
 			   u8 cmd, u8 poll_bit)
 {
@@ -245,6 +294,208 @@ int spi_flash_cmd_status(struct spi_flash *flash, u8 *reg)
 	return spi_flash_cmd(flash->spi, flash->status_cmd, reg, sizeof(*reg));
 }
 
+/*
+ * Serial Flash Discoverable Parameters (JESD216). Only the basic flash
+ * parameter table (BFPT) is used to find the multi-I/O fast read opcodes.
+ */
+#define SFDP_SIGNATURE		0x50444653
+#define SFDP_BFPT_ID		0xff00
+#define SFDP_BFPT_MIN_DWORDS	9
+#define SFDP_BFPT_MAX_DWORDS	16
+/* DWORD1 address bytes field: 4-byte addressing only. */
+#define SFDP_BFPT_ADDR_4B_ONLY	2
+/* DWORD15 quad enable requirements, JESD216A and later. */
+#define SFDP_BFPT_QER_DWORD	15
+
+#define SPI_MULTI_IO_QUAD	(SPI_MULTI_IO_1_1_4 | SPI_MULTI_IO_1_4_4)
+
+/* Read modes in order of preference and where the BFPT describes them. */
+static const struct {
+	u8 mode;
+	const char *name;
+	/* Support bit in DWORD1. */
+	u8 support_bit;
+	/* DWORD (1-based) and bit offset of dummy/mode clocks and opcode. */
+	u8 dword;
+	u8 shift;
+	/* I/O lines the address and mode bits are sent on. */
+	u8 addr_lines;
+} sfdp_read_modes[] = {
+	{ SPI_MULTI_IO_1_4_4, "1-4-4", 21, 3, 0, 4 },
+	{ SPI_MULTI_IO_1_1_4, "1-1-4", 22, 3, 16, 1 },
+	{ SPI_MULTI_IO_1_2_2, "1-2-2", 20, 4, 16, 2 },
+	{ SPI_MULTI_IO_1_1_2, "1-1-2", 16, 4, 0, 1 },
+};
+
+static u32 sfdp_dword(const u8 *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (u32)p[3] << 24;
+}
+
+static int sfdp_read(struct spi_slave *spi, u32 addr, void *buf, size_t len)
+{
+	u8 cmd[5];
+
+	cmd[0] = CMD_READ_SFDP;
+	spi_flash_addr(addr, cmd);
+	cmd[4] = 0x00;
+
+	return spi_flash_cmd_read(spi, cmd, sizeof(cmd), buf, len);
+}
+
+/* Read the BFPT into bfpt[] and return its length in DWORDs, < 0 on error. */
+static int sfdp_read_bfpt(struct spi_slave *spi, u32 *bfpt)
+{
+	u8 buf[SFDP_BFPT_MAX_DWORDS * sizeof(u32)];
+	u32 ptr;
+	int dwords;
+	int i;
+
+	/* SFDP header followed by the mandatory first parameter header. */
+	if (sfdp_read(spi, 0, buf, 16))
+		return -1;
+
+	if (sfdp_dword(&buf[0]) != SFDP_SIGNATURE)
+		return -1;
+
+	/* Major revision 1 of the header and the BFPT is understood. */
+	if (buf[5] != 1 || (buf[8] | buf[15] << 8) != SFDP_BFPT_ID ||
+	    buf[10] != 1)
+		return -1;
+
+	dwords = buf[11];
+	ptr = sfdp_dword(&buf[12]) & 0xffffff;
+
+	if (dwords < SFDP_BFPT_MIN_DWORDS)
+		return -1;
+	if (dwords > SFDP_BFPT_MAX_DWORDS)
+		dwords = SFDP_BFPT_MAX_DWORDS;
+
+	if (sfdp_read(spi, ptr, buf, dwords * sizeof(u32)))
+		return -1;
+
+	for (i = 0; i < dwords; i++)
+		bfpt[i] = sfdp_dword(&buf[i * sizeof(u32)]);
+
+	return dwords;
+}
+
+/*
+ * Quad reads only work with the quad enable bit set. It's not set here
+ * since that needs a non-volatile status register write, so only check
+ * that it already is.
+ */
+static int sfdp_quad_enabled(struct spi_slave *spi, const u32 *bfpt,
+			     int dwords)
+{
+	u8 cmd, bit, status;
+
+	if (dwords < SFDP_BFPT_QER_DWORD)
+		return 0;
+
+	switch ((bfpt[SFDP_BFPT_QER_DWORD - 1] >> 20) & 0x7) {
+	case 0:
+		/* No quad enable bit. */
+		return 1;
+	case 1:
+	case 4:
+	case 5:
+		cmd = CMD_READ_STATUS2;
+		bit = 1 << 1;
+		break;
+	case 2:
+		cmd = CMD_READ_STATUS;
+		bit = 1 << 6;
+		break;
+	case 3:
+		cmd = CMD_READ_STATUS2_ALT;
+		bit = 1 << 7;
+		break;
+	default:
+		return 0;
+	}
+
+	if (spi_flash_cmd(spi, cmd, &status, sizeof(status)))
+		return 0;
+
+	return !!(status & bit);
+}
+
+/* Pick the preferred read mode present in both the BFPT and modes. */
+static int sfdp_select_read_mode(struct spi_flash *flash, const u32 *bfpt,
+				 unsigned int modes)
+{
+	int i;
+
+	if (((bfpt[0] >> 17) & 0x3) == SFDP_BFPT_ADDR_4B_ONLY)
+		return -1;
+
+	for (i = 0; i < ARRAY_SIZE(sfdp_read_modes); i++) {
+		u32 params;
+		u8 mode_cycles;
+
+		if (!(modes & sfdp_read_modes[i].mode))
+			continue;
+		if (!(bfpt[0] & (1 << sfdp_read_modes[i].support_bit)))
+			continue;
+
+		params = bfpt[sfdp_read_modes[i].dword - 1];
+		params >>= sfdp_read_modes[i].shift;
+
+		/*
+		 * The mode bits decide whether the part stays in continuous
+		 * read mode, so they have to be driven explicitly and can't
+		 * be left to whatever the controller sends for dummy clocks.
+		 * Only a full mode byte is supported.
+		 */
+		mode_cycles = (params >> 5) & 0x7;
+		if (mode_cycles &&
+		    mode_cycles * sfdp_read_modes[i].addr_lines != 8)
+			continue;
+
+		flash->multi_io_read.mode = sfdp_read_modes[i].mode;
+		flash->multi_io_read.opcode = (params >> 8) & 0xff;
+		flash->multi_io_read.mode_cycles = mode_cycles;
+		flash->multi_io_read.dummy_cycles = params & 0x1f;
+
+		printk(BIOS_INFO, "SF: Using %s fast read, opcode 0x%02x, "
+			"%d mode clocks, %d dummy clocks\n",
+			sfdp_read_modes[i].name, flash->multi_io_read.opcode,
+			flash->multi_io_read.mode_cycles,
+			flash->multi_io_read.dummy_cycles);
+		return 0;
+	}
+
+	return -1;
+}
+
+static void spi_flash_setup_multi_io(struct spi_flash *flash)
+{
+	struct spi_slave *spi = flash->spi;
+	u32 bfpt[SFDP_BFPT_MAX_DWORDS];
+	unsigned int modes = spi->multi_io;
+	int dwords;
+
+	flash->multi_io_read.mode = 0;
+
+	/* Only upgrade the generic fast read. */
+	if (!modes || flash->read != spi_flash_cmd_read_fast)
+		return;
+
+	dwords = sfdp_read_bfpt(spi, bfpt);
+	if (dwords < 0) {
+		printk(BIOS_DEBUG, "SF: No usable SFDP table\n");
+		return;
+	}
+
+	if ((modes & SPI_MULTI_IO_QUAD) &&
+	    !sfdp_quad_enabled(spi, bfpt, dwords))
+		modes &= ~SPI_MULTI_IO_QUAD;
+
+	if (sfdp_select_read_mode(flash, bfpt, modes) == 0)
+		flash->read = spi_flash_cmd_read_multi_io;
+}
+
 /*
  * The following table holds all device probe functions
  *
@@ -373,6 +624,9 @@ flash_detected:
 	printk(BIOS_INFO, "SF: Detected %s with sector size 0x%x, total 0x%x\n",
 			flash->name, flash->sector_size, flash->size);
 
+	if (IS_ENABLED(CONFIG_SPI_FLASH_MULTI_IO_READ))
+		spi_flash_setup_multi_io(flash);
+
 	/*
 	 * Only set the global spi_flash_dev if this is the boot
 	 * device's bus and it's previously unset while in ramstage.
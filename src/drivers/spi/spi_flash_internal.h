@@ -22,8 +22,11 @@
 #define CMD_READ_ARRAY_SLOW		0x03
 #define CMD_READ_ARRAY_FAST		0x0b
 #define CMD_READ_ARRAY_LEGACY		0xe8
+#define CMD_READ_SFDP			0x5a
 
 #define CMD_READ_STATUS			0x05
+#define CMD_READ_STATUS2		0x35
+#define CMD_READ_STATUS2_ALT		0x3f
 #define CMD_WRITE_ENABLE		0x06
 
 #define CMD_BLOCK_ERASE			0xD8
@@ -40,6 +43,10 @@ int spi_flash_cmd_read_fast(struct spi_flash *flash, u32 offset,
 int spi_flash_cmd_read_slow(struct spi_flash *flash, u32 offset,
 		size_t len, void *data);
 
+/* Read using the multi-I/O mode in flash->multi_io_read. */
+int spi_flash_cmd_read_multi_io(struct spi_flash *flash, u32 offset,
+		size_t len, void *data);
+
 /*
  * Send a multi-byte command to the device followed by (optional)
  * data. Used for programming the flash array, etc.
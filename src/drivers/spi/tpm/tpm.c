@@ -15,12 +15,14 @@
  * Specification Revision 00.43".
  */
 
+#include <arch/early_variables.h>
 #include <commonlib/endian.h>
 #include <console/console.h>
 #include <delay.h>
 #include <endian.h>
 #include <string.h>
 #include <timer.h>
+#include <tpm.h>
 
 #include "tpm.h"
 
@@ -54,6 +56,9 @@ static struct tpm_spi_if tpm_if = {
 /* Cached TPM device identification. */
 struct tpm2_info tpm_info;
 
+/* A transaction completed in this stage, so the TPM will raise its IRQ. */
+static int tpm_irq_expected CAR_GLOBAL;
+
 /*
  * TODO(vbendeb): make CONFIG_DEBUG_TPM an int to allow different level of
  * debug traces. Right now it is either 0 or 1.
@@ -102,6 +107,47 @@ void tpm2_get_info(struct tpm2_info *info)
 	*info = tpm_info;
 }
 
+__attribute__((weak)) int tis_plat_irq_status(void)
+{
+	static int warning_displayed CAR_GLOBAL;
+
+	if (!car_get_var(warning_displayed)) {
+		printk(BIOS_WARNING, "WARNING: tis_plat_irq_status() not "
+		       "implemented, losing 10ms per TPM transaction.\n");
+		car_set_var(warning_displayed, 1);
+	}
+	mdelay(10);
+
+	return 1;
+}
+
+/*
+ * The TPM needs some time to get ready for the next transaction after CS is
+ * deasserted and raises its interrupt line once it is. Wait for that before
+ * starting another transaction.
+ *
+ * The first transaction of a stage can't tell whether an earlier stage left
+ * a transaction in flight, so it always waits. If nothing talked to the TPM
+ * before, no interrupt comes and the timeout is expected.
+ *
+ * Returns one to indicate success, zero to indicate a timeout.
+ */
+static int tpm_sync(void)
+{
+	struct stopwatch sw;
+
+	stopwatch_init_msecs_expire(&sw, 10);
+	while (!tis_plat_irq_status()) {
+		if (stopwatch_expired(&sw)) {
+			if (car_get_var(tpm_irq_expected))
+				printk(BIOS_ERR, "Timeout waiting for TPM IRQ\n");
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
 /*
  * Each TPM2 SPI transaction starts the same: CS is asserted, the 4 byte
  * header is sent to the TPM, the master waits til TPM is ready to continue.
@@ -112,11 +158,8 @@ static void start_transaction(int read_write, size_t bytes, unsigned addr)
 	uint8_t byte;
 	int i;
 
-	/*
-	 * Give it 10 ms. TODO(vbendeb): remove this once cr50 SPS TPM driver
-	 * performance is fixed.
-	 */
-	mdelay(10);
+	tpm_sync();
+	car_set_var(tpm_irq_expected, 1);
 
 	/*
 	 * The first byte of the frame header encodes the transaction type
@@ -408,15 +451,16 @@ static int wait_for_status(uint32_t status_mask, uint32_t status_expected)
 	struct stopwatch sw;
 
 	stopwatch_init_usecs_expire(&sw, MAX_STATUS_TIMEOUT * 1000 * 1000);
-	do {
-		udelay(1000);
+	read_tpm_sts(&status);
+	while ((status & status_mask) != status_expected) {
 		if (stopwatch_expired(&sw)) {
 			printk(BIOS_ERR, "failed to get expected status %x\n",
 			       status_expected);
 			return false;
 		}
+		udelay(1000);
 		read_tpm_sts(&status);
-	} while ((status & status_mask) != status_expected);
+	}
 
 	return 1;
 }
@@ -434,21 +478,23 @@ union fifo_transfer_buffer {
 
 /*
  * Transfer requested number of bytes to or from TPM FIFO, accounting for the
- * current burst count value.
+ * current burst count value. The burst count is the number of bytes the TPM
+ * can take or provide without wait states, so the status register only needs
+ * to be read again once that many bytes were transferred.
  */
 static void fifo_transfer(size_t transfer_size,
 			  union fifo_transfer_buffer buffer,
 			  enum fifo_transfer_direction direction)
 {
 	size_t transaction_size;
-	size_t burst_count;
+	size_t burst_count = 0;
 	size_t handled_so_far = 0;
 
 	do {
-		do {
+		while (!burst_count) {
 			/* Could be zero when TPM is busy. */
 			burst_count = get_burst_count();
-		} while (!burst_count);
+		}
 
 		transaction_size = transfer_size - handled_so_far;
 		transaction_size = MIN(transaction_size, burst_count);
@@ -469,6 +515,7 @@ static void fifo_transfer(size_t transfer_size,
 				       transaction_size);
 
 		handled_so_far += transaction_size;
+		burst_count -= transaction_size;
 
 	} while (handled_so_far != transfer_size);
 }
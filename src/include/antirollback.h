@@ -19,9 +19,13 @@ enum vb2_pcr_digest;
 #define KERNEL_NV_INDEX                 0x1008
 /* 0x1009 used to be used as a backup space. Think of conflicts if you
  * want to use 0x1009 for something else. */
+#define SLOT_HASH_NV_INDEX              0x100c
 
 /* Structure definitions for TPM spaces */
 
+/* Slot hash space: digest of the sealed RW slot and of its body. */
+#define SLOT_HASH_SIZE                  96
+
 /* Flags for firmware space */
 
 /*
@@ -44,6 +48,18 @@ uint32_t antirollback_write_space_firmware(struct vb2_context *ctx);
  */
 uint32_t antirollback_lock_space_firmware(void);
 
+/**
+ * Read and write the slot hash space. Writes only succeed before the
+ * firmware space is locked.
+ */
+uint32_t antirollback_read_space_slot_hash(void *data, uint32_t size);
+uint32_t antirollback_write_space_slot_hash(const void *data, uint32_t size);
+
+/**
+ * Lock the slot hash space if it isn't covered by the firmware space lock.
+ */
+uint32_t antirollback_lock_space_slot_hash(void);
+
 /****************************************************************************/
 
 /*
@@ -38,6 +38,13 @@ void bootmem_write_memory_table(struct lb_memory *mem);
 /* Print current range map of boot memory. */
 void bootmem_dump_ranges(void);
 
+/*
+ * Call action for each bootmem range in ascending order. The walk stops
+ * early when action returns false. Returns false if it stopped early.
+ */
+typedef bool (*range_action_t)(const struct range_entry *r, void *arg);
+bool bootmem_walk(range_action_t action, void *arg);
+
 /* Return 1 if region targets usable RAM, 0 otherwise. */
 int bootmem_region_targets_usable_ram(uint64_t start, uint64_t size);
 
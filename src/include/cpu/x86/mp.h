@@ -124,6 +124,23 @@ struct mp_ops {
  */
 int mp_init_with_smm(struct bus *cpu_bus, const struct mp_ops *mp_ops);
 
+/*
+ * After mp_init_with_smm() the APs can be handed more work when
+ * PARALLEL_MP_AP_WORK is selected. The callbacks are run once on every AP
+ * (mp_run_on_aps()) or on every AP and the calling CPU
+ * (mp_run_on_all_cpus()). Both return once all CPUs completed the callback
+ * or after expire_us microseconds, whichever comes first. A non-positive
+ * expire_us waits forever. Callbacks can use cpu_index() to split work.
+ */
+int mp_run_on_aps(void (*func)(void), long expire_us);
+int mp_run_on_all_cpus(void (*func)(void), long expire_us);
+
+/*
+ * Stop the APs from waiting for work. This is done automatically before
+ * the payload or OS is entered.
+ */
+int mp_park_aps(void);
+
 /*
  * SMM helpers to use with initializing CPUs.
  */
@@ -3,5 +3,12 @@
 
 #define MAPPING_ERROR ((void *)0xffffffffUL)
 void *map_2M_page(unsigned long page);
+/*
+ * Map the 2MiB page `page` at the 2MiB page `slot` of the address space and
+ * identity map the rest of the lower 4GiB. Unlike map_2M_page() this works
+ * wherever the running code resides, as long as it doesn't use the slot.
+ * map_2M_page(0) turns paging off again.
+ */
+void *map_2M_page_at(unsigned long slot, unsigned long page);
 
 #endif /* CPU_X86_PAE_H  */
@@ -29,6 +29,7 @@
  * \brief Utilities for decoding DDR3 SPDs
  */
 
+#include <stddef.h>
 #include <stdint.h>
 #include <spd.h>
 
@@ -206,6 +207,24 @@ int spd_xmp_decode_ddr3(dimm_attr * dimm,
 		        spd_raw_data spd,
 		        enum ddr3_xmp_profile profile);
 
+/**
+ * \brief Bus the SPD EEPROMs are accessed through
+ *
+ * read_byte() returns the byte read or < 0 on error. read_block() is optional
+ * and reads len consecutive bytes starting at offset, returning 0 on success.
+ * Controller specific state can be kept in a structure embedding this one.
+ */
+struct spd_bus {
+	int (*read_byte)(const struct spd_bus *bus, u8 addr, u8 offset);
+	int (*read_block)(const struct spd_bus *bus, u8 addr, u8 offset,
+			  u8 *buf, size_t len);
+};
+
+int spd_read_ddr3(const struct spd_bus *bus, u8 addr, spd_raw_data spd);
+int spd_read_ddr3_cached(const struct spd_bus *bus, u8 addr,
+			 spd_raw_data spd, const spd_raw_data *cached,
+			 size_t count);
+
 /**
  * \brief Read double word from specified address
  *
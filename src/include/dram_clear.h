@@ -0,0 +1,46 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef DRAM_CLEAR_H
+#define DRAM_CLEAR_H
+
+#include <stdint.h>
+
+struct memranges;
+
+/*
+ * Zero all ranges in ranges. The work is split in chunks which are handed
+ * out to all CPUs the architecture can run it on. Returns 0 on success,
+ * < 0 on error.
+ */
+int dram_clear_ranges(const struct memranges *ranges);
+
+/*
+ * Zero all usable RAM tracked by bootmem except for the memory occupied by
+ * the current stage and the memlayout regions it may still use.
+ * bootmem_init() needs to have been called.
+ */
+int dram_clear_usable_ram(void);
+
+/*
+ * Architecture hooks. arch_dram_clear() zeroes [base, base + size) from the
+ * calling CPU and returns < 0 if it couldn't reach all of it.
+ * arch_dram_clear_run_parallel() runs work() on every CPU including the
+ * calling one and returns once all of them finished. It returns < 0 if that
+ * wasn't possible. The default implementations use memset() and only run
+ * work() on the calling CPU.
+ */
+int arch_dram_clear(uint64_t base, uint64_t size);
+int arch_dram_clear_run_parallel(void (*work)(void));
+
+#endif /* DRAM_CLEAR_H */
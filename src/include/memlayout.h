@@ -81,6 +81,10 @@
 #define PRERAM_CBMEM_CONSOLE(addr, size) \
 	REGION(preram_cbmem_console, addr, size, 4)
 
+/* Measured boot events logged before CBMEM is up, see tcpa_log.h. */
+#define TCPA_LOG(addr, size) \
+	REGION(tcpa_log, addr, size, 4)
+
 /* Use either CBFS_CACHE (unified) or both (PRERAM|POSTRAM)_CBFS_CACHE */
 #define CBFS_CACHE(addr, size) \
 	REGION(cbfs_cache, addr, size, 4) \
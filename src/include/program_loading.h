@@ -19,6 +19,9 @@
 #include <commonlib/region.h>
 #include <stdint.h>
 #include <stddef.h>
+#if IS_ENABLED(CONFIG_VBOOT_LAZY_VERIFY)
+#include <vboot/misc.h>
+#endif
 
 enum {
 	/* Last segment of program. Can be used to take different actions for
@@ -60,6 +63,10 @@ struct prog {
 	enum prog_type type;
 	const char *name;
 	struct region_device rdev;
+#if IS_ENABLED(CONFIG_VBOOT_LAZY_VERIFY)
+	/* Checks a program from a sealed vboot slot while it is loaded. */
+	struct vboot_hash_rdev hash;
+#endif
 	/* Entry to program with optional argument. It's up to the architecture
 	 * to decide if argument is passed. */
 	void (*entry)(void *);
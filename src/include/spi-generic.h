@@ -27,6 +27,22 @@
 #define SPI_READ_FLAG	0x01
 #define SPI_WRITE_FLAG	0x02
 
+/*
+ * Multi-I/O read modes, named by the number of lines used for
+ * opcode-address-data.
+ */
+#define SPI_MULTI_IO_1_1_2	(1 << 0)
+#define SPI_MULTI_IO_1_2_2	(1 << 1)
+#define SPI_MULTI_IO_1_1_4	(1 << 2)
+#define SPI_MULTI_IO_1_4_4	(1 << 3)
+
+/*
+ * Mode bits sent after the address. All ones keeps Winbond, Macronix,
+ * Spansion and Micron parts out of continuous read (XIP) mode, so every
+ * transfer has to start with an opcode.
+ */
+#define SPI_MULTI_IO_MODE_BITS	0xff
+
 /*-----------------------------------------------------------------------
  * Representation of a SPI slave, i.e. what we're communicating with.
  *
@@ -39,12 +55,15 @@
  *              read or write transaction, usually this is a controller
  *              property, kept in the slave structure for convenience. Zero in
  *              this field means 'unlimited'.
+ *   multi_io:	Mask of SPI_MULTI_IO_* read modes the controller supports
+ *              through spi_xfer_multi_io_read(). Zero for single I/O only.
  */
 struct spi_slave {
 	unsigned int	bus;
 	unsigned int	cs;
 	unsigned int	rw;
 	unsigned int	max_transfer_size;
+	unsigned int	multi_io;
 	int force_programmer_specific;
 	struct spi_flash * (*programmer_specific_probe) (struct spi_slave *spi);
 };
@@ -117,6 +136,39 @@ int  spi_xfer(struct spi_slave *slave, const void *dout, unsigned int bytesout,
 
 unsigned int spi_crop_chunk(unsigned int cmd_len, unsigned int buf_len);
 
+/*-----------------------------------------------------------------------
+ * Multi-I/O read transfer
+ *
+ * Send opcode, 3-byte address, mode bits and dummy cycles and read the data
+ * in one of the SPI_MULTI_IO_* modes. Only called for modes advertised in
+ * slave->multi_io. The bus is claimed by the caller.
+ *
+ *   slave:	The SPI slave
+ *   op:	Transfer description
+ *   din:	Pointer to the buffer that will be filled in.
+ *   bytesin:	How many bytes to read.
+ *
+ *   Returns: 0 on success, not 0 on failure
+ */
+struct spi_multi_io_read {
+	uint8_t opcode;
+	uint32_t addr;
+	/* One of SPI_MULTI_IO_*. */
+	unsigned int mode;
+	/*
+	 * Clocks for the mode byte after the address, sent on the address
+	 * lines. Either 0 or exactly one byte's worth.
+	 */
+	unsigned int mode_cycles;
+	uint8_t mode_bits;
+	/* Dummy clocks between the mode byte (or address) and data. */
+	unsigned int dummy_cycles;
+};
+
+int spi_xfer_multi_io_read(struct spi_slave *slave,
+			const struct spi_multi_io_read *op, void *din,
+			unsigned int bytesin);
+
 /*-----------------------------------------------------------------------
  * Write 8 bits, then read 8 bits.
  *   slave:	The SPI slave we're communicating with
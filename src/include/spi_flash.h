@@ -34,6 +34,14 @@ struct spi_flash {
 
 	u8		status_cmd;
 
+	/* Multi-I/O fast read discovered through SFDP, mode 0 if none. */
+	struct {
+		u8	opcode;
+		u8	mode;
+		u8	mode_cycles;
+		u8	dummy_cycles;
+	} multi_io_read;
+
 	/* All callbacks return 0 on success and != 0 on error. */
 	int		(*read)(struct spi_flash *flash, u32 offset,
 				size_t len, void *buf);
@@ -0,0 +1,76 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __TCPA_LOG_H__
+#define __TCPA_LOG_H__
+
+#include <stdint.h>
+
+/*
+ * Measured boot event log. Measurements are logged in the TCG PC Client
+ * format: TCG_PCClientPCREventStruct with SHA-1 digests for TPM 1.2 and
+ * TCG_PCR_EVENT2 with a single SHA-256 digest for TPM 2.0, the latter
+ * preceded by a Spec ID event. The log is kept in CBMEM_ID_TCPA_LOG and
+ * handed to the OS through the ACPI TCPA table and to the payload through
+ * the coreboot table.
+ */
+
+#if IS_ENABLED(CONFIG_TPM2)
+#define TCPA_DIGEST_SIZE	32
+#else
+#define TCPA_DIGEST_SIZE	20
+#endif
+
+/* TPM_ALG_ID of the digest in TPM 2.0 events */
+#define TCPA_ALG_SHA256		0x000b
+
+#define TCPA_EV_NO_ACTION	0x03
+#define TCPA_EV_COMPACT_HASH	0x0c
+
+#define TCPA_LOG_NAME_MAX	24
+
+/* Size of the log in CBMEM. */
+#define TCPA_CBMEM_LOG_SIZE	0x10000
+
+struct tcpa_event {
+	uint32_t pcr_index;
+	uint32_t event_type;
+#if IS_ENABLED(CONFIG_TPM2)
+	uint32_t digest_count;
+	uint16_t digest_alg;
+#endif
+	uint8_t digest[TCPA_DIGEST_SIZE];
+	uint32_t event_data_size;
+	uint8_t event_data[0];
+} __attribute__((packed));
+
+/* Events logged before CBMEM is up, kept in the TCPA_LOG region. */
+#define TCPA_PRERAM_LOG_MAGIC	0x4c504354	/* 'TCPL' */
+
+struct tcpa_preram_log {
+	uint32_t magic;
+	/* Bytes of events logged. */
+	uint16_t used;
+	uint8_t events[0];
+} __attribute__((packed));
+
+/* Start a new log, to be called when the TPM is started up. */
+void tcpa_log_init(void);
+/*
+ * Log a measurement of TCPA_DIGEST_SIZE bytes extended into the given PCR.
+ * Returns 0 on success, < 0 if it couldn't be logged.
+ */
+int tcpa_log_add(int pcr, uint32_t event_type, const uint8_t *digest,
+		 const char *name);
+
+#endif /* __TCPA_LOG_H__ */
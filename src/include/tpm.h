@@ -64,4 +64,15 @@ int tis_sendrecv(const u8 *sendbuf, size_t send_size, u8 *recvbuf,
 
 void init_tpm(int s3resume);
 
+/*
+ * tis_plat_irq_status()
+ *
+ * Check the TPM interrupt line, which the TPM raises when it is ready for
+ * the next transaction. Platforms wiring up the interrupt implement this,
+ * the default waits long enough for any transaction to complete.
+ *
+ * Returns 1 if the interrupt is pending and clears it, 0 otherwise.
+ */
+int tis_plat_irq_status(void);
+
 #endif /* TPM_H_ */
@@ -22,8 +22,10 @@
 #include <commonlib/compression.h>
 #include <endian.h>
 #include <lib.h>
+#include <rules.h>
 #include <symbols.h>
 #include <timestamp.h>
+#include <vboot/misc.h>
 
 #include "fmap_config.h"
 
@@ -35,7 +37,8 @@
 #define DEBUG(x...)
 #endif
 
-int cbfs_boot_locate(struct cbfsf *fh, const char *name, uint32_t *type)
+int cbfs_boot_locate_unchecked(struct cbfsf *fh, const char *name,
+				uint32_t *type)
 {
 	struct region_device rdev;
 	const struct region_device *boot_dev;
@@ -56,6 +59,18 @@ int cbfs_boot_locate(struct cbfsf *fh, const char *name, uint32_t *type)
 	return cbfs_locate(fh, &rdev, name, type);
 }
 
+int cbfs_boot_locate(struct cbfsf *fh, const char *name, uint32_t *type)
+{
+	if (cbfs_boot_locate_unchecked(fh, name, type))
+		return -1;
+
+	if (IS_ENABLED(CONFIG_VBOOT_LAZY_VERIFY) && !ENV_SMM &&
+	    vboot_check_cbfs_file(fh))
+		return -1;
+
+	return 0;
+}
+
 void *cbfs_boot_map_with_leak(const char *name, uint32_t type, size_t *size)
 {
 	struct cbfsf fh;
@@ -94,6 +109,8 @@ size_t cbfs_load_and_decompress(const struct region_device *rdev, size_t offset,
 		 * area for in-place decompression. It is the responsibility of
 		 * the caller to ensure that buffer_size is large enough
 		 * (see compression.h, guaranteed by cbfstool for stages). */
+		if (buffer_size < in_size)
+			return 0;
 		void *compr_start = buffer + buffer_size - in_size;
 		if (rdev_readat(rdev, compr_start, offset, in_size) != in_size)
 			return 0;
@@ -171,19 +188,28 @@ void *cbfs_boot_load_stage_by_name(const char *name)
 size_t cbfs_boot_load_struct(const char *name, void *buf, size_t buf_size)
 {
 	struct cbfsf fh;
+	struct vboot_hash_rdev hrdev;
+	const struct region_device *data = &fh.data;
 	uint32_t compression_algo;
 	size_t decompressed_size;
 	uint32_t type = CBFS_TYPE_STRUCT;
 
-	if (cbfs_boot_locate(&fh, name, &type) < 0)
+	if (cbfs_boot_locate_unchecked(&fh, name, &type) < 0)
 		return 0;
 
+	/* Files of a sealed vboot slot are checked while they are loaded. */
+	if (IS_ENABLED(CONFIG_VBOOT_LAZY_VERIFY) && !ENV_SMM) {
+		if (vboot_hash_rdev_init(&hrdev, &fh))
+			return 0;
+		data = &hrdev.rdev;
+	}
+
 	if (cbfsf_decompression_info(&fh, &compression_algo,
 				     &decompressed_size) < 0
 				     || decompressed_size > buf_size)
 		return 0;
 
-	return cbfs_load_and_decompress(&fh.data, 0, region_device_sz(&fh.data),
+	return cbfs_load_and_decompress(data, 0, region_device_sz(data),
 					buf, buf_size, compression_algo);
 }
 
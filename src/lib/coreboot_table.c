@@ -317,7 +317,8 @@ static void add_cbmem_pointers(struct lb_header *header)
 		{CBMEM_ID_CONSOLE, LB_TAG_CBMEM_CONSOLE},
 		{CBMEM_ID_ACPI_GNVS, LB_TAG_ACPI_GNVS},
 		{CBMEM_ID_VPD, LB_TAG_VPD},
-		{CBMEM_ID_WIFI_CALIBRATION, LB_TAG_WIFI_CALIBRATION}
+		{CBMEM_ID_WIFI_CALIBRATION, LB_TAG_WIFI_CALIBRATION},
+		{CBMEM_ID_TCPA_LOG, LB_TAG_TCPA_LOG}
 	};
 	int i;
 
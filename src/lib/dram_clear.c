@@ -0,0 +1,236 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <bootmem.h>
+#include <bootstate.h>
+#include <console/console.h>
+#include <dram_clear.h>
+#include <memrange.h>
+#include <smp/spinlock.h>
+#include <string.h>
+#include <symbols.h>
+#include <timer.h>
+#include <timestamp.h>
+#if IS_ENABLED(CONFIG_HAVE_ACPI_RESUME)
+#include <arch/acpi.h>
+#endif
+
+/* Amount of memory a CPU claims at a time. */
+#define DRAM_CLEAR_CHUNK_SIZE (64 * MiB)
+
+/*
+ * Work is handed out in chunks from a single cursor into the range list so
+ * that CPUs finishing early just pick up more work.
+ */
+static struct {
+	const struct range_entry *r;
+	resource_t next;
+	int failed;
+} cursor;
+
+DECLARE_SPIN_LOCK(dram_clear_lock)
+
+/* Regions dram_clear_usable_ram() leaves alone, not all boards have them. */
+extern u8 _heap[], _eheap[];
+DECLARE_OPTIONAL_REGION(stack);
+DECLARE_OPTIONAL_REGION(heap);
+DECLARE_OPTIONAL_REGION(pagetables);
+DECLARE_OPTIONAL_REGION(ttb);
+DECLARE_OPTIONAL_REGION(ttb_subtables);
+DECLARE_OPTIONAL_REGION(dma_coherent);
+DECLARE_OPTIONAL_REGION(cbfs_cache);
+DECLARE_OPTIONAL_REGION(postram_cbfs_cache);
+DECLARE_OPTIONAL_REGION(framebuffer);
+DECLARE_OPTIONAL_REGION(timestamp);
+DECLARE_OPTIONAL_REGION(preram_cbmem_console);
+DECLARE_OPTIONAL_REGION(tcpa_log);
+
+int __attribute__((weak)) arch_dram_clear(uint64_t base, uint64_t size)
+{
+	if (base + size - 1 > (uintptr_t)-1) {
+		printk(BIOS_ERR, "DRAM clear: can't address %llx-%llx\n",
+			base, base + size - 1);
+		return -1;
+	}
+
+	memset((void *)(uintptr_t)base, 0, size);
+
+	return 0;
+}
+
+int __attribute__((weak)) arch_dram_clear_run_parallel(void (*work)(void))
+{
+	return -1;
+}
+
+static int dram_clear_next_chunk(uint64_t *base, uint64_t *size)
+{
+	int found = 0;
+
+	spin_lock(&dram_clear_lock);
+
+	while (cursor.r != NULL) {
+		resource_t end = range_entry_end(cursor.r);
+
+		if (cursor.next < end) {
+			*base = cursor.next;
+			*size = MIN(end - cursor.next, DRAM_CLEAR_CHUNK_SIZE);
+			cursor.next += *size;
+			found = 1;
+			break;
+		}
+
+		cursor.r = cursor.r->next;
+		if (cursor.r != NULL)
+			cursor.next = range_entry_base(cursor.r);
+	}
+
+	spin_unlock(&dram_clear_lock);
+
+	return found;
+}
+
+static void dram_clear_work(void)
+{
+	uint64_t base;
+	uint64_t size;
+
+	while (dram_clear_next_chunk(&base, &size)) {
+		if (arch_dram_clear(base, size) < 0) {
+			spin_lock(&dram_clear_lock);
+			cursor.failed = 1;
+			spin_unlock(&dram_clear_lock);
+		}
+	}
+}
+
+int dram_clear_ranges(const struct memranges *ranges)
+{
+	const struct range_entry *r;
+	struct stopwatch sw;
+	uint64_t total = 0;
+	long usecs;
+	int parallel;
+
+	memranges_each_entry(r, ranges)
+		total += range_entry_size(r);
+
+	if (total == 0)
+		return 0;
+
+	printk(BIOS_DEBUG, "DRAM clear: %llu MiB\n", total / MiB);
+
+	timestamp_add_now(TS_START_DRAM_CLEAR);
+	stopwatch_init(&sw);
+
+	cursor.r = ranges->entries;
+	cursor.next = range_entry_base(cursor.r);
+	cursor.failed = 0;
+
+	parallel = IS_ENABLED(CONFIG_DRAM_CLEAR_PARALLEL) &&
+			arch_dram_clear_run_parallel(dram_clear_work) == 0;
+
+	/* Pick up anything left over, e.g. when running in parallel failed. */
+	dram_clear_work();
+
+	usecs = stopwatch_duration_usecs(&sw);
+	timestamp_add_now(TS_END_DRAM_CLEAR);
+
+	if (cursor.failed) {
+		printk(BIOS_ERR, "DRAM clear: failed, memory left uncleared\n");
+		return -1;
+	}
+
+	if (usecs > 0) {
+		/* Report in units of MiB/s to keep the math in 64 bits. */
+		uint64_t mibps = total / MiB * USECS_PER_SEC / usecs;
+
+		printk(BIOS_INFO, "DRAM clear: %ld ms, %llu.%02llu GiB/s%s\n",
+			usecs / USECS_PER_MSEC, mibps / 1024,
+			(mibps % 1024) * 100 / 1024,
+			parallel ? " (all CPUs)" : "");
+	}
+
+	return 0;
+}
+
+static bool add_usable_range(const struct range_entry *r, void *arg)
+{
+	struct memranges *ranges = arg;
+
+	if (range_entry_tag(r) == LB_MEM_RAM)
+		memranges_insert(ranges, range_entry_base(r),
+				range_entry_size(r), LB_MEM_RAM);
+
+	return true;
+}
+
+static void exclude_region(struct memranges *ranges, const u8 *start,
+			   const u8 *end)
+{
+	if (end > start)
+		memranges_create_hole(ranges, (uintptr_t)start, end - start);
+}
+
+int dram_clear_usable_ram(void)
+{
+	struct memranges ranges;
+	int ret;
+
+	memranges_init_empty(&ranges, NULL, 0);
+	bootmem_walk(add_usable_range, &ranges);
+
+	/*
+	 * Leave the running stage alone, as well as the memlayout regions
+	 * that may live outside of it and are still in use. Not all of them
+	 * are in DRAM, holes outside of the ranges don't matter.
+	 */
+	exclude_region(&ranges, _program, _eprogram);
+	exclude_region(&ranges, _stack, _estack);
+	exclude_region(&ranges, _heap, _eheap);
+	exclude_region(&ranges, _pagetables, _epagetables);
+	exclude_region(&ranges, _ttb, _ettb);
+	exclude_region(&ranges, _ttb_subtables, _ettb_subtables);
+	exclude_region(&ranges, _dma_coherent, _edma_coherent);
+	exclude_region(&ranges, _cbfs_cache, _ecbfs_cache);
+	exclude_region(&ranges, _postram_cbfs_cache, _epostram_cbfs_cache);
+	exclude_region(&ranges, _framebuffer, _eframebuffer);
+	exclude_region(&ranges, _timestamp, _etimestamp);
+	exclude_region(&ranges, _preram_cbmem_console,
+		       _epreram_cbmem_console);
+	exclude_region(&ranges, _tcpa_log, _etcpa_log);
+
+	ret = dram_clear_ranges(&ranges);
+
+	memranges_teardown(&ranges);
+
+	return ret;
+}
+
+static void clear_usable_ram(void *unused)
+{
+	if (!IS_ENABLED(CONFIG_DRAM_CLEAR_USABLE_RAM))
+		return;
+
+#if IS_ENABLED(CONFIG_HAVE_ACPI_RESUME)
+	/* Don't wipe the OS when falling through from a failed resume. */
+	if (acpi_is_wakeup_s3())
+		return;
+#endif
+
+	/* Don't hand memory that was meant to be scrubbed to the payload. */
+	if (dram_clear_usable_ram() < 0)
+		die("DRAM clear failed!\n");
+}
+
+BOOT_STATE_INIT_ENTRY(BS_WRITE_TABLES, BS_ON_EXIT, clear_usable_ram, NULL);
@@ -17,6 +17,7 @@
 #include <cbmem.h>
 #include <console/console.h>
 #include <imd.h>
+#include <lib.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -52,7 +53,23 @@ struct imd_root {
 	struct imd_entry entries[0];
 } __attribute__((packed));
 
+/*
+ * Optional open-addressed id to entry index table. It lives in the root
+ * region right after entries[max_entries] and is only consulted when
+ * IMD_FLAG_INDEXED is set and the version matches. Parsers unaware of the
+ * index only see a smaller max_entries.
+ */
+struct imd_index {
+	uint16_t version;
+	uint16_t num_slots;
+	/* Entry index + 1 for each slot. 0 marks an empty slot. */
+	uint16_t slots[0];
+} __attribute__((packed));
+
 #define IMD_FLAG_LOCKED 1
+#define IMD_FLAG_INDEXED 2
+
+#define IMD_INDEX_VERSION 1
 
 static void *relative_pointer(void *base, ssize_t offset)
 {
@@ -95,7 +112,7 @@ static struct imd_entry *root_last_entry(struct imd_root *r)
 	return &r->entries[r->num_entries - 1];
 }
 
-static size_t root_num_entries(size_t root_size)
+static size_t root_entries_size(size_t root_size)
 {
 	size_t entries_size;
 
@@ -103,9 +120,127 @@ static size_t root_num_entries(size_t root_size)
 	entries_size -= sizeof(struct imd_root_pointer);
 	entries_size -= sizeof(struct imd_root);
 
+	return entries_size;
+}
+
+/*
+ * Number of index slots to use for a root of root_size. The slot count is
+ * the power of 2 at or below twice the number of entries that fit alongside
+ * the index. 0 is returned when not indexing.
+ */
+static size_t root_num_index_slots(size_t root_size)
+{
+	const size_t cost = sizeof(uint16_t) * 2 + sizeof(struct imd_entry);
+	size_t entries_size;
+	size_t slots;
+
+	if (!IS_ENABLED(CONFIG_IMD_INDEX))
+		return 0;
+
+	entries_size = root_entries_size(root_size);
+	if (entries_size < sizeof(struct imd_index) + cost * 2)
+		return 0;
+
+	/* Roots don't exceed LIMIT_ALIGN so this fits in num_slots. */
+	slots = (entries_size - sizeof(struct imd_index)) * 2 / cost;
+	slots = 1 << log2(slots);
+
+	return slots;
+}
+
+static size_t root_num_entries(size_t root_size)
+{
+	size_t entries_size;
+	size_t slots;
+
+	entries_size = root_entries_size(root_size);
+	slots = root_num_index_slots(root_size);
+
+	if (slots != 0) {
+		entries_size -= sizeof(struct imd_index);
+		entries_size -= slots * sizeof(uint16_t);
+		/* Always leave an empty slot to terminate probing. */
+		return MIN(entries_size / sizeof(struct imd_entry), slots - 1);
+	}
+
 	return entries_size / sizeof(struct imd_entry);
 }
 
+static struct imd_index *imd_root_index(const struct imd_root *r)
+{
+	struct imd_index *index;
+
+	if (!IS_ENABLED(CONFIG_IMD_INDEX) || !(r->flags & IMD_FLAG_INDEXED))
+		return NULL;
+
+	index = (struct imd_index *)&r->entries[r->max_entries];
+
+	if (index->version != IMD_INDEX_VERSION)
+		return NULL;
+
+	return index;
+}
+
+static size_t imd_index_hash(const struct imd_index *index, uint32_t id)
+{
+	uint32_t hash;
+
+	/* Multiplicative hash. Fold in the upper bits for small tables. */
+	hash = id * 0x9e3779b1;
+	hash ^= hash >> 16;
+
+	return hash & (index->num_slots - 1);
+}
+
+static void imd_index_insert(struct imd_index *index, const struct imd_root *r,
+				size_t entry_idx)
+{
+	size_t slot;
+
+	slot = imd_index_hash(index, r->entries[entry_idx].id);
+
+	while (index->slots[slot] != 0)
+		slot = (slot + 1) & (index->num_slots - 1);
+
+	index->slots[slot] = entry_idx + 1;
+}
+
+static void imd_index_rebuild(struct imd_index *index, const struct imd_root *r)
+{
+	size_t i;
+
+	memset(index->slots, 0, index->num_slots * sizeof(index->slots[0]));
+
+	/* Skip first entry covering the root. */
+	for (i = 1; i < r->num_entries; i++)
+		imd_index_insert(index, r, i);
+}
+
+static struct imd_entry *imd_index_find(const struct imd_index *index,
+					struct imd_root *r, uint32_t id)
+{
+	size_t slot;
+	size_t n;
+
+	slot = imd_index_hash(index, id);
+
+	for (n = 0; n < index->num_slots; n++) {
+		size_t entry_idx = index->slots[slot];
+
+		if (entry_idx == 0)
+			break;
+		entry_idx--;
+
+		/* Entries are inserted in order so the first match wins. */
+		if (entry_idx < r->num_entries && r->entries[entry_idx].id == id)
+			return &r->entries[entry_idx];
+
+		slot = (slot + 1) & (index->num_slots - 1);
+	}
+
+	return NULL;
+}
+
 static size_t imd_root_data_left(struct imd_root *r)
 {
 	struct imd_entry *last_entry;
@@ -188,6 +323,18 @@ static int imdr_create_empty(struct imdr *imdr, size_t root_size,
 	/* Calculate size left for entries. */
 	r->max_entries = root_num_entries(root_size);
 
+	/* The index sits between the entries and the root pointer. */
+	if (root_num_index_slots(root_size) != 0) {
+		struct imd_index *index;
+
+		index = (struct imd_index *)&r->entries[r->max_entries];
+		index->version = IMD_INDEX_VERSION;
+		index->num_slots = root_num_index_slots(root_size);
+		memset(index->slots, 0,
+			index->num_slots * sizeof(index->slots[0]));
+		r->flags |= IMD_FLAG_INDEXED;
+	}
+
 	/* Fill in first entry covering the root region. */
 	r->num_entries = 1;
 	e = &r->entries[0];
@@ -248,6 +395,16 @@ static int imdr_recover(struct imdr *imdr)
 			return -1;
 	}
 
+	/* Don't trust an index which doesn't fit below the root pointer. */
+	if (r->flags & IMD_FLAG_INDEXED) {
+		struct imd_index *index = imd_root_index(r);
+
+		if (index == NULL || !IS_POWER_OF_2(index->num_slots) ||
+		    index->num_slots <= r->num_entries ||
+		    (uintptr_t)&index->slots[index->num_slots] > (uintptr_t)rp)
+			r->flags &= ~IMD_FLAG_INDEXED;
+	}
+
 	/* Set root pointer. */
 	imdr->r = r;
 
@@ -257,6 +414,7 @@ static int imdr_recover(struct imdr *imdr)
 static const struct imd_entry *imdr_entry_find(const struct imdr *imdr,
 						uint32_t id)
 {
+	struct imd_index *index;
 	struct imd_root *r;
 	struct imd_entry *e;
 	size_t i;
@@ -266,6 +424,10 @@ static const struct imd_entry *imdr_entry_find(const struct imdr *imdr,
 	if (r == NULL)
 		return NULL;
 
+	index = imd_root_index(r);
+	if (index != NULL)
+		return imd_index_find(index, r, id);
+
 	e = NULL;
 	/* Skip first entry covering the root. */
 	for (i = 1; i < r->num_entries; i++) {
@@ -316,6 +478,7 @@ static void *imdr_entry_at(const struct imdr *imdr, const struct imd_entry *e)
 static struct imd_entry *imd_entry_add_to_root(struct imd_root *r, uint32_t id,
 						size_t size)
 {
+	struct imd_index *index;
 	struct imd_entry *entry;
 	struct imd_entry *last_entry;
 	ssize_t e_offset;
@@ -346,6 +509,10 @@ static struct imd_entry *imd_entry_add_to_root(struct imd_root *r, uint32_t id,
 
 	imd_entry_assign(entry, id, e_offset, size);
 
+	index = imd_root_index(r);
+	if (index != NULL)
+		imd_index_insert(index, r, r->num_entries - 1);
+
 	return entry;
 }
 
@@ -651,6 +818,10 @@ int imd_entry_remove(const struct imd *imd, const struct imd_entry *entry)
 
 	r->num_entries--;
 
+	/* Removal is rare. Rebuild instead of supporting deletion in place. */
+	if (imd_root_index(r) != NULL)
+		imd_index_rebuild(imd_root_index(r), r);
+
 	return 0;
 }
 
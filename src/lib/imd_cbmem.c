@@ -50,6 +50,62 @@ static inline struct imd *cbmem_get_imd(void)
 	return NULL;
 }
 
+/*
+ * Stages which keep the imd in a global also remember the most recent
+ * successful lookups. Entries never move so a remembered entry stays valid
+ * until it is removed or CBMEM is initialized again.
+ */
+#define CBMEM_FIND_MEMO_SIZE 4
+
+struct cbmem_find_memo {
+	u32 id;
+	const struct imd_entry *e;
+};
+
+static inline struct cbmem_find_memo *cbmem_get_memo(void)
+{
+	if (CAN_USE_GLOBALS) {
+		static struct cbmem_find_memo memo[CBMEM_FIND_MEMO_SIZE];
+		return memo;
+	}
+	return NULL;
+}
+
+static void cbmem_memo_flush(void)
+{
+	struct cbmem_find_memo *memo = cbmem_get_memo();
+
+	if (memo != NULL)
+		memset(memo, 0, sizeof(*memo) * CBMEM_FIND_MEMO_SIZE);
+}
+
+static const struct imd_entry *cbmem_imd_find(const struct imd *imd, u32 id)
+{
+	struct cbmem_find_memo *memo = cbmem_get_memo();
+	const struct imd_entry *e;
+	size_t i;
+
+	if (memo == NULL)
+		return imd_entry_find(imd, id);
+
+	for (i = 0; i < CBMEM_FIND_MEMO_SIZE; i++) {
+		if (memo[i].e != NULL && memo[i].id == id)
+			return memo[i].e;
+	}
+
+	e = imd_entry_find(imd, id);
+
+	/* Most recent lookup goes first, evicting the oldest one. */
+	if (e != NULL) {
+		memmove(&memo[1], &memo[0],
+			sizeof(*memo) * (CBMEM_FIND_MEMO_SIZE - 1));
+		memo[0].id = id;
+		memo[0].e = e;
+	}
+
+	return e;
+}
+
 static inline const struct cbmem_entry *imd_to_cbmem(const struct imd_entry *e)
 {
 	return (const struct cbmem_entry *)e;
@@ -114,6 +170,7 @@ void cbmem_initialize_empty_id_size(u32 id, u64 size)
 
 	imd = imd_init_backing(&imd_backing);
 	imd_handle_init(imd, cbmem_top());
+	cbmem_memo_flush();
 
 	printk(BIOS_DEBUG, "CBMEM:\n");
 
@@ -151,6 +208,7 @@ int cbmem_initialize_id_size(u32 id, u64 size)
 
 	imd = imd_init_backing(&imd_backing);
 	imd_handle_init(imd, cbmem_top());
+	cbmem_memo_flush();
 
 	if (imd_recover(imd))
 		return 1;
@@ -223,7 +281,7 @@ const struct cbmem_entry *cbmem_entry_find(u32 id)
 
 	imd = imd_init_backing_with_recover(&imd_backing);
 
-	e = imd_entry_find(imd, id);
+	e = cbmem_imd_find(imd, id);
 
 	return imd_to_cbmem(e);
 }
@@ -236,7 +294,7 @@ void *cbmem_find(u32 id)
 
 	imd = imd_init_backing_with_recover(&imd_backing);
 
-	e = imd_entry_find(imd, id);
+	e = cbmem_imd_find(imd, id);
 
 	if (e == NULL)
 		return NULL;
@@ -252,6 +310,7 @@ int cbmem_entry_remove(const struct cbmem_entry *entry)
 	struct imd imd_backing;
 
 	imd = imd_init_backing_with_recover(&imd_backing);
+	cbmem_memo_flush();
 
 	return imd_entry_remove(imd, cbmem_to_imd(entry));
 }
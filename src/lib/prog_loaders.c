@@ -40,10 +40,19 @@ int prog_locate(struct prog *prog)
 
 	cbfs_prepare_program_locate();
 
-	if (cbfs_boot_locate(&file, prog_name(prog), NULL))
+	if (cbfs_boot_locate_unchecked(&file, prog_name(prog), NULL))
 		return -1;
 
+#if IS_ENABLED(CONFIG_VBOOT_LAZY_VERIFY)
+	/* Programs from a sealed vboot slot are checked as they are loaded. */
+	if (vboot_hash_rdev_init(&prog->hash, &file))
+		return -1;
+
+	rdev_chain(prog_rdev(prog), &prog->hash.rdev, 0,
+		   region_device_sz(&prog->hash.rdev));
+#else
 	cbfs_file_data(prog_rdev(prog), &file);
+#endif
 
 	return 0;
 }
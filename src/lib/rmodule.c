@@ -22,6 +22,7 @@
 #include <console/console.h>
 #include <program_loading.h>
 #include <rmodule.h>
+#include <vboot/misc.h>
 
 /* Change this define to get more verbose debugging for module loading. */
 #define PK_ADJ_LEVEL BIOS_NEVER
@@ -265,7 +266,15 @@ int rmodule_stage_load(struct rmod_stage_load *rsl)
 
 	fh = prog_rdev(rsl->prog);
 
-	if (rdev_readat(fh, &stage, 0, sizeof(stage)) != sizeof(stage))
+	/*
+	 * The header only sizes the cbmem region. A stage from a sealed vboot
+	 * slot is checked while the rest of it is loaded below.
+	 */
+	if (IS_ENABLED(CONFIG_VBOOT_LAZY_VERIFY)) {
+		if (vboot_hash_rdev_readat_early(fh, &stage, 0,
+						 sizeof(stage)) != sizeof(stage))
+			return -1;
+	} else if (rdev_readat(fh, &stage, 0, sizeof(stage)) != sizeof(stage))
 		return -1;
 
 	rmodule_offset =
@@ -274,8 +283,12 @@ int rmodule_stage_load(struct rmod_stage_load *rsl)
 
 	stage_region = cbmem_add(rsl->cbmem_id, region_size);
 
-	if (stage_region == NULL)
+	if (stage_region == NULL) {
+		/* Make sure a corrupted header ends up in recovery mode. */
+		if (IS_ENABLED(CONFIG_VBOOT_LAZY_VERIFY))
+			vboot_hash_rdev_check(fh);
 		return -1;
+	}
 
 	rmod_loc = &stage_region[rmodule_offset];
 
@@ -0,0 +1,80 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Measurements are taken before DRAM is up, so they are logged to the
+ * pre-RAM TCPA_LOG region and copied into CBMEM once it comes online, see
+ * tcpa_log_cbmem.c.
+ */
+
+#include <console/console.h>
+#include <string.h>
+#include <symbols.h>
+#include <tcpa_log.h>
+
+DECLARE_OPTIONAL_REGION(tcpa_log);
+
+static struct tcpa_preram_log *tcpa_preram_log(void)
+{
+	struct tcpa_preram_log *log = (void *)_tcpa_log;
+
+	if (_tcpa_log_size < sizeof(*log) || log->magic != TCPA_PRERAM_LOG_MAGIC)
+		return NULL;
+
+	return log;
+}
+
+void tcpa_log_init(void)
+{
+	struct tcpa_preram_log *log = (void *)_tcpa_log;
+
+	if (_tcpa_log_size < sizeof(*log))
+		return;
+
+	log->magic = TCPA_PRERAM_LOG_MAGIC;
+	log->used = 0;
+}
+
+int tcpa_log_add(int pcr, uint32_t event_type, const uint8_t *digest,
+		 const char *name)
+{
+	struct tcpa_preram_log *log = tcpa_preram_log();
+	struct tcpa_event *event;
+	size_t name_len = strnlen(name, TCPA_LOG_NAME_MAX);
+
+	if (log == NULL) {
+		printk(BIOS_ERR, "TCPA: No log for %s\n", name);
+		return -1;
+	}
+
+	if (sizeof(*log) + log->used + sizeof(*event) + name_len >
+	    _tcpa_log_size) {
+		printk(BIOS_ERR, "TCPA: Log full, dropping %s\n", name);
+		return -1;
+	}
+
+	event = (void *)&log->events[log->used];
+	event->pcr_index = pcr;
+	event->event_type = event_type;
+#if IS_ENABLED(CONFIG_TPM2)
+	event->digest_count = 1;
+	event->digest_alg = TCPA_ALG_SHA256;
+#endif
+	memcpy(event->digest, digest, TCPA_DIGEST_SIZE);
+	event->event_data_size = name_len;
+	memcpy(event->event_data, name, name_len);
+
+	log->used += sizeof(*event) + name_len;
+
+	return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <cbmem.h>
+#include <console/console.h>
+#include <stddef.h>
+#include <string.h>
+#include <symbols.h>
+#include <tcpa_log.h>
+
+DECLARE_OPTIONAL_REGION(tcpa_log);
+
+/* Leading event of a TPM 2.0 log, in the TPM 1.2 event format. */
+struct tcpa_spec_id_event {
+	uint32_t pcr_index;
+	uint32_t event_type;
+	uint8_t digest[20];
+	uint32_t event_data_size;
+	/* TCG_EfiSpecIDEventStruct */
+	uint8_t signature[16];
+	uint32_t platform_class;
+	uint8_t spec_version_minor;
+	uint8_t spec_version_major;
+	uint8_t spec_errata;
+	uint8_t uintn_size;
+	uint32_t num_algorithms;
+	uint16_t algorithm_id;
+	uint16_t digest_size;
+	uint8_t vendor_info_size;
+} __attribute__((packed));
+
+static void tcpa_log_start(void *log)
+{
+	struct tcpa_spec_id_event *spec_id = log;
+
+	if (!IS_ENABLED(CONFIG_TPM2))
+		return;
+
+	spec_id->event_type = TCPA_EV_NO_ACTION;
+	spec_id->event_data_size = sizeof(*spec_id) -
+		offsetof(struct tcpa_spec_id_event, signature);
+	memcpy(spec_id->signature, "Spec ID Event03", 16);
+	spec_id->spec_version_major = 2;
+	/* UINT32 */
+	spec_id->uintn_size = 1;
+	spec_id->num_algorithms = 1;
+	spec_id->algorithm_id = TCPA_ALG_SHA256;
+	spec_id->digest_size = TCPA_DIGEST_SIZE;
+}
+
+/* Find the end of the events in a log, the rest of it is zeroed. */
+static size_t tcpa_log_end(const uint8_t *log, size_t size)
+{
+	size_t offset = 0;
+
+	if (IS_ENABLED(CONFIG_TPM2))
+		offset = sizeof(struct tcpa_spec_id_event);
+
+	while (offset + sizeof(struct tcpa_event) <= size) {
+		const struct tcpa_event *event = (void *)&log[offset];
+
+		if (event->event_type == 0)
+			break;
+
+		offset += sizeof(*event) + event->event_data_size;
+	}
+
+	return offset;
+}
+
+static void tcpa_log_sync_to_cbmem(int is_recovery)
+{
+	struct tcpa_preram_log *preram = (void *)_tcpa_log;
+	const struct cbmem_entry *ce;
+	uint8_t *log;
+	size_t size;
+	size_t end;
+
+	if (_tcpa_log_size < sizeof(*preram) ||
+	    preram->magic != TCPA_PRERAM_LOG_MAGIC)
+		return;
+
+	/* Keep appending to the log across S3 resume, as do the PCRs. */
+	ce = cbmem_entry_find(CBMEM_ID_TCPA_LOG);
+	if (ce != NULL) {
+		log = cbmem_entry_start(ce);
+		size = cbmem_entry_size(ce);
+	} else {
+		size = TCPA_CBMEM_LOG_SIZE;
+		log = cbmem_add(CBMEM_ID_TCPA_LOG, size);
+		if (log == NULL) {
+			printk(BIOS_ERR, "TCPA log creation failed\n");
+			return;
+		}
+		memset(log, 0, size);
+		tcpa_log_start(log);
+	}
+
+	end = tcpa_log_end(log, size);
+	if (end + preram->used > size) {
+		printk(BIOS_ERR, "TCPA log full\n");
+		return;
+	}
+
+	memcpy(&log[end], preram->events, preram->used);
+}
+
+ROMSTAGE_CBMEM_INIT_HOOK(tcpa_log_sync_to_cbmem)
@@ -187,6 +187,9 @@ typedef struct ramctr_timing_st {
 	struct ram_rank_timings timings[NUM_CHANNELS][NUM_SLOTRANKS];
 
 	dimm_info info;
+
+	/* Raw SPDs, reused by read_spd() if the DIMMs didn't change */
+	spd_raw_data spd[NUM_CHANNELS * NUM_SLOTS];
 } ramctr_timing;
 
 #define SOUTHBRIDGE PCI_DEV(0, 0x1f, 0)
@@ -357,11 +360,36 @@ static int verify_crc16_spds_ddr3(spd_raw_data *spd, ramctr_timing *ctrl)
 	return match;
 }
 
+static int spd_smbus_read_byte(const struct spd_bus *bus, u8 addr, u8 offset)
+{
+	return do_smbus_read_byte(SMBUS_IO_BASE, addr, offset);
+}
+
+static int spd_smbus_read_block(const struct spd_bus *bus, u8 addr, u8 offset,
+				u8 *buf, size_t len)
+{
+	return smbus_i2c_block_read(addr, offset, len, buf);
+}
+
+static const struct spd_bus spd_smbus = {
+	.read_byte = spd_smbus_read_byte,
+	.read_block = spd_smbus_read_block,
+};
+
 void read_spd(spd_raw_data * spd, u8 addr)
 {
-	int j;
-	for (j = 0; j < 256; j++)
-		(*spd)[j] = do_smbus_read_byte(SMBUS_IO_BASE, addr, j);
+	struct mrc_data_container *mrc_cache;
+	const ramctr_timing *ctrl_cached;
+
+	/* Skip the full read for DIMMs whose SPD is in the MRC cache */
+	mrc_cache = find_current_mrc_cache();
+	if (mrc_cache && mrc_cache->mrc_data_size >= sizeof(*ctrl_cached)) {
+		ctrl_cached = (const ramctr_timing *)mrc_cache->mrc_data;
+		spd_read_ddr3_cached(&spd_smbus, addr, *spd, ctrl_cached->spd,
+				     ARRAY_SIZE(ctrl_cached->spd));
+	} else {
+		spd_read_ddr3(&spd_smbus, addr, *spd);
+	}
 }
 
 static void dram_find_spds_ddr3(spd_raw_data *spd, ramctr_timing *ctrl)
@@ -371,6 +399,7 @@ static void dram_find_spds_ddr3(spd_raw_data *spd, ramctr_timing *ctrl)
 	dimm_info *dimm = &ctrl->info;
 
 	memset (ctrl->rankmap, 0, sizeof(ctrl->rankmap));
+	memcpy(ctrl->spd, spd, sizeof(ctrl->spd));
 
 	ctrl->extended_temperature_range = 1;
 	ctrl->auto_self_refresh = 1;
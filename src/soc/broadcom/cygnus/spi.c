@@ -49,6 +49,29 @@
 /* BSPI registers */
 #define BSPI_MAST_N_BOOT_CTRL_REG	0x008
 #define BSPI_BUSY_STATUS_REG		0x00c
+#define BSPI_B0_CTRL_REG		0x018
+#define BSPI_B1_CTRL_REG		0x020
+#define BSPI_FLEX_MODE_ENABLE_REG	0x028
+#define BSPI_BITS_PER_CYCLE_REG		0x02c
+#define BSPI_BITS_PER_PHASE_REG		0x030
+#define BSPI_CMD_AND_MODE_BYTE_REG	0x034
+
+/* BSPI read-ahead FIFO registers */
+#define BSPI_RAF_START_ADDR_REG		0x100
+#define BSPI_RAF_NUM_WORDS_REG		0x104
+#define BSPI_RAF_CTRL_REG		0x108
+#define BSPI_RAF_WATERMARK_REG		0x110
+#define BSPI_RAF_STATUS_REG		0x114
+#define BSPI_RAF_READ_DATA_REG		0x118
+
+#define BSPI_BPC_DATA_SHIFT		0
+#define BSPI_BPC_ADDR_SHIFT		8
+#define BSPI_BPC_MODE_SHIFT		16
+#define BSPI_BPP_MODE_SELECT		(1 << 8)
+#define BSPI_RAF_CTRL_START		(1 << 0)
+#define BSPI_RAF_CTRL_CLEAR		(1 << 1)
+#define BSPI_RAF_STATUS_EMPTY		(1 << 1)
+#define BSPI_RAF_MAX_WORDS		64
 
 /* MSPI registers */
 #define MSPI_SPCR0_LSB_REG		0x200
@@ -109,6 +132,8 @@ struct spi_slave *spi_setup_slave(unsigned int bus, unsigned int cs)
 	priv->reg = (void *)(IPROC_QSPI_BASE);
 	priv->mspi_enabled = 0;
 	priv->bus_claimed = 0;
+	priv->slave.multi_io = SPI_MULTI_IO_1_1_2 | SPI_MULTI_IO_1_2_2 |
+			       SPI_MULTI_IO_1_1_4 | SPI_MULTI_IO_1_4_4;
 
 	/* MSPI: Basic hardware initialization */
 	REG_WR(priv->reg + MSPI_SPCR1_LSB_REG, 0);
@@ -311,6 +336,152 @@ int spi_xfer(struct spi_slave *slave, const void *dout, unsigned int bytesout,
 	return 0;
 }
 
+/* Bus width encoding for the BSPI bits-per-cycle fields. */
+static u32 bspi_width(unsigned int lines)
+{
+	return lines == 4 ? 2 : lines - 1;
+}
+
+static void bspi_enable(struct qspi_priv *priv)
+{
+	if ((REG_RD(priv->reg + BSPI_MAST_N_BOOT_CTRL_REG) & 1) == 0)
+		return;
+
+	/* Prefetched data may be from before an erase or write over MSPI. */
+	REG_WR(priv->reg + BSPI_B0_CTRL_REG, 0);
+	REG_WR(priv->reg + BSPI_B1_CTRL_REG, 0);
+	REG_WR(priv->reg + BSPI_B0_CTRL_REG, 1);
+	REG_WR(priv->reg + BSPI_B1_CTRL_REG, 1);
+
+	REG_WR(priv->reg + BSPI_MAST_N_BOOT_CTRL_REG, 0);
+	priv->mspi_enabled = 0;
+	udelay(1);
+}
+
+/* One read-ahead FIFO session of at most BSPI_RAF_MAX_WORDS words. */
+static int bspi_raf_read(struct qspi_priv *priv, u32 addr, u8 *rx,
+			 unsigned int len)
+{
+	/* The FIFO returns whole words read from aligned addresses. */
+	unsigned int skip = addr & 3;
+	unsigned int words = (skip + len + 3) / 4;
+	struct stopwatch sw;
+
+	REG_WR(priv->reg + BSPI_RAF_START_ADDR_REG, addr - skip);
+	REG_WR(priv->reg + BSPI_RAF_NUM_WORDS_REG, words);
+	REG_WR(priv->reg + BSPI_RAF_WATERMARK_REG, 0);
+	REG_WR(priv->reg + BSPI_RAF_CTRL_REG, BSPI_RAF_CTRL_START);
+
+	stopwatch_init_msecs_expire(&sw, QSPI_WAIT_TIMEOUT);
+	while (words) {
+		unsigned int i;
+		u32 data;
+
+		if (REG_RD(priv->reg + BSPI_RAF_STATUS_REG) &
+		    BSPI_RAF_STATUS_EMPTY) {
+			if (stopwatch_expired(&sw)) {
+				REG_WR(priv->reg + BSPI_RAF_CTRL_REG,
+				       BSPI_RAF_CTRL_CLEAR);
+				return -1;
+			}
+			continue;
+		}
+
+		/* First byte on the bus is in the least significant byte. */
+		data = REG_RD(priv->reg + BSPI_RAF_READ_DATA_REG);
+		for (i = 0; i < 4; i++, data >>= 8) {
+			if (skip)
+				skip--;
+			else if (len) {
+				*rx++ = data & 0xff;
+				len--;
+			}
+		}
+		words--;
+	}
+
+	return 0;
+}
+
+int spi_xfer_multi_io_read(struct spi_slave *slave,
+			   const struct spi_multi_io_read *op, void *din,
+			   unsigned int bytesin)
+{
+	struct qspi_priv *priv = to_qspi_slave(slave);
+	unsigned int data_lines, addr_lines;
+	u32 addr = op->addr;
+	u8 *rx = din;
+	u32 bpp;
+	int ret = 0;
+
+	if (!priv->bus_claimed)
+		return -1;
+
+	switch (op->mode) {
+	case SPI_MULTI_IO_1_1_2:
+		data_lines = 2;
+		addr_lines = 1;
+		break;
+	case SPI_MULTI_IO_1_2_2:
+		data_lines = 2;
+		addr_lines = 2;
+		break;
+	case SPI_MULTI_IO_1_1_4:
+		data_lines = 4;
+		addr_lines = 1;
+		break;
+	case SPI_MULTI_IO_1_4_4:
+		data_lines = 4;
+		addr_lines = 4;
+		break;
+	default:
+		return -1;
+	}
+
+	/* BSPI sends the mode byte on the address lines when selected. */
+	bpp = op->dummy_cycles & 0xff;
+	if (op->mode_cycles) {
+		if (op->mode_cycles * addr_lines != 8)
+			return -1;
+		bpp |= BSPI_BPP_MODE_SELECT;
+	}
+
+	/* Hand the bus from MSPI to BSPI in flex mode. */
+	REG_WR(priv->reg + MSPI_WRITE_LOCK_REG, 0);
+	bspi_enable(priv);
+
+	REG_WR(priv->reg + BSPI_FLEX_MODE_ENABLE_REG, 0);
+	REG_WR(priv->reg + BSPI_BITS_PER_CYCLE_REG,
+	       bspi_width(data_lines) << BSPI_BPC_DATA_SHIFT |
+	       bspi_width(addr_lines) << BSPI_BPC_ADDR_SHIFT |
+	       bspi_width(addr_lines) << BSPI_BPC_MODE_SHIFT);
+	REG_WR(priv->reg + BSPI_BITS_PER_PHASE_REG, bpp);
+	REG_WR(priv->reg + BSPI_CMD_AND_MODE_BYTE_REG,
+	       op->opcode | op->mode_bits << 8);
+	REG_WR(priv->reg + BSPI_FLEX_MODE_ENABLE_REG, 1);
+
+	while (bytesin) {
+		unsigned int chunk = min(bytesin,
+					 BSPI_RAF_MAX_WORDS * 4 - (addr & 3));
+
+		ret = bspi_raf_read(priv, addr, rx, chunk);
+		if (ret)
+			break;
+
+		addr += chunk;
+		rx += chunk;
+		bytesin -= chunk;
+	}
+
+	/* Back to the boot default, and to MSPI for the claimed bus. */
+	REG_WR(priv->reg + BSPI_FLEX_MODE_ENABLE_REG, 0);
+	if (mspi_enable(priv))
+		ret = -1;
+	REG_WR(priv->reg + MSPI_WRITE_LOCK_REG, 1);
+
+	return ret;
+}
+
 unsigned int spi_crop_chunk(unsigned int cmd_len, unsigned int buf_len)
 {
 	return min(65535, buf_len);
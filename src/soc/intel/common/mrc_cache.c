@@ -13,6 +13,7 @@
  * GNU General Public License for more details.
  */
 
+#include <stddef.h>
 #include <string.h>
 #include <bootstate.h>
 #include <console/console.h>
@@ -27,6 +28,38 @@
 
 #define MRC_DATA_ALIGN           0x1000
 #define MRC_DATA_SIGNATURE       (('M'<<0)|('R'<<8)|('C'<<16)|('D'<<24))
+#define MRC_DIR_SIGNATURE        (('M'<<0)|('R'<<8)|('C'<<16)|('S'<<24))
+#define MRC_DIR_ENTRY_SIGNATURE  (('M'<<0)|('R'<<8)|('C'<<16)|('E'<<24))
+#define MRC_DIR_VERSION          1
+#define MRC_DIR_SIZE             0x100
+/* Slots start at the first data-aligned offset after the directory. */
+#define MRC_FIRST_SLOT           ALIGN(MRC_DIR_SIZE, MRC_DATA_ALIGN)
+
+/*
+ * The region starts with a slot directory followed by the slots. Slots are
+ * written first and then committed by appending an entry to the
+ * directory, so the newest slot is the one referenced by the last valid
+ * entry. If that slot is corrupted the previous committed slots are used
+ * instead. The directory and all slots are erased together once either is
+ * full.
+ */
+struct mrc_dir_entry {
+	uint32_t signature;
+	uint32_t sequence;
+	uint32_t offset;
+	uint32_t size;
+	/* Checksum over the fields above. */
+	uint32_t checksum;
+} __attribute__((packed));
+
+struct mrc_dir {
+	uint32_t signature;
+	uint32_t version;
+	struct mrc_dir_entry entries[0];
+} __attribute__((packed));
+
+#define MRC_DIR_ENTRIES \
+	((MRC_DIR_SIZE - sizeof(struct mrc_dir)) / sizeof(struct mrc_dir_entry))
 
 /* The mrc_data_region describes the larger non-volatile area to store
  * mrc_saved_data objects.*/
@@ -108,14 +141,77 @@ static int mrc_cache_valid(const struct mrc_data_region *region,
 	return 1;
 }
 
-static const struct mrc_saved_data *
-next_cache_block(const struct mrc_saved_data *cache)
+static uint32_t mrc_dir_entry_checksum(const struct mrc_dir_entry *entry)
 {
-	uintptr_t next = (uintptr_t)cache;
+	return compute_ip_checksum((void *)entry,
+				   offsetof(struct mrc_dir_entry, checksum));
+}
 
-	next += ALIGN(cache->size + sizeof(*cache), MRC_DATA_ALIGN);
+static int mrc_dir_entry_valid(const struct mrc_data_region *region,
+			       const struct mrc_dir_entry *entry)
+{
+	if (entry->signature != MRC_DIR_ENTRY_SIGNATURE)
+		return 0;
 
-	return (const struct mrc_saved_data *)next;
+	if (entry->checksum != mrc_dir_entry_checksum(entry))
+		return 0;
+
+	if (entry->offset < MRC_DIR_SIZE || entry->offset > region->size ||
+	    entry->size > region->size - entry->offset)
+		return 0;
+
+	return 1;
+}
+
+static const struct mrc_dir *mrc_dir_get(const struct mrc_data_region *region)
+{
+	const struct mrc_dir *dir = region->base;
+
+	if (region->size <= MRC_FIRST_SLOT)
+		return NULL;
+
+	if (dir->signature != MRC_DIR_SIGNATURE ||
+	    dir->version != MRC_DIR_VERSION)
+		return NULL;
+
+	return dir;
+}
+
+/*
+ * Return the index of the last used directory entry or -1 if there is
+ * none. Entries are appended, so the used ones form a prefix that can be
+ * searched in log(n) reads.
+ */
+static int mrc_dir_last_used(const struct mrc_dir *dir)
+{
+	int lo = -1;
+	int hi = MRC_DIR_ENTRIES;
+
+	while (hi - lo > 1) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (dir->entries[mid].signature != 0xffffffff)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Find the newest committed entry. Only the last one can be torn. */
+static const struct mrc_dir_entry *
+mrc_dir_current(const struct mrc_data_region *region, const struct mrc_dir *dir)
+{
+	int last = mrc_dir_last_used(dir);
+
+	if (last >= 0 && mrc_dir_entry_valid(region, &dir->entries[last]))
+		return &dir->entries[last];
+
+	if (last >= 1 && mrc_dir_entry_valid(region, &dir->entries[last - 1]))
+		return &dir->entries[last - 1];
+
+	return NULL;
 }
 
 /* Locate the most recently saved MRC data. */
@@ -125,17 +221,37 @@ static int __mrc_cache_get_current(const struct mrc_data_region *region,
 {
 	const struct mrc_saved_data *msd;
 	const struct mrc_saved_data *verified_cache;
-	int slot = 0;
-
-	msd = region->base;
+	const struct mrc_dir_entry *entry;
+	const struct mrc_dir *dir;
+	int slot = -1;
 
 	verified_cache = NULL;
 
-	while (mrc_cache_in_region(region, msd) &&
-	       mrc_cache_valid(region, msd)) {
-		verified_cache = msd;
-		msd = next_cache_block(msd);
-		slot++;
+	dir = mrc_dir_get(region);
+
+	/*
+	 * Only the slot referenced by the newest entry needs to be verified.
+	 * If its data is corrupted, walk back to the newest slot that still
+	 * checks out instead of discarding the whole cache.
+	 */
+	if (dir != NULL)
+		slot = mrc_dir_last_used(dir);
+
+	for (; slot >= 0; slot--) {
+		entry = &dir->entries[slot];
+		if (!mrc_dir_entry_valid(region, entry))
+			continue;
+
+		msd = (const void *)((uintptr_t)region->base + entry->offset);
+
+		if (mrc_cache_in_region(region, msd) &&
+		    msd->size + sizeof(*msd) == entry->size &&
+		    mrc_cache_valid(region, msd)) {
+			verified_cache = msd;
+			break;
+		}
+
+		printk(BIOS_ERR, "MRC cache slot %d corrupted.\n", slot);
 	}
 
 	/*
@@ -154,7 +270,7 @@ static int __mrc_cache_get_current(const struct mrc_data_region *region,
 		return -1;
 	}
 
-	printk(BIOS_DEBUG, "MRC cache slot %d @ %p\n", slot-1, verified_cache);
+	printk(BIOS_DEBUG, "MRC cache slot %d @ %p\n", slot, verified_cache);
 
 	return 0;
 }
@@ -248,19 +364,79 @@ static int mrc_slot_valid(const struct mrc_data_region *region,
 	return 1;
 }
 
+/* Erase the region and start a new directory. */
+static int mrc_dir_reset(const struct mrc_data_region *region)
+{
+	const struct mrc_dir dir = {
+		.signature = MRC_DIR_SIGNATURE,
+		.version = MRC_DIR_VERSION,
+	};
+
+	if (!nvm_is_erased(region->base, region->size)) {
+		if (nvm_erase(region->base, region->size) < 0) {
+			printk(BIOS_DEBUG, "Failure erasing region.\n");
+			return -1;
+		}
+	}
+
+	return nvm_write(region->base, &dir, sizeof(dir));
+}
+
+/* Append a directory entry for a slot already written. */
+static int mrc_dir_commit(const struct mrc_data_region *region,
+			  const struct mrc_saved_data *slot, uint32_t sequence)
+{
+	const struct mrc_dir *dir = region->base;
+	int index = mrc_dir_last_used(dir) + 1;
+	struct mrc_dir_entry entry = {
+		.signature = MRC_DIR_ENTRY_SIGNATURE,
+		.sequence = sequence,
+		.offset = (uintptr_t)slot - (uintptr_t)region->base,
+		.size = slot->size + sizeof(*slot),
+	};
+
+	if (index >= MRC_DIR_ENTRIES)
+		return -1;
+
+	entry.checksum = mrc_dir_entry_checksum(&entry);
+
+	return nvm_write((void *)&dir->entries[index], &entry, sizeof(entry));
+}
+
+/*
+ * Find where the next slot goes. Returns NULL if the directory or the
+ * slot area is full.
+ */
 static const struct mrc_saved_data *
 mrc_cache_next_slot(const struct mrc_data_region *region,
-                    const struct mrc_saved_data *current_slot)
+                    const struct mrc_dir_entry *current,
+                    const struct mrc_saved_data *to_save)
 {
-	const struct mrc_saved_data *next_slot;
+	const struct mrc_dir *dir = mrc_dir_get(region);
+	uintptr_t next;
+	int last;
 
-	if (current_slot == NULL) {
-		next_slot = region->base;
-	} else {
-		next_slot = next_cache_block(current_slot);
-	}
+	if (dir == NULL)
+		return NULL;
+
+	last = mrc_dir_last_used(dir);
+	if (last + 1 >= MRC_DIR_ENTRIES)
+		return NULL;
+
+	/* After a torn entry the end of the used space is unknown. */
+	if (last >= 0 && current != &dir->entries[last])
+		return NULL;
 
-	return next_slot;
+	next = (uintptr_t)region->base;
+	if (current == NULL)
+		next += MRC_FIRST_SLOT;
+	else
+		next += ALIGN(current->offset + current->size, MRC_DATA_ALIGN);
+
+	if (!mrc_slot_valid(region, (const void *)next, to_save))
+		return NULL;
+
+	return (const struct mrc_saved_data *)next;
 }
 
 /* Protect RW_MRC_CACHE region with a Protected Range Register */
@@ -299,7 +475,10 @@ static void update_mrc_cache(void *unused)
 	const struct mrc_saved_data *current_boot;
 	const struct mrc_saved_data *current_saved;
 	const struct mrc_saved_data *next_slot;
+	const struct mrc_dir_entry *current_entry = NULL;
+	const struct mrc_dir *dir;
 	struct mrc_data_region region;
+	uint32_t sequence = 0;
 
 	printk(BIOS_DEBUG, "Updating MRC cache data.\n");
 
@@ -321,9 +500,26 @@ static void update_mrc_cache(void *unused)
 
 	current_saved = NULL;
 
+	dir = mrc_dir_get(&region);
+	if (dir != NULL) {
+		current_entry = mrc_dir_current(&region, dir);
+		if (current_entry != NULL)
+			sequence = current_entry->sequence + 1;
+	}
+
+	/*
+	 * Skip the flash write if the data didn't change. The checksums
+	 * are compared first to avoid a full compare in the common case of
+	 * changed data. Data recovered from an older slot is rewritten so
+	 * the newest slot is valid again.
+	 */
 	if (!__mrc_cache_get_current(&region, &current_saved,
-					current_boot->version)) {
+					current_boot->version) &&
+	    current_entry != NULL &&
+	    (uintptr_t)current_saved ==
+	    (uintptr_t)region.base + current_entry->offset) {
 		if (current_saved->size == current_boot->size &&
+		    current_saved->checksum == current_boot->checksum &&
 		    !memcmp(&current_saved->data[0], &current_boot->data[0],
 		            current_saved->size)) {
 			printk(BIOS_DEBUG, "MRC cache up to date.\n");
@@ -332,26 +528,30 @@ static void update_mrc_cache(void *unused)
 		}
 	}
 
-	next_slot = mrc_cache_next_slot(&region, current_saved);
+	next_slot = mrc_cache_next_slot(&region, current_entry, current_boot);
 
-	if (!mrc_slot_valid(&region, next_slot, current_boot)) {
-		printk(BIOS_DEBUG, "Slot @ %p is invalid.\n", next_slot);
-		if (!nvm_is_erased(region.base, region.size)) {
-			if (nvm_erase(region.base, region.size) < 0) {
-				printk(BIOS_DEBUG, "Failure erasing region.\n");
-				return;
-			}
+	if (next_slot == NULL) {
+		printk(BIOS_DEBUG, "No free MRC cache slot, erasing.\n");
+		if (mrc_dir_reset(&region) < 0)
+			return;
+		current_entry = NULL;
+		next_slot = mrc_cache_next_slot(&region, NULL, current_boot);
+		if (next_slot == NULL) {
+			printk(BIOS_ERR, "MRC cache data too large.\n");
+			return;
 		}
-		next_slot = region.base;
 	}
 
 	if (nvm_write((void *)next_slot, current_boot,
-	               current_boot->size + sizeof(*current_boot))) {
+	               current_boot->size + sizeof(*current_boot)) ||
+	    mrc_dir_commit(&region, next_slot, sequence)) {
 		printk(BIOS_DEBUG, "Failure writing MRC cache to %p.\n",
 		       next_slot);
 		log_event_cache_update(ELOG_MEM_CACHE_UPDATE_SLOT_NORMAL,
 			ELOG_MEM_CACHE_UPDATE_STATUS_FAIL);
 	} else {
+		printk(BIOS_DEBUG, "MRC cache sequence %u @ %p\n", sequence,
+		       next_slot);
 		log_event_cache_update(ELOG_MEM_CACHE_UPDATE_SLOT_NORMAL,
 			ELOG_MEM_CACHE_UPDATE_STATUS_SUCCESS);
 	}
@@ -55,3 +55,70 @@ int smbus_read_byte(unsigned device, unsigned address)
 {
 	return do_smbus_read_byte(SMBUS_IO_BASE, device, address);
 }
+
+/*
+ * Read bytes consecutive bytes starting at offset using the I2C read
+ * command, which unlike an SMBus block read doesn't expect the device to
+ * send a byte count first. This matches what SPD EEPROMs implement.
+ */
+int smbus_i2c_block_read(unsigned device, unsigned offset, unsigned bytes,
+			 u8 *buf)
+{
+	u8 status;
+	unsigned i;
+
+	if (smbus_wait_until_ready(SMBUS_IO_BASE) < 0)
+		return SMBUS_WAIT_UNTIL_READY_TIMEOUT;
+
+	/* Setup transaction */
+	/* Disable interrupts */
+	outb(inb(SMBUS_IO_BASE + SMBHSTCTL) & (~1), SMBUS_IO_BASE + SMBHSTCTL);
+	/* Set the device I'm talking too, R/W is ignored for I2C read */
+	outb((device & 0x7f) << 1, SMBUS_IO_BASE + SMBXMITADD);
+	/* The offset goes to DATA1 for I2C read */
+	outb(offset & 0xff, SMBUS_IO_BASE + SMBHSTDAT1);
+	/* Set up for an I2C read */
+	outb((inb(SMBUS_IO_BASE + SMBHSTCTL) & 0xc3) | (0x6 << 2),
+	     (SMBUS_IO_BASE + SMBHSTCTL));
+	/* Clear any lingering errors, so the transaction will run */
+	outb(inb(SMBUS_IO_BASE + SMBHSTSTAT), SMBUS_IO_BASE + SMBHSTSTAT);
+
+	for (i = 0; i < bytes; i++) {
+		unsigned loops = SMBUS_TIMEOUT;
+
+		/* Tell the controller to NAK the last byte */
+		if (i == bytes - 1)
+			outb(inb(SMBUS_IO_BASE + SMBHSTCTL) | (1 << 5),
+			     SMBUS_IO_BASE + SMBHSTCTL);
+
+		/* Start the command */
+		if (i == 0)
+			outb((inb(SMBUS_IO_BASE + SMBHSTCTL) | 0x40),
+			     SMBUS_IO_BASE + SMBHSTCTL);
+
+		/* Poll for the byte */
+		do {
+			smbus_delay();
+			if (--loops == 0)
+				return SMBUS_WAIT_UNTIL_DONE_TIMEOUT;
+			status = inb(SMBUS_IO_BASE + SMBHSTSTAT);
+			if (status & ((1 << 4) | /* FAILED */
+				      (1 << 3) | /* BUS ERR */
+				      (1 << 2))) /* DEV ERR */
+				return SMBUS_ERROR;
+		} while (!(status & 0x80));
+
+		buf[i] = inb(SMBUS_IO_BASE + SMBBLKDAT);
+		/* Acknowledge the byte so the next one is read */
+		outb(0x80, SMBUS_IO_BASE + SMBHSTSTAT);
+	}
+
+	if (smbus_wait_until_done(SMBUS_IO_BASE) < 0)
+		return SMBUS_WAIT_UNTIL_DONE_TIMEOUT;
+
+	/* Clear the last byte flag and the status */
+	outb(inb(SMBUS_IO_BASE + SMBHSTCTL) & ~(1 << 5), SMBUS_IO_BASE + SMBHSTCTL);
+	outb(inb(SMBUS_IO_BASE + SMBHSTSTAT), SMBUS_IO_BASE + SMBHSTSTAT);
+
+	return 0;
+}
@@ -82,6 +82,8 @@ void pch_log_state(void);
 void enable_smbus(void);
 void enable_usb_bar(void);
 int smbus_read_byte(unsigned device, unsigned address);
+int smbus_i2c_block_read(unsigned device, unsigned offset, unsigned bytes,
+			 u8 *buf);
 int early_spi_read(u32 offset, u32 size, u8 *buffer);
 void early_thermal_init(void);
 void southbridge_configure_default_intmap(void);
@@ -27,8 +27,12 @@
 struct selected_region {
 	uint32_t offset;
 	uint32_t size;
+	uint32_t flags;
 };
 
+/* The slot wasn't hashed as a whole, its files are checked on load. */
+#define SELECTED_REGION_VERIFY_FILES	(1 << 0)
+
 /*
  * this is placed at the start of the vboot work buffer. selected_region is used
  * for the verstage to return the location of the selected slot. buffer is used
@@ -141,6 +145,25 @@ void vb2_set_selected_region(const struct region *region)
 	reg->size = region_sz(region);
 }
 
+void vb2_set_verify_files_on_load(void)
+{
+	struct selected_region *reg = vb2_selected_region();
+
+	assert(reg != NULL);
+
+	reg->flags |= SELECTED_REGION_VERIFY_FILES;
+}
+
+int vb2_verify_files_on_load(void)
+{
+	const struct selected_region *reg = vb2_selected_region();
+
+	if (reg == NULL)
+		return 0;
+
+	return !!(reg->flags & SELECTED_REGION_VERIFY_FILES);
+}
+
 int vb2_is_slot_selected(void)
 {
 	const struct selected_region *reg = vb2_selected_region();
@@ -165,6 +188,7 @@ void vb2_store_selected_region(void)
 
 	sel_reg->offset = wd->selected_region.offset;
 	sel_reg->size = wd->selected_region.size;
+	sel_reg->flags = wd->selected_region.flags;
 }
 
 /*
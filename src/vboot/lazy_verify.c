@@ -0,0 +1,320 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Per-file verification of a sealed RW slot. Verstage only skips hashing the
+ * slot body if the preamble and the file metadata match what was sealed in
+ * the TPM after the last full verification. The metadata carries a hash of
+ * every file's data, which is checked here before the data is used.
+ *
+ * Loaders read a file of a sealed slot through a vboot_hash_rdev, which
+ * hashes the data as it passes. An access reaching the end of the file that
+ * continues the data hashed so far completes the hash and only succeeds if
+ * it matches, so whole-file reads and the stage loaders reading a file
+ * front to back don't touch the boot media a second time. Any other access
+ * checks the whole file first. That covers:
+ *
+ * - Programs found by prog_locate(): rmodule_stage_load() only sizes its
+ *   buffer from the stage header, the stage is checked while it is read.
+ *   cbfs_prog_stage_load() places the stage according to its header, it and
+ *   the other users (payload, FSP, refcode) get the whole program checked by
+ *   their first access.
+ * - cbfs_boot_load_struct(): checked while it loads.
+ * - Everything else through cbfs_boot_locate(): checked when it's located.
+ *
+ * Mappings are hashed before they are handed out. On memory mapped boot
+ * media the user of the mapping then reads the flash a second time.
+ */
+
+#include <cbfs.h>
+#include <commonlib/cbfs.h>
+#include <commonlib/endian.h>
+#include <commonlib/helpers.h>
+#include <console/console.h>
+#include <rules.h>
+#include <string.h>
+#include <vb2_api.h>
+#include <vboot/misc.h>
+#include <vboot/vbnv.h>
+
+enum {
+	HASH_RDEV_CHECKED,
+	HASH_RDEV_PENDING,
+	HASH_RDEV_FAILED,
+};
+
+static const struct region_device_ops hash_rdev_ops;
+
+struct cbfs_file_attr_hash *vboot_cbfs_file_hash(void *metadata,
+						 size_t metadata_size)
+{
+	size_t offs = 0;
+
+	while ((offs = cbfs_for_each_attr(metadata, metadata_size, offs))) {
+		struct cbfs_file_attr_hash *attr = metadata + offs;
+
+		if (read_be32(&attr->tag) == CBFS_FILE_ATTR_TAG_HASH)
+			return attr;
+	}
+
+	return NULL;
+}
+
+static struct vboot_hash_rdev *to_hash_rdev(const struct region_device *rd)
+{
+	return container_of(rd, struct vboot_hash_rdev, rdev);
+}
+
+static int hash_rdev_fail(struct vboot_hash_rdev *hrdev, const char *msg)
+{
+	printk(BIOS_ERR, "VBOOT: %s\n", msg);
+	hrdev->state = HASH_RDEV_FAILED;
+
+	/*
+	 * The sealed hash still matches the slot, so the next boot would
+	 * fail the same way. Have the slot looked at in recovery mode.
+	 * Postcar has no access to the vboot nvdata, loading just fails.
+	 */
+	if (!ENV_POSTCAR) {
+		set_recovery_mode_into_vbnv(VB2_RECOVERY_FW_BODY);
+		vboot_reboot();
+	}
+
+	return -1;
+}
+
+static int hash_rdev_finalize(struct vboot_hash_rdev *hrdev)
+{
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+
+	if (vb2_digest_finalize(&hrdev->ctx, digest, hrdev->digest_sz))
+		return hash_rdev_fail(hrdev, "Unable to hash file.");
+
+	if (memcmp(digest, hrdev->digest, hrdev->digest_sz))
+		return hash_rdev_fail(hrdev, "File hash mismatch.");
+
+	hrdev->state = HASH_RDEV_CHECKED;
+
+	return 0;
+}
+
+/* Hash the part of [offset, offset + size) at buf that isn't hashed yet. */
+static int hash_rdev_extend(struct vboot_hash_rdev *hrdev, const void *buf,
+			    size_t offset, size_t size)
+{
+	size_t skip;
+
+	if (hrdev->state != HASH_RDEV_PENDING)
+		return hrdev->state == HASH_RDEV_CHECKED ? 0 : -1;
+
+	if (offset > hrdev->hashed || offset + size <= hrdev->hashed)
+		return 0;
+
+	skip = hrdev->hashed - offset;
+	if (vb2_digest_extend(&hrdev->ctx, buf + skip, size - skip))
+		return hash_rdev_fail(hrdev, "Unable to hash file.");
+
+	hrdev->hashed = offset + size;
+
+	if (hrdev->hashed < region_device_sz(&hrdev->data))
+		return 0;
+
+	return hash_rdev_finalize(hrdev);
+}
+
+/* Hash what is left of the file and check it. */
+static int hash_rdev_check(struct vboot_hash_rdev *hrdev)
+{
+	uint8_t buffer[1024];
+	size_t size = region_device_sz(&hrdev->data);
+
+	while (hrdev->state == HASH_RDEV_PENDING) {
+		size_t offset = hrdev->hashed;
+		size_t block_sz = MIN(size - offset, sizeof(buffer));
+
+		if (rdev_readat(&hrdev->data, buffer, offset, block_sz) !=
+		    block_sz)
+			return hash_rdev_fail(hrdev, "Unable to hash file.");
+
+		hash_rdev_extend(hrdev, buffer, offset, block_sz);
+	}
+
+	return hrdev->state == HASH_RDEV_CHECKED ? 0 : -1;
+}
+
+/*
+ * An access continuing the hashed data up to the end of the file is hashed
+ * on the way. The file has to be checked before anything else is handed out.
+ */
+static int hash_rdev_prepare(struct vboot_hash_rdev *hrdev, size_t offset,
+			     size_t size)
+{
+	if (hrdev->state == HASH_RDEV_PENDING && offset <= hrdev->hashed &&
+	    offset + size == region_device_sz(&hrdev->data))
+		return 0;
+
+	return hash_rdev_check(hrdev);
+}
+
+static void *hash_rdev_mmap(const struct region_device *rd, size_t offset,
+			    size_t size)
+{
+	struct vboot_hash_rdev *hrdev = to_hash_rdev(rd);
+	void *mapping;
+
+	if (hash_rdev_prepare(hrdev, offset, size))
+		return NULL;
+
+	mapping = rdev_mmap(&hrdev->data, offset, size);
+	if (mapping == NULL)
+		return NULL;
+
+	if (hash_rdev_extend(hrdev, mapping, offset, size)) {
+		rdev_munmap(&hrdev->data, mapping);
+		return NULL;
+	}
+
+	return mapping;
+}
+
+static int hash_rdev_munmap(const struct region_device *rd, void *mapping)
+{
+	return rdev_munmap(&to_hash_rdev(rd)->data, mapping);
+}
+
+static ssize_t hash_rdev_readat(const struct region_device *rd, void *b,
+				size_t offset, size_t size)
+{
+	struct vboot_hash_rdev *hrdev = to_hash_rdev(rd);
+
+	if (hash_rdev_prepare(hrdev, offset, size))
+		return -1;
+
+	if (rdev_readat(&hrdev->data, b, offset, size) != size)
+		return -1;
+
+	if (hash_rdev_extend(hrdev, b, offset, size))
+		return -1;
+
+	return size;
+}
+
+static const struct region_device_ops hash_rdev_ops = {
+	.mmap = hash_rdev_mmap,
+	.munmap = hash_rdev_munmap,
+	.readat = hash_rdev_readat,
+};
+
+int vboot_hash_rdev_init(struct vboot_hash_rdev *hrdev,
+			 const struct cbfsf *fh)
+{
+	struct cbfs_file_attr_hash *attr;
+	size_t metadata_size;
+	void *metadata;
+	uint32_t hash_alg;
+	int digest_sz;
+	int rv;
+
+	hrdev->rdev = (struct region_device)REGION_DEV_INIT(&hash_rdev_ops, 0,
+						region_device_sz(&fh->data));
+	hrdev->data = fh->data;
+	hrdev->hashed = 0;
+	hrdev->state = HASH_RDEV_CHECKED;
+
+	if (!vb2_logic_executed() || !vb2_verify_files_on_load())
+		return 0;
+
+	metadata_size = region_device_sz(&fh->metadata);
+	metadata = rdev_mmap_full(&fh->metadata);
+	if (metadata == NULL)
+		return hash_rdev_fail(hrdev, "Unable to map file metadata.");
+
+	attr = vboot_cbfs_file_hash(metadata, metadata_size);
+	if (attr == NULL) {
+		rv = hash_rdev_fail(hrdev, "File has no hash attribute.");
+		goto out;
+	}
+
+	hash_alg = read_be32(&attr->hash_type);
+	digest_sz = vb2_digest_size(hash_alg);
+	if (digest_sz == 0 ||
+	    read_be32(&attr->len) != sizeof(*attr) + digest_sz) {
+		rv = hash_rdev_fail(hrdev, "Bad hash attribute.");
+		goto out;
+	}
+
+	if (vb2_digest_init(&hrdev->ctx, hash_alg)) {
+		rv = hash_rdev_fail(hrdev, "Unable to hash file.");
+		goto out;
+	}
+
+	memcpy(hrdev->digest, attr->hash_data, digest_sz);
+	hrdev->digest_sz = digest_sz;
+	hrdev->state = HASH_RDEV_PENDING;
+
+	rv = 0;
+	if (region_device_sz(&hrdev->data) == 0)
+		rv = hash_rdev_finalize(hrdev);
+out:
+	rdev_munmap(&fh->metadata, metadata);
+	return rv;
+}
+
+static struct vboot_hash_rdev *hash_rdev_of(const struct region_device *rd)
+{
+	const struct region_device *root = rd->root ? rd->root : rd;
+
+	if (root->ops != &hash_rdev_ops)
+		return NULL;
+
+	return to_hash_rdev(root);
+}
+
+ssize_t vboot_hash_rdev_readat_early(const struct region_device *rd,
+				     void *b, size_t offset, size_t size)
+{
+	struct vboot_hash_rdev *hrdev = hash_rdev_of(rd);
+	size_t file_offset = region_device_offset(rd) + offset;
+
+	if (hrdev == NULL || hrdev->state != HASH_RDEV_PENDING ||
+	    file_offset != hrdev->hashed)
+		return rdev_readat(rd, b, offset, size);
+
+	if (rdev_readat(&hrdev->data, b, file_offset, size) != size)
+		return -1;
+
+	if (hash_rdev_extend(hrdev, b, file_offset, size))
+		return -1;
+
+	return size;
+}
+
+int vboot_hash_rdev_check(const struct region_device *rd)
+{
+	struct vboot_hash_rdev *hrdev = hash_rdev_of(rd);
+
+	if (hrdev == NULL)
+		return 0;
+
+	return hash_rdev_check(hrdev);
+}
+
+int vboot_check_cbfs_file(const struct cbfsf *fh)
+{
+	struct vboot_hash_rdev hrdev;
+
+	if (vboot_hash_rdev_init(&hrdev, fh))
+		return -1;
+
+	return hash_rdev_check(&hrdev);
+}
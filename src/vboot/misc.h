@@ -16,8 +16,12 @@
 #ifndef __VBOOT_MISC_H__
 #define __VBOOT_MISC_H__
 
+#include <commonlib/region.h>
+#include <vb2_api.h>
 #include <vboot/vboot_common.h>
 
+struct cbfs_file_attr_hash;
+struct cbfsf;
 struct vb2_context;
 struct vb2_shared_data;
 
@@ -30,6 +34,57 @@ struct vb2_shared_data *vb2_get_shared_data(void);
 int vb2_get_selected_region(struct region *region);
 void vb2_set_selected_region(const struct region *region);
 int vb2_is_slot_selected(void);
+
+/*
+ * Mark the selected slot as sealed: its body wasn't hashed, every file has
+ * to be checked against its hash attribute when it is loaded.
+ */
+void vb2_set_verify_files_on_load(void);
+int vb2_verify_files_on_load(void);
+
+/*
+ * Return the hash attribute of a CBFS file from its mapped metadata, NULL if
+ * it has none.
+ */
+struct cbfs_file_attr_hash *vboot_cbfs_file_hash(void *metadata,
+						 size_t metadata_size);
+
+/*
+ * Check a file located in a sealed slot against its hash attribute. Returns
+ * 0 if the file may be used, < 0 otherwise.
+ */
+int vboot_check_cbfs_file(const struct cbfsf *fh);
+
+/*
+ * Region device checking a file of a sealed slot while it is read through
+ * rdev. An access continuing the data read so far up to the end of the file
+ * only succeeds if the hash matches. Any other access checks the whole file
+ * first. Files outside a sealed slot are read as they are.
+ */
+struct vboot_hash_rdev {
+	struct region_device rdev;
+	struct region_device data;
+	struct vb2_digest_context ctx;
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	size_t digest_sz;
+	size_t hashed;
+	int state;
+};
+
+/* Returns 0 on success, < 0 if the file can't be checked. */
+int vboot_hash_rdev_init(struct vboot_hash_rdev *hrdev,
+			 const struct cbfsf *fh);
+
+/*
+ * Read the start of a file chained from a vboot_hash_rdev before it is
+ * checked, e.g. a stage header the loader only needs to size its buffer.
+ * The data must not be trusted before the rest of the file was read.
+ */
+ssize_t vboot_hash_rdev_readat_early(const struct region_device *rd,
+				     void *b, size_t offset, size_t size);
+
+/* Check the rest of a file read through vboot_hash_rdev_readat_early(). */
+int vboot_hash_rdev_check(const struct region_device *rd);
 int vb2_logic_executed(void);
 
 /* Store the selected region in cbmem for later use. */
@@ -9,6 +9,7 @@
 #include <antirollback.h>
 #include <stdlib.h>
 #include <string.h>
+#include <tcpa_log.h>
 #include <tpm_lite/tlcl.h>
 #include <vb2_api.h>
 #include <console/console.h>
@@ -51,7 +52,14 @@ uint32_t tpm_extend_pcr(struct vb2_context *ctx, int pcr,
 	if (size < TPM_PCR_DIGEST)
 		return VB2_ERROR_UNKNOWN;
 
-	return tlcl_extend(pcr, buffer, NULL);
+	RETURN_ON_FAILURE(tlcl_extend(pcr, buffer, NULL));
+
+	if (IS_ENABLED(CONFIG_TCPA_LOG))
+		tcpa_log_add(pcr, TCPA_EV_COMPACT_HASH, buffer,
+			     which_digest == BOOT_MODE_PCR ?
+			     "VBOOT: boot mode" : "VBOOT: GBB HWID");
+
+	return TPM_SUCCESS;
 }
 
 static uint32_t read_space_firmware(struct vb2_context *ctx)
@@ -143,11 +151,18 @@ static uint32_t set_kernel_space(const void *kernel_blob)
 	return TPM_SUCCESS;
 }
 
+static uint32_t set_slot_hash_space(void)
+{
+	return tlcl_define_space(SLOT_HASH_NV_INDEX, SLOT_HASH_SIZE);
+}
+
 static uint32_t _factory_initialize_tpm(struct vb2_context *ctx)
 {
 	RETURN_ON_FAILURE(tlcl_force_clear());
 	RETURN_ON_FAILURE(set_firmware_space(ctx->secdata));
 	RETURN_ON_FAILURE(set_kernel_space(secdata_kernel));
+	if (IS_ENABLED(CONFIG_VBOOT_LAZY_VERIFY))
+		RETURN_ON_FAILURE(set_slot_hash_space());
 	return TPM_SUCCESS;
 }
 
@@ -163,6 +178,18 @@ uint32_t antirollback_lock_space_firmware(void)
 	return tlcl_lock_nv_write(FIRMWARE_NV_INDEX);
 }
 
+uint32_t antirollback_lock_space_slot_hash(void)
+{
+	uint8_t byte;
+
+	/* Nothing to lock on TPMs initialized before the space existed. */
+	if (tlcl_read(SLOT_HASH_NV_INDEX, &byte, sizeof(byte)) ==
+	    TPM_E_BADINDEX)
+		return TPM_SUCCESS;
+
+	return tlcl_lock_nv_write(SLOT_HASH_NV_INDEX);
+}
+
 #else
 
 uint32_t tpm_clear_and_reenable(void)
@@ -210,6 +237,14 @@ static uint32_t safe_define_space(uint32_t index, uint32_t perm, uint32_t size)
 	}
 }
 
+/* Unlike the firmware space, there is nothing to initialize it with. */
+static uint32_t set_slot_hash_space(void)
+{
+	return safe_define_space(SLOT_HASH_NV_INDEX,
+				 TPM_NV_PER_GLOBALLOCK | TPM_NV_PER_PPWRITE,
+				 SLOT_HASH_SIZE);
+}
+
 static uint32_t _factory_initialize_tpm(struct vb2_context *ctx)
 {
 	TPM_PERMANENT_FLAGS pflags;
@@ -262,6 +297,10 @@ static uint32_t _factory_initialize_tpm(struct vb2_context *ctx)
 	RETURN_ON_FAILURE(write_secdata(FIRMWARE_NV_INDEX,
 					ctx->secdata,
 					VB2_SECDATA_SIZE));
+
+	if (IS_ENABLED(CONFIG_VBOOT_LAZY_VERIFY))
+		RETURN_ON_FAILURE(set_slot_hash_space());
+
 	return TPM_SUCCESS;
 }
 
@@ -269,6 +308,12 @@ uint32_t antirollback_lock_space_firmware(void)
 {
 	return tlcl_set_global_lock();
 }
+
+/* The global lock covers the slot hash space. */
+uint32_t antirollback_lock_space_slot_hash(void)
+{
+	return TPM_SUCCESS;
+}
 #endif
 
 uint32_t factory_initialize_tpm(struct vb2_context *ctx)
@@ -329,6 +374,10 @@ uint32_t setup_tpm(struct vb2_context *ctx)
 
 	RETURN_ON_FAILURE(tlcl_lib_init());
 
+	/* Measurements of this boot are logged from here on. */
+	if (IS_ENABLED(CONFIG_TCPA_LOG))
+		tcpa_log_init();
+
 	/* Handle special init for S3 resume path */
 	if (ctx->flags & VB2_CONTEXT_S3_RESUME) {
 		result = tlcl_resume();
@@ -430,3 +479,23 @@ uint32_t antirollback_write_space_firmware(struct vb2_context *ctx)
 {
 	return write_secdata(FIRMWARE_NV_INDEX, ctx->secdata, VB2_SECDATA_SIZE);
 }
+
+uint32_t antirollback_read_space_slot_hash(void *data, uint32_t size)
+{
+	return tlcl_read(SLOT_HASH_NV_INDEX, data, size);
+}
+
+uint32_t antirollback_write_space_slot_hash(const void *data, uint32_t size)
+{
+	uint32_t rv;
+
+	rv = safe_write(SLOT_HASH_NV_INDEX, data, size);
+
+	/* Define the space on TPMs initialized before it was introduced. */
+	if (rv == TPM_E_BADINDEX) {
+		RETURN_ON_FAILURE(set_slot_hash_space());
+		rv = safe_write(SLOT_HASH_NV_INDEX, data, size);
+	}
+
+	return rv;
+}
@@ -0,0 +1,171 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * vboot hardware crypto hooks backed by the CPU's SHA-256 instructions.
+ * Whether the CPU has them is checked when a digest is started, without
+ * them vboot falls back to its software implementation.
+ */
+
+#include <arch/early_variables.h>
+#include <commonlib/helpers.h>
+#include <console/console.h>
+#include <rules.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vb2_api.h>
+
+#if ENV_X86
+#include <arch/cpu.h>
+#endif
+
+#define SHA256_BLOCK_SIZE	64
+#define SHA256_DIGEST_SIZE	32
+/* Offset of the message length in the last block */
+#define SHA256_LENGTH_OFFSET	(SHA256_BLOCK_SIZE - sizeof(uint64_t))
+
+void sha256_ni_blocks(uint32_t state[8], const uint8_t *data, size_t blocks);
+
+struct sha256_accel_ctx {
+	uint32_t state[8];
+	/* Partial block carried over to the next extend */
+	uint8_t buf[SHA256_BLOCK_SIZE];
+	size_t buf_len;
+	uint64_t total;
+};
+
+static struct sha256_accel_ctx sha256_accel CAR_GLOBAL;
+
+static const uint32_t sha256_init_state[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+#if ENV_X86
+static int sha256_accel_supported(void)
+{
+	/* The transform also uses SSSE3 and SSE4.1 instructions. */
+	if (cpuid_eax(0) < 7)
+		return 0;
+
+	if (!(cpuid_ecx(1) & (1 << 9)) || !(cpuid_ecx(1) & (1 << 19)))
+		return 0;
+
+	return !!(cpuid_ext(7, 0).ebx & (1 << 29));
+}
+
+static void sha256_accel_blocks(uint32_t state[8], const uint8_t *data,
+				size_t blocks)
+{
+	sha256_ni_blocks(state, data, blocks);
+}
+#else
+static int sha256_accel_supported(void)
+{
+	return 0;
+}
+
+static void sha256_accel_blocks(uint32_t state[8], const uint8_t *data,
+				size_t blocks)
+{
+}
+#endif
+
+int vb2ex_hwcrypto_digest_init(enum vb2_hash_algorithm hash_alg,
+			       uint32_t data_size)
+{
+	struct sha256_accel_ctx *ctx = car_get_var_ptr(&sha256_accel);
+
+	if (hash_alg != VB2_HASH_SHA256 || !sha256_accel_supported())
+		return VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+
+	memcpy(ctx->state, sha256_init_state, sizeof(ctx->state));
+	ctx->buf_len = 0;
+	ctx->total = 0;
+
+	printk(BIOS_DEBUG, "Using CPU SHA-256 instructions for %u bytes\n",
+	       data_size);
+	return VB2_SUCCESS;
+}
+
+int vb2ex_hwcrypto_digest_extend(const uint8_t *buf, uint32_t size)
+{
+	struct sha256_accel_ctx *ctx = car_get_var_ptr(&sha256_accel);
+	size_t blocks;
+
+	ctx->total += size;
+
+	if (ctx->buf_len) {
+		size_t len = MIN(SHA256_BLOCK_SIZE - ctx->buf_len, size);
+
+		memcpy(&ctx->buf[ctx->buf_len], buf, len);
+		ctx->buf_len += len;
+		buf += len;
+		size -= len;
+
+		if (ctx->buf_len < SHA256_BLOCK_SIZE)
+			return VB2_SUCCESS;
+
+		sha256_accel_blocks(ctx->state, ctx->buf, 1);
+		ctx->buf_len = 0;
+	}
+
+	/* Hash full blocks straight from the caller's buffer. */
+	blocks = size / SHA256_BLOCK_SIZE;
+	if (blocks) {
+		sha256_accel_blocks(ctx->state, buf, blocks);
+		buf += blocks * SHA256_BLOCK_SIZE;
+		size -= blocks * SHA256_BLOCK_SIZE;
+	}
+
+	memcpy(ctx->buf, buf, size);
+	ctx->buf_len = size;
+
+	return VB2_SUCCESS;
+}
+
+int vb2ex_hwcrypto_digest_finalize(uint8_t *digest, uint32_t digest_size)
+{
+	struct sha256_accel_ctx *ctx = car_get_var_ptr(&sha256_accel);
+	uint64_t bits = ctx->total * 8;
+	int i;
+
+	if (digest_size < SHA256_DIGEST_SIZE)
+		return VB2_ERROR_UNKNOWN;
+
+	ctx->buf[ctx->buf_len++] = 0x80;
+
+	/* The length doesn't fit, pad out this block and start another. */
+	if (ctx->buf_len > SHA256_LENGTH_OFFSET) {
+		memset(&ctx->buf[ctx->buf_len], 0,
+		       SHA256_BLOCK_SIZE - ctx->buf_len);
+		sha256_accel_blocks(ctx->state, ctx->buf, 1);
+		ctx->buf_len = 0;
+	}
+
+	memset(&ctx->buf[ctx->buf_len], 0,
+	       SHA256_LENGTH_OFFSET - ctx->buf_len);
+	for (i = 0; i < sizeof(bits); i++)
+		ctx->buf[SHA256_LENGTH_OFFSET + i] = bits >> (56 - 8 * i);
+	sha256_accel_blocks(ctx->state, ctx->buf, 1);
+
+	for (i = 0; i < ARRAY_SIZE(ctx->state); i++) {
+		digest[4 * i + 0] = ctx->state[i] >> 24;
+		digest[4 * i + 1] = ctx->state[i] >> 16;
+		digest[4 * i + 2] = ctx->state[i] >> 8;
+		digest[4 * i + 3] = ctx->state[i];
+	}
+
+	return VB2_SUCCESS;
+}
@@ -17,6 +17,8 @@
 #include <arch/exception.h>
 #include <assert.h>
 #include <bootmode.h>
+#include <commonlib/cbfs.h>
+#include <commonlib/endian.h>
 #include <console/console.h>
 #include <console/vtxprintf.h>
 #include <delay.h>
@@ -177,6 +179,129 @@ static int handle_digest_result(void *slot_hash, size_t slot_hash_sz)
 	return 0;
 }
 
+/*
+ * What the TPM keeps about the last fully verified slot: a digest of the
+ * preamble and the slot's file metadata, and the body digest vboot computed
+ * back then.
+ */
+struct slot_seal {
+	uint8_t slot_digest[VB2_SHA256_DIGEST_SIZE];
+	uint8_t body_digest[VBOOT_MAX_HASH_SIZE];
+} __attribute__((packed));
+
+_Static_assert(sizeof(struct slot_seal) == SLOT_HASH_SIZE,
+	       "struct slot_seal doesn't match the slot hash space");
+
+static int slot_digest_extend(struct vb2_digest_context *dc, uint32_t val)
+{
+	write_be32(&val, val);
+	return vb2_digest_extend(dc, (const uint8_t *)&val, sizeof(val));
+}
+
+/*
+ * Hash the slot id, the preamble and the metadata of every file in the body,
+ * which in turn hashes the file data. The preamble was verified by phase 3
+ * and carries the body signature, so a seal only vouches for the body that
+ * was fully verified together with the same preamble. Files have to follow
+ * each other without gaps up to the end of the body, otherwise CBFS walks
+ * could find headers that weren't covered. Returns < 0 if the slot can't be
+ * verified per file.
+ */
+static int slot_digest(struct vb2_context *ctx,
+		       const struct region_device *fw_main, uint8_t *digest)
+{
+	struct vb2_shared_data *sd = vb2_get_shared_data();
+	struct vb2_digest_context dc;
+	struct cbfsf f;
+	struct cbfsf *prev = NULL;
+	size_t next = 0;
+	int rv;
+
+	if (vb2_digest_init(&dc, VB2_HASH_SHA256))
+		return -1;
+
+	if (slot_digest_extend(&dc, is_slot_a(ctx) ? 'A' : 'B') ||
+	    slot_digest_extend(&dc, region_device_sz(fw_main)))
+		return -1;
+
+	if (sd->workbuf_preamble_size == 0 ||
+	    slot_digest_extend(&dc, sd->workbuf_preamble_size) ||
+	    vb2_digest_extend(&dc, (const uint8_t *)sd +
+			      sd->workbuf_preamble_offset,
+			      sd->workbuf_preamble_size))
+		return -1;
+
+	while (!(rv = cbfs_for_each_file(fw_main, prev, &f))) {
+		size_t offset = rdev_relative_offset(fw_main, &f.metadata);
+		size_t size = region_device_sz(&f.metadata);
+		struct cbfs_file *file;
+		uint32_t type;
+
+		prev = &f;
+
+		if (offset != next)
+			return -1;
+		next = ALIGN_UP(rdev_relative_offset(fw_main, &f.data) +
+				region_device_sz(&f.data), CBFS_ALIGNMENT);
+
+		file = rdev_mmap_full(&f.metadata);
+		if (file == NULL)
+			return -1;
+
+		rv = slot_digest_extend(&dc, offset);
+		if (!rv)
+			rv = vb2_digest_extend(&dc, (const uint8_t *)file, size);
+
+		/* Deleted files can't be located, everything else is checked. */
+		type = read_be32(&file->type);
+		if (!rv && type != CBFS_TYPE_DELETED &&
+		    type != CBFS_TYPE_DELETED2 &&
+		    vboot_cbfs_file_hash(file, size) == NULL) {
+			printk(BIOS_DEBUG, "%s has no hash attribute.\n",
+			       (char *)file + sizeof(*file));
+			rv = -1;
+		}
+
+		rdev_munmap(&f.metadata, file);
+
+		if (rv)
+			return -1;
+	}
+
+	if (rv < 0)
+		return -1;
+
+	if (vb2_digest_finalize(&dc, digest, VB2_SHA256_DIGEST_SIZE))
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Check the slot against the seal and leave its digest in seal. Returns 0 if
+ * the slot is unchanged since it was sealed, 1 if it needs to be sealed and
+ * < 0 if it can't be.
+ */
+static int slot_seal_check(struct vb2_context *ctx,
+			   const struct region_device *fw_main,
+			   struct slot_seal *seal)
+{
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+
+	if (slot_digest(ctx, fw_main, digest)) {
+		printk(BIOS_INFO, "Slot can't be verified per file.\n");
+		return -1;
+	}
+
+	if (antirollback_read_space_slot_hash(seal, sizeof(*seal)) ||
+	    memcmp(seal->slot_digest, digest, sizeof(digest))) {
+		memcpy(seal->slot_digest, digest, sizeof(digest));
+		return 1;
+	}
+
+	return 0;
+}
+
 static int hash_body(struct vb2_context *ctx, struct region_device *fw_main)
 {
 	uint64_t load_ts;
@@ -184,6 +309,8 @@ static int hash_body(struct vb2_context *ctx, struct region_device *fw_main)
 	uint8_t block[TODO_BLOCK_SIZE];
 	uint8_t hash_digest[VBOOT_MAX_HASH_SIZE];
 	const size_t hash_digest_sz = sizeof(hash_digest);
+	struct slot_seal seal;
+	int seal_state = -1;
 	size_t block_size = sizeof(block);
 	size_t offset;
 	int rv;
@@ -220,6 +347,25 @@ static int hash_body(struct vb2_context *ctx, struct region_device *fw_main)
 		return VB2_ERROR_UNKNOWN;
 	}
 
+	/*
+	 * The slot was fully verified on an earlier boot and its metadata,
+	 * including the file hashes, is unchanged. Files are checked as they
+	 * are loaded instead. The body digest is still needed for resume.
+	 */
+	if (IS_ENABLED(CONFIG_VBOOT_LAZY_VERIFY))
+		seal_state = slot_seal_check(ctx, fw_main, &seal);
+
+	if (seal_state == 0) {
+		printk(BIOS_INFO, "Slot is sealed, verifying files on load.\n");
+		timestamp_add_now(TS_END_HASH_BODY);
+		vb2_set_verify_files_on_load();
+
+		if (handle_digest_result(seal.body_digest, hash_digest_sz))
+			return VB2_ERROR_UNKNOWN;
+
+		return VB2_SUCCESS;
+	}
+
 	/* Extend over the body */
 	while (expected_size) {
 		uint64_t temp_ts;
@@ -252,6 +398,13 @@ static int hash_body(struct vb2_context *ctx, struct region_device *fw_main)
 	if (handle_digest_result(hash_digest, hash_digest_sz))
 		return VB2_ERROR_UNKNOWN;
 
+	/* Seal the verified slot for the next boot, ignore failures. */
+	if (seal_state > 0) {
+		memcpy(seal.body_digest, hash_digest, sizeof(seal.body_digest));
+		if (antirollback_write_space_slot_hash(&seal, sizeof(seal)))
+			printk(BIOS_WARNING, "Unable to seal slot.\n");
+	}
+
 	return VB2_SUCCESS;
 }
 
@@ -409,6 +562,8 @@ void verstage_main(void)
 
 	/* Lock TPM */
 	rv = antirollback_lock_space_firmware();
+	if (!rv && IS_ENABLED(CONFIG_VBOOT_LAZY_VERIFY))
+		rv = antirollback_lock_space_slot_hash();
 	if (rv) {
 		printk(BIOS_INFO, "Failed to lock TPM (%x)\n", rv);
 		vb2api_fail(&ctx, VB2_RECOVERY_RO_TPM_L_ERROR, 0);
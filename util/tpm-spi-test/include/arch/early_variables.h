@@ -0,0 +1,8 @@
+#ifndef ARCH_EARLY_VARIABLES_H
+#define ARCH_EARLY_VARIABLES_H
+
+#define CAR_GLOBAL
+#define car_get_var(var) (var)
+#define car_set_var(var, val) ((var) = (val))
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef CONSOLE_CONSOLE_H_
+#define CONSOLE_CONSOLE_H_
+
+#include <stdio.h>
+
+#define BIOS_ERR	3
+#define BIOS_WARNING	4
+#define BIOS_INFO	6
+#define BIOS_DEBUG	7
+#define BIOS_SPEW	8
+
+#define printk(level, ...)					\
+	do {							\
+		if ((level) <= BIOS_WARNING)			\
+			fprintf(stderr, __VA_ARGS__);		\
+	} while (0)
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef DELAY_H
+#define DELAY_H
+
+void udelay(unsigned int usecs);
+void mdelay(unsigned int msecs);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef _ENDIAN_H_
+#define _ENDIAN_H_
+
+#include <commonlib/endian.h>
+
+#endif
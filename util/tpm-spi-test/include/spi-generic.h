@@ -0,0 +1,17 @@
+#ifndef _SPI_GENERIC_H_
+#define _SPI_GENERIC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct spi_slave {
+	unsigned int bus;
+	unsigned int cs;
+};
+
+int spi_claim_bus(struct spi_slave *slave);
+void spi_release_bus(struct spi_slave *slave);
+int spi_xfer(struct spi_slave *slave, const void *dout, unsigned int bytesout,
+	     void *din, unsigned int bytesin);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+/* Simulated time in microseconds, advanced by the TPM and the delays. */
+extern uint64_t sim_now_us;
+
+struct stopwatch {
+	uint64_t expires;
+};
+
+static inline void stopwatch_init_usecs_expire(struct stopwatch *sw, long us)
+{
+	sw->expires = sim_now_us + us;
+}
+
+static inline void stopwatch_init_msecs_expire(struct stopwatch *sw, long ms)
+{
+	stopwatch_init_usecs_expire(sw, ms * 1000);
+}
+
+static inline int stopwatch_expired(struct stopwatch *sw)
+{
+	return sim_now_us >= sw->expires;
+}
+
+#endif
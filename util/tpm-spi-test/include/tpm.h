@@ -0,0 +1,6 @@
+#ifndef TPM_H_
+#define TPM_H_
+
+int tis_plat_irq_status(void);
+
+#endif
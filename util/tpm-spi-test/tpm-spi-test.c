@@ -0,0 +1,265 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Runs src/drivers/spi/tpm/tpm.c against a software PTP FIFO TPM behind a
+ * stub SPI bus. The TPM echoes every command as its response and needs some
+ * time after each transaction before it can take the next one. Time is
+ * simulated, the delays and the TPM advance it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <delay.h>
+#include <spi-generic.h>
+#include <timer.h>
+#include <tpm.h>
+
+#include "../../src/drivers/spi/tpm/tpm.h"
+
+#define TPM_ACCESS_REG		0xd40000
+#define TPM_STS_REG		0xd40018
+#define TPM_DATA_FIFO_REG	0xd40024
+#define TPM_DID_VID_REG		0xd40f00
+
+/* Time the TPM needs after CS deassert before it takes the next frame. */
+#define TPM_READY_US		50
+/* Status reads the TPM reports busy after a command was started. */
+#define TPM_BUSY_POLLS		3
+
+uint64_t sim_now_us;
+
+static int use_irq;
+static unsigned int burst = 32;
+
+static struct {
+	unsigned int transactions;
+	unsigned int sts_reads;
+	unsigned int violations;
+} stats;
+
+static enum { TPM_IDLE, TPM_HEADER, TPM_DATA } phase;
+static uint32_t reg;
+static int is_read;
+static uint64_t ready_at;
+static int irq_pending;
+static int locality_claimed;
+static int busy_polls;
+static uint8_t cmd[4096];
+static size_t cmd_len;
+static uint8_t rsp[4096];
+static size_t rsp_len, rsp_pos;
+
+void udelay(unsigned int usecs)
+{
+	sim_now_us += usecs;
+}
+
+void mdelay(unsigned int msecs)
+{
+	sim_now_us += msecs * 1000ULL;
+}
+
+/* The platform hook as a board wiring up the TPM interrupt would have it. */
+int tis_plat_irq_status(void)
+{
+	if (!use_irq) {
+		mdelay(10);
+		return 1;
+	}
+
+	if (irq_pending && sim_now_us >= ready_at) {
+		irq_pending = 0;
+		return 1;
+	}
+
+	sim_now_us++;
+	return 0;
+}
+
+static uint32_t tpm_sts(void)
+{
+	uint32_t sts = (1 << 26) | (1 << 7) | (burst << 8);
+
+	if (busy_polls > 0) {
+		busy_polls--;
+		return sts & ~(burst << 8);
+	}
+
+	if (rsp_pos < rsp_len)
+		return sts | (1 << 4);
+
+	return sts | (1 << 6);
+}
+
+int spi_claim_bus(struct spi_slave *slave)
+{
+	if (sim_now_us < ready_at)
+		stats.violations++;
+
+	stats.transactions++;
+	phase = TPM_HEADER;
+	sim_now_us += 5;
+	return 0;
+}
+
+void spi_release_bus(struct spi_slave *slave)
+{
+	phase = TPM_IDLE;
+	ready_at = sim_now_us + TPM_READY_US;
+	irq_pending = 1;
+}
+
+static void tpm_reg_access(const uint8_t *out, uint8_t *in, size_t n)
+{
+	uint32_t val;
+
+	switch (reg) {
+	case TPM_ACCESS_REG:
+		if (is_read)
+			in[0] = locality_claimed ? 0xa0 : 0x80;
+		else
+			locality_claimed = !!(out[0] & (1 << 1));
+		break;
+	case TPM_STS_REG:
+		if (is_read) {
+			stats.sts_reads++;
+			val = tpm_sts();
+			memcpy(in, &val, sizeof(val));
+			break;
+		}
+		memcpy(&val, out, sizeof(val));
+		if (val & (1 << 6))
+			cmd_len = 0;
+		if (val & (1 << 5)) {
+			memcpy(rsp, cmd, cmd_len);
+			rsp_len = cmd_len;
+			rsp_pos = 0;
+			busy_polls = TPM_BUSY_POLLS;
+		}
+		break;
+	case TPM_DATA_FIFO_REG:
+		if (is_read) {
+			memcpy(in, rsp + rsp_pos, n);
+			rsp_pos += n;
+		} else {
+			memcpy(cmd + cmd_len, out, n);
+			cmd_len += n;
+		}
+		break;
+	case TPM_DID_VID_REG:
+		if (is_read) {
+			val = 0x001b15d1;
+			memcpy(in, &val, sizeof(val));
+		}
+		break;
+	default:
+		if (is_read)
+			memset(in, 0, n);
+	}
+}
+
+int spi_xfer(struct spi_slave *slave, const void *dout, unsigned int bytesout,
+	     void *din, unsigned int bytesin)
+{
+	const uint8_t *out = dout;
+	uint8_t *in = din;
+
+	/* About 8 MHz */
+	sim_now_us += bytesout + bytesin;
+
+	if (phase == TPM_HEADER) {
+		if (bytesout) {
+			is_read = out[0] & 0x80;
+			reg = (out[1] << 16) | (out[2] << 8) | out[3];
+		} else {
+			/* Flow control byte, no wait state. */
+			in[0] = 1;
+			phase = TPM_DATA;
+		}
+		return 0;
+	}
+
+	tpm_reg_access(out, in, bytesout ? bytesout : bytesin);
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [-i] [-s] [-b burst]\n"
+	       "  -i  Implement tis_plat_irq_status() with the TPM interrupt.\n"
+	       "  -s  Leave a transaction of an earlier stage in flight.\n"
+	       "  -b  Burst count the TPM advertises (default 32).\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	static struct spi_slave slave;
+	uint8_t command[200], response[256];
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "isb:")) != -1) {
+		switch (opt) {
+		case 'i':
+			use_irq = 1;
+			break;
+		case 's':
+			ready_at = sim_now_us + TPM_READY_US;
+			irq_pending = 1;
+			break;
+		case 'b':
+			burst = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (tpm2_init(&slave)) {
+		printf("FAIL: tpm2_init()\n");
+		return 1;
+	}
+
+	/* Alternate PCR extend and NV read sized commands. */
+	for (i = 0; i < 10; i++) {
+		size_t len = i % 2 ? 190 : 22;
+
+		memset(command, i, sizeof(command));
+		command[0] = 0x80;
+		command[1] = 0x01;
+		command[2] = command[3] = command[4] = 0;
+		command[5] = len;
+
+		if (tpm2_process_command(command, len, response,
+					 sizeof(response)) != len ||
+		    memcmp(command, response, len)) {
+			printf("FAIL: command %d\n", i);
+			return 1;
+		}
+	}
+
+	printf("%s, burst %u: %u SPI transactions, %u status reads, %llu us\n",
+	       use_irq ? "irq" : "no irq", burst, stats.transactions,
+	       stats.sts_reads, (unsigned long long)sim_now_us);
+
+	if (stats.violations) {
+		printf("FAIL: %u transactions started before the TPM was "
+		       "ready\n", stats.violations);
+		return 1;
+	}
+
+	return 0;
+}